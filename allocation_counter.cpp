@@ -0,0 +1,74 @@
+#include "allocation_counter.h"
+
+#if defined(WEBRTC_EXAMPLE_ALLOCATION_COUNTER)
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+thread_local uint64_t thread_allocations = 0;
+
+void* CountedAlloc(size_t size) {
+    ++thread_allocations;
+    return std::malloc(size ? size : 1);
+}
+
+void* CountedAlignedAlloc(size_t size, std::align_val_t alignment) {
+    ++thread_allocations;
+    void* ptr = nullptr;
+    const size_t align = std::max(static_cast<size_t>(alignment), sizeof(void*));
+    if (posix_memalign(&ptr, align, size ? size : 1) != 0) {
+        return nullptr;
+    }
+    return ptr;
+}
+
+// Built with -fno-exceptions, so allocation failure cannot throw bad_alloc.
+void* OrAbort(void* ptr) {
+    if (!ptr) {
+        std::abort();
+    }
+    return ptr;
+}
+
+}  // namespace
+
+uint64_t AllocationCounter::ThisThread() {
+    return thread_allocations;
+}
+
+void* operator new(size_t size) { return OrAbort(CountedAlloc(size)); }
+void* operator new[](size_t size) { return OrAbort(CountedAlloc(size)); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return CountedAlloc(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return CountedAlloc(size); }
+void* operator new(size_t size, std::align_val_t alignment) { return OrAbort(CountedAlignedAlloc(size, alignment)); }
+void* operator new[](size_t size, std::align_val_t alignment) { return OrAbort(CountedAlignedAlloc(size, alignment)); }
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return CountedAlignedAlloc(size, alignment);
+}
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return CountedAlignedAlloc(size, alignment);
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { std::free(ptr); }
+
+#else
+
+uint64_t AllocationCounter::ThisThread() {
+    return 0;
+}
+
+#endif
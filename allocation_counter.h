@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+
+// Counts heap allocations per thread. In builds with
+// WEBRTC_EXAMPLE_ALLOCATION_COUNTER, allocation_counter.cpp replaces the
+// global operator new, so every allocation in the process (WebRTC included)
+// bumps the calling thread's counter; the cost is one thread-local increment.
+// Other builds keep the default allocator and count nothing.
+class AllocationCounter {
+public:
+#if defined(WEBRTC_EXAMPLE_ALLOCATION_COUNTER)
+    static constexpr bool kEnabled = true;
+#else
+    static constexpr bool kEnabled = false;
+#endif
+
+    // Number of operator new calls made so far by the calling thread; always
+    // 0 unless kEnabled.
+    static uint64_t ThisThread();
+};
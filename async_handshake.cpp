@@ -0,0 +1 @@
+#include "async_handshake.h"
\ No newline at end of file
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include <api/peer_connection_interface.h>
+#include <api/rtc_error.h>
+#include <api/task_queue/task_queue_base.h>
+#include <api/units/time_delta.h>
+
+#include "completion_signal.h"
+#include "sdp_observer.h"
+#include "simple_peer_connection_observer.h"
+
+// Awaitables for the offer/answer/connect steps. Each step resumes the
+// awaiting coroutine from the WebRTC callback that completes it, or with a
+// timeout error once |timeout| has elapsed on |timer|, whichever comes
+// first. Timeouts surface as INTERNAL_ERROR naming the step.
+namespace async_handshake {
+
+using SdpResult = webrtc::RTCErrorOr<std::unique_ptr<webrtc::SessionDescriptionInterface>>;
+
+// State shared by the awaiting coroutine, the WebRTC callback and the timeout
+// task. Only the first Complete() resumes the coroutine.
+template <typename Result>
+class StepState {
+public:
+    void Complete(Result result) {
+        if (done_.exchange(true)) {
+            return;
+        }
+        result_.emplace(std::move(result));
+        handle_.resume();
+    }
+
+    void SetHandle(std::coroutine_handle<> handle) { handle_ = handle; }
+    Result TakeResult() { return std::move(*result_); }
+
+private:
+    std::atomic<bool> done_{false};
+    std::coroutine_handle<> handle_;
+    std::optional<Result> result_;
+};
+
+template <typename Result>
+class StepAwaiter {
+public:
+    using Starter = std::function<void(std::shared_ptr<StepState<Result>>)>;
+
+    StepAwaiter(std::string step, webrtc::TaskQueueBase* timer, webrtc::TimeDelta timeout, Starter start)
+        : step_(std::move(step)),
+          timer_(timer),
+          timeout_(timeout),
+          start_(std::move(start)),
+          state_(std::make_shared<StepState<Result>>()) {}
+
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+        // The step may complete and destroy this awaiter before start()
+        // returns, so nothing below may touch members afterwards.
+        std::shared_ptr<StepState<Result>> state = state_;
+        Starter start = std::move(start_);
+        state->SetHandle(handle);
+
+        timer_->PostDelayedTask(
+            [state, step = step_]() {
+                state->Complete(webrtc::RTCError(webrtc::RTCErrorType::INTERNAL_ERROR, step + " timed out"));
+            },
+            timeout_);
+        start(std::move(state));
+    }
+
+    Result await_resume() { return state_->TakeResult(); }
+
+private:
+    std::string step_;
+    webrtc::TaskQueueBase* timer_;
+    webrtc::TimeDelta timeout_;
+    Starter start_;
+    std::shared_ptr<StepState<Result>> state_;
+};
+
+// Resumes the awaiting coroutine on |thread|, through a posted task unless it
+// is already running there. Each step awaits the callback of the
+// PeerConnection it used, so the coroutine comes back on that peer's
+// signaling thread; hopping to the next PeerConnection's signaling thread
+// before calling it keeps the proxy from making a blocking call from one
+// shard's thread into another's.
+class ResumeOn {
+public:
+    explicit ResumeOn(webrtc::TaskQueueBase* thread) : thread_(thread) {}
+
+    bool await_ready() const noexcept { return !thread_ || thread_->IsCurrent(); }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+        thread_->PostTask([handle] { handle.resume(); });
+    }
+
+    void await_resume() const noexcept {}
+
+private:
+    webrtc::TaskQueueBase* thread_;
+};
+
+inline StepAwaiter<SdpResult> CreateOffer(
+    webrtc::scoped_refptr<webrtc::PeerConnectionInterface> pc,
+    webrtc::TaskQueueBase* timer,
+    webrtc::TimeDelta timeout,
+    webrtc::PeerConnectionInterface::RTCOfferAnswerOptions options = {}) {
+    return StepAwaiter<SdpResult>("CreateOffer", timer, timeout, [pc, options](auto state) {
+        auto observer = CreateSDPObserver::Create([state](SdpResult result) { state->Complete(std::move(result)); });
+        pc->CreateOffer(observer.get(), options);
+    });
+}
+
+inline StepAwaiter<SdpResult> CreateAnswer(
+    webrtc::scoped_refptr<webrtc::PeerConnectionInterface> pc,
+    webrtc::TaskQueueBase* timer,
+    webrtc::TimeDelta timeout,
+    webrtc::PeerConnectionInterface::RTCOfferAnswerOptions options = {}) {
+    return StepAwaiter<SdpResult>("CreateAnswer", timer, timeout, [pc, options](auto state) {
+        auto observer = CreateSDPObserver::Create([state](SdpResult result) { state->Complete(std::move(result)); });
+        pc->CreateAnswer(observer.get(), options);
+    });
+}
+
+inline StepAwaiter<webrtc::RTCError> SetLocal(
+    webrtc::scoped_refptr<webrtc::PeerConnectionInterface> pc,
+    std::unique_ptr<webrtc::SessionDescriptionInterface> desc,
+    webrtc::TaskQueueBase* timer,
+    webrtc::TimeDelta timeout) {
+    // std::function needs a copyable callable, so the description travels as
+    // a shared_ptr until it is handed over to the PeerConnection.
+    auto shared_desc = std::make_shared<std::unique_ptr<webrtc::SessionDescriptionInterface>>(std::move(desc));
+    return StepAwaiter<webrtc::RTCError>("SetLocalDescription", timer, timeout, [pc, shared_desc](auto state) {
+        auto observer = SetSDPObserver::Create([state](webrtc::RTCError error) { state->Complete(std::move(error)); });
+        pc->SetLocalDescription(observer.get(), shared_desc->release());
+    });
+}
+
+inline StepAwaiter<webrtc::RTCError> SetRemote(
+    webrtc::scoped_refptr<webrtc::PeerConnectionInterface> pc,
+    std::unique_ptr<webrtc::SessionDescriptionInterface> desc,
+    webrtc::TaskQueueBase* timer,
+    webrtc::TimeDelta timeout) {
+    auto shared_desc = std::make_shared<std::unique_ptr<webrtc::SessionDescriptionInterface>>(std::move(desc));
+    return StepAwaiter<webrtc::RTCError>("SetRemoteDescription", timer, timeout, [pc, shared_desc](auto state) {
+        auto observer = SetSDPObserver::Create([state](webrtc::RTCError error) { state->Complete(std::move(error)); });
+        pc->SetRemoteDescription(observer.get(), shared_desc->release());
+    });
+}
+
+// Awaits a CompletionSignal owned by one of the observers, e.g.
+// SimplePeerConnectionObserver::Connected().
+inline StepAwaiter<webrtc::RTCError> Signal(
+    std::string step, CompletionSignal& signal, webrtc::TaskQueueBase* timer, webrtc::TimeDelta timeout) {
+    return StepAwaiter<webrtc::RTCError>(std::move(step), timer, timeout, [&signal](auto state) {
+        signal.Subscribe([state](webrtc::RTCError error) { state->Complete(std::move(error)); });
+    });
+}
+
+inline StepAwaiter<webrtc::RTCError> IceGatheringComplete(
+    SimplePeerConnectionObserver& observer, webrtc::TaskQueueBase* timer, webrtc::TimeDelta timeout) {
+    return Signal("ICE gathering", observer.GatheringComplete(), timer, timeout);
+}
+
+inline StepAwaiter<webrtc::RTCError> Connected(
+    SimplePeerConnectionObserver& observer, webrtc::TaskQueueBase* timer, webrtc::TimeDelta timeout) {
+    return Signal("Connection", observer.Connected(), timer, timeout);
+}
+
+inline StepAwaiter<webrtc::RTCError> FirstMessage(
+    SimplePeerConnectionObserver& observer, webrtc::TaskQueueBase* timer, webrtc::TimeDelta timeout) {
+    return Signal("First message", observer.FirstMessage(), timer, timeout);
+}
+
+}  // namespace async_handshake
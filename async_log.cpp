@@ -0,0 +1 @@
+#include "async_log.h"
\ No newline at end of file
@@ -0,0 +1,277 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <rtc_base/time_utils.h>
+
+enum class LogLevel : int { kVerbose = 0, kInfo, kWarning, kError, kNone };
+
+// Levels below this are compiled out entirely (set from CMake).
+#ifndef WEBRTC_EXAMPLE_MIN_LOG_LEVEL
+#define WEBRTC_EXAMPLE_MIN_LOG_LEVEL 0
+#endif
+constexpr LogLevel kMinCompiledLogLevel = static_cast<LogLevel>(WEBRTC_EXAMPLE_MIN_LOG_LEVEL);
+
+// One structured log line. |event| and |state| must be string literals (the
+// state-to-string helpers return those); peer and detail are copied in,
+// truncated to fit, so logging never allocates.
+struct LogRecord {
+    static constexpr size_t kPeerBytes = 32;
+    static constexpr size_t kDetailBytes = 128;
+
+    int64_t time_us;
+    LogLevel level;
+    const char* event;
+    const char* state;
+    uint8_t peer_length;
+    uint8_t detail_length;
+    char peer[kPeerBytes];
+    char detail[kDetailBytes];
+};
+
+// Single-producer/single-consumer ring of log records. Each logging thread
+// owns one; the writer is the only consumer.
+class LogRing {
+public:
+    static constexpr size_t kCapacity = 1024;
+
+    // Producer side: a slot to fill and Commit(), or nullptr when full.
+    LogRecord* Reserve() {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == kCapacity) {
+            return nullptr;
+        }
+        return &records_[tail % kCapacity];
+    }
+    void Commit() { tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    // Consumer side.
+    template <typename Sink>
+    void Drain(Sink&& sink) {
+        const size_t tail = tail_.load(std::memory_order_acquire);
+        size_t head = head_.load(std::memory_order_relaxed);
+        for (; head != tail; ++head) {
+            sink(records_[head % kCapacity]);
+        }
+        head_.store(head, std::memory_order_release);
+    }
+
+private:
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+    std::unique_ptr<LogRecord[]> records_ = std::make_unique<LogRecord[]>(kCapacity);
+};
+
+// Asynchronous logging sink. Write() fills a record in the calling thread's
+// ring and returns; a background writer merges the rings by timestamp and
+// writes them out in batches. A full ring drops the record rather than
+// stalling a WebRTC thread.
+//
+// Use the ASYNC_LOG macro: levels below WEBRTC_EXAMPLE_MIN_LOG_LEVEL do not
+// even evaluate their arguments, and levels below the runtime minimum cost
+// one relaxed load.
+class AsyncLog {
+public:
+    static bool IsOn(LogLevel level) {
+        return level >= Instance().min_level_.load(std::memory_order_relaxed);
+    }
+    static LogLevel MinLevel() { return Instance().min_level_.load(std::memory_order_relaxed); }
+    static void SetMinLevel(LogLevel level) { Instance().min_level_.store(level, std::memory_order_relaxed); }
+
+    // "verbose", "info", "warning", "error" or "none".
+    static LogLevel LevelFromString(std::string_view name, LogLevel fallback) {
+        if (name == "verbose") return LogLevel::kVerbose;
+        if (name == "info") return LogLevel::kInfo;
+        if (name == "warning") return LogLevel::kWarning;
+        if (name == "error") return LogLevel::kError;
+        if (name == "none") return LogLevel::kNone;
+        return fallback;
+    }
+
+    // Printed as "[peer] event: state detail"; empty parts are left out.
+    static void Write(LogLevel level,
+                      std::string_view peer,
+                      const char* event,
+                      const char* state = nullptr,
+                      std::string_view detail = {}) {
+        LogRing* ring = ThreadRing();
+        LogRecord* record = ring->Reserve();
+        if (!record) {
+            Instance().dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        record->time_us = webrtc::TimeMicros();
+        record->level = level;
+        record->event = event;
+        record->state = state;
+        record->peer_length = static_cast<uint8_t>(std::min(peer.size(), LogRecord::kPeerBytes));
+        std::memcpy(record->peer, peer.data(), record->peer_length);
+        record->detail_length = static_cast<uint8_t>(std::min(detail.size(), LogRecord::kDetailBytes));
+        std::memcpy(record->detail, detail.data(), record->detail_length);
+        ring->Commit();
+    }
+
+    // Starts the background writer; records written before are kept.
+    static void Start() {
+        AsyncLog& log = Instance();
+        std::lock_guard<std::mutex> lock(log.writer_mutex_);
+        if (log.writer_.joinable()) {
+            return;
+        }
+        log.running_ = true;
+        log.writer_ = std::thread([&log] { log.WriterLoop(); });
+    }
+
+    // Stops the writer after writing out everything logged so far.
+    static void Stop() {
+        AsyncLog& log = Instance();
+        {
+            std::lock_guard<std::mutex> lock(log.writer_mutex_);
+            log.running_ = false;
+        }
+        log.wake_.notify_one();
+        if (log.writer_.joinable()) {
+            log.writer_.join();
+        }
+        Flush();
+    }
+
+    // Writes out everything logged so far before returning. Call it before
+    // printing to stdout directly so the output stays in order.
+    static void Flush() { Instance().DrainAndWrite(); }
+
+    // Records lost to full rings.
+    static uint64_t dropped() { return Instance().dropped_.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr auto kWriteInterval = std::chrono::milliseconds(2);
+
+    static AsyncLog& Instance() {
+        static AsyncLog* log = new AsyncLog();  // Leaked: threads may log during exit.
+        return *log;
+    }
+
+    static LogRing* ThreadRing() {
+        thread_local LogRing* ring = nullptr;
+        if (!ring) {
+            AsyncLog& log = Instance();
+            std::lock_guard<std::mutex> lock(log.rings_mutex_);
+            log.rings_.push_back(std::make_unique<LogRing>());
+            ring = log.rings_.back().get();
+        }
+        return ring;
+    }
+
+    void WriterLoop() {
+        std::unique_lock<std::mutex> lock(writer_mutex_);
+        while (running_) {
+            wake_.wait_for(lock, kWriteInterval);
+            lock.unlock();
+            DrainAndWrite();
+            lock.lock();
+        }
+    }
+
+    void DrainAndWrite() {
+        std::lock_guard<std::mutex> drain_lock(drain_mutex_);
+        {
+            // Rings are never freed, so the list can be walked after copying.
+            std::lock_guard<std::mutex> lock(rings_mutex_);
+            ring_snapshot_.clear();
+            for (const auto& ring : rings_) {
+                ring_snapshot_.push_back(ring.get());
+            }
+        }
+        batch_.clear();
+        for (LogRing* ring : ring_snapshot_) {
+            ring->Drain([this](const LogRecord& record) { batch_.push_back(record); });
+        }
+        if (batch_.empty()) {
+            return;
+        }
+        std::stable_sort(batch_.begin(), batch_.end(),
+                         [](const LogRecord& a, const LogRecord& b) { return a.time_us < b.time_us; });
+
+        out_.clear();
+        err_.clear();
+        for (const LogRecord& record : batch_) {
+            Format(record, record.level >= LogLevel::kWarning ? err_ : out_);
+        }
+        std::fwrite(out_.data(), 1, out_.size(), stdout);
+        std::fwrite(err_.data(), 1, err_.size(), stderr);
+        std::fflush(stdout);
+        std::fflush(stderr);
+    }
+
+    static void Format(const LogRecord& record, std::string& line) {
+        if (record.peer_length > 0) {
+            line += '[';
+            line.append(record.peer, record.peer_length);
+            line += "] ";
+        }
+        line += record.event;
+        if (record.state) {
+            line += ": ";
+            line += record.state;
+        }
+        if (record.detail_length > 0) {
+            line += record.state ? " " : ": ";
+            line.append(record.detail, record.detail_length);
+        }
+        line += '\n';
+    }
+
+    std::atomic<LogLevel> min_level_{LogLevel::kInfo};
+    std::atomic<uint64_t> dropped_{0};
+
+    std::mutex rings_mutex_;
+    std::vector<std::unique_ptr<LogRing>> rings_;
+
+    // Serializes consumers: the writer thread and Flush() callers.
+    std::mutex drain_mutex_;
+    std::vector<LogRing*> ring_snapshot_;
+    std::vector<LogRecord> batch_;
+    std::string out_;
+    std::string err_;
+
+    std::mutex writer_mutex_;
+    std::condition_variable wake_;
+    bool running_ = false;
+    std::thread writer_;
+};
+
+// Raises (or lowers) the runtime log level for a scope, e.g. to keep
+// per-peer state logging out of benchmark output.
+class ScopedLogLevel {
+public:
+    explicit ScopedLogLevel(LogLevel level) : previous_(AsyncLog::MinLevel()) { AsyncLog::SetMinLevel(level); }
+    ~ScopedLogLevel() { AsyncLog::SetMinLevel(previous_); }
+
+    ScopedLogLevel(const ScopedLogLevel&) = delete;
+    ScopedLogLevel& operator=(const ScopedLogLevel&) = delete;
+
+private:
+    LogLevel previous_;
+};
+
+// ASYNC_LOG(kInfo, peer, "ICE connection state", IceConnectionStateToString(s));
+#define ASYNC_LOG(level, ...)                                          \
+    do {                                                               \
+        if constexpr (LogLevel::level >= kMinCompiledLogLevel) {       \
+            if (AsyncLog::IsOn(LogLevel::level)) {                     \
+                AsyncLog::Write(LogLevel::level, __VA_ARGS__);         \
+            }                                                          \
+        }                                                              \
+    } while (0)
@@ -0,0 +1 @@
+#include "audio_benchmark.h"
\ No newline at end of file
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <api/audio_options.h>
+#include <api/data_channel_interface.h>
+#include <api/media_stream_interface.h>
+#include <api/peer_connection_interface.h>
+#include <api/stats/rtc_stats_report.h>
+#include <api/stats/rtcstats_objects.h>
+#include <api/units/time_delta.h>
+
+#include "async_log.h"
+#include "factory_pool.h"
+#include "loopback_pair.h"
+#include "process_stats.h"
+#include "stats_collector.h"
+#include "task.h"
+#include "virtual_audio_device.h"
+
+struct AudioOptions {
+    VirtualAudioDevice::Options device;
+    // Loopback pairs per row.
+    int pairs = 1;
+    // Opus tracks per pair; one row per entry.
+    std::vector<int> streams = {1, 8, 32};
+    // Run the audio processing module's echo canceller, noise suppressor,
+    // gain control and high-pass filter on the capture path.
+    bool apm = true;
+    webrtc::TimeDelta warmup = webrtc::TimeDelta::Seconds(2);
+    webrtc::TimeDelta duration = webrtc::TimeDelta::Seconds(5);
+};
+
+// Sends Opus audio tracks over loopback pairs whose factories use a
+// VirtualAudioDevice each, and reports process CPU per stream, the time the
+// devices spend in the capture callback (audio processing) and in the
+// playout callback (decoding and mixing), and how much of the received
+// audio was concealed. Both ends run in this process, so the CPU figure
+// covers encoding and decoding.
+class AudioBenchmark {
+public:
+    // Builds its own factory pool from |pool_options| so every shard gets a
+    // virtual audio device.
+    AudioBenchmark(PeerConnectionFactoryPool::Options pool_options,
+                   webrtc::PeerConnectionInterface::RTCConfiguration config,
+                   AudioOptions options)
+        : pool_options_(pool_options), config_(config), options_(options) {
+        config_.servers.clear();
+    }
+
+    int Run() {
+        pool_options_.audio_device = [this](int index) -> webrtc::scoped_refptr<webrtc::AudioDeviceModule> {
+            VirtualAudioDevice::Options device = options_.device;
+            // One playout file, not one per shard.
+            if (index > 0) {
+                device.playout_wav.clear();
+            }
+            webrtc::scoped_refptr<VirtualAudioDevice> adm = VirtualAudioDevice::Create(device);
+            if (adm) {
+                devices_.push_back(adm);
+            }
+            return adm;
+        };
+        std::unique_ptr<PeerConnectionFactoryPool> pool = PeerConnectionFactoryPool::Create(pool_options_);
+        if (!pool) {
+            return -1;
+        }
+        // A shard without a virtual device fell back to the platform's.
+        if (devices_.size() != pool->size()) {
+            std::cerr << "Cannot open " << options_.device.capture_wav << std::endl;
+            pool = nullptr;
+            devices_.clear();
+            return -1;
+        }
+
+        std::cout << "Audio mode: " << options_.pairs << " pair(s), "
+                  << (options_.device.capture_wav.empty() ? std::to_string(options_.device.tone_hz) + " Hz tone"
+                                                          : options_.device.capture_wav)
+                  << ", APM " << (options_.apm ? "on" : "off") << ", " << options_.duration.ms() << " ms per row"
+                  << std::endl;
+        std::cout << std::setw(8) << "streams" << std::setw(12) << "CPU/stream" << std::setw(14) << "streams/core"
+                  << std::setw(12) << "capture %" << std::setw(12) << "playout %" << std::setw(12) << "concealed"
+                  << std::setw(10) << "audible" << std::endl;
+
+        bool ok = true;
+        for (int streams : options_.streams) {
+            ok = RunOne(pool.get(), streams) && ok;
+        }
+        pool = nullptr;
+        devices_.clear();
+        return ok ? 0 : -1;
+    }
+
+private:
+    struct AudioTotals {
+        uint64_t samples_received = 0;
+        uint64_t concealed_samples = 0;
+    };
+
+    bool RunOne(PeerConnectionFactoryPool* pool, int streams_per_pair) {
+        webrtc::DataChannelInit dc_config;
+        dc_config.ordered = true;
+
+        webrtc::AudioOptions audio_options;
+        audio_options.echo_cancellation = options_.apm;
+        audio_options.auto_gain_control = options_.apm;
+        audio_options.noise_suppression = options_.apm;
+        audio_options.highpass_filter = options_.apm;
+
+        // Per-peer logging is kept to warnings while the pairs are set up and running.
+        ScopedLogLevel quiet(LogLevel::kWarning);
+
+        std::vector<std::unique_ptr<LoopbackPair>> pairs;
+        auto close_all = [&pairs] {
+            for (const auto& pair : pairs) {
+                pair->Close();
+            }
+        };
+        for (int i = 0; i < options_.pairs; ++i) {
+            FactoryShard::Lease sender = pool->Acquire();
+            webrtc::scoped_refptr<webrtc::AudioSourceInterface> source =
+                sender.factory()->CreateAudioSource(audio_options);
+            auto pair_result = LoopbackPair::Create(std::move(sender), pool->Acquire(), config_,
+                                                    "Audio.Peer" + std::to_string(i) + ".", dc_config);
+            if (!pair_result.ok()) {
+                std::cerr << "Failed to create loopback pair: " << pair_result.error().message() << std::endl;
+                close_all();
+                return false;
+            }
+            pairs.push_back(pair_result.MoveValue());
+            for (int j = 0; j < streams_per_pair; ++j) {
+                auto transceiver = pairs.back()->AddAudioTrack("audio" + std::to_string(j), source, "opus");
+                if (!transceiver.ok()) {
+                    std::cerr << "Failed to add audio track: " << transceiver.error().message() << std::endl;
+                    close_all();
+                    return false;
+                }
+            }
+            webrtc::RTCError error = SyncWait(pairs.back()->Connect(HandshakeTimeouts()));
+            if (!error.ok()) {
+                std::cerr << "Audio pair failed to connect: " << error.message() << std::endl;
+                close_all();
+                return false;
+            }
+        }
+
+        std::this_thread::sleep_for(std::chrono::microseconds(options_.warmup.us()));
+        const VirtualAudioDevice::Counters devices_before = SumDevices();
+        const AudioTotals before = Collect(pairs);
+        const double cpu_before = ProcessStats::CpuSeconds();
+        const auto window_start = std::chrono::steady_clock::now();
+        std::this_thread::sleep_for(std::chrono::microseconds(options_.duration.us()));
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - window_start).count();
+        const double cpu = ProcessStats::CpuSeconds() - cpu_before;
+        const VirtualAudioDevice::Counters devices_after = SumDevices();
+        const AudioTotals after = Collect(pairs);
+        close_all();
+
+        const int streams = options_.pairs * streams_per_pair;
+        const double cpu_per_stream = 100.0 * cpu / seconds / streams;
+        const int64_t playout_frames = devices_after.playout_frames - devices_before.playout_frames;
+        const uint64_t samples = after.samples_received - before.samples_received;
+        const uint64_t concealed = after.concealed_samples - before.concealed_samples;
+        std::cout << std::fixed << std::setprecision(2) << std::setw(8) << streams << std::setw(11) << cpu_per_stream
+                  << "%" << std::setprecision(1) << std::setw(14) << (cpu_per_stream > 0 ? 100.0 / cpu_per_stream : 0)
+                  << std::setprecision(2) << std::setw(11)
+                  << (devices_after.capture_ns - devices_before.capture_ns) / seconds / 1e7 << "%" << std::setw(11)
+                  << (devices_after.playout_ns - devices_before.playout_ns) / seconds / 1e7 << "%"
+                  << std::setprecision(1) << std::setw(11) << (samples ? 100.0 * concealed / samples : 0) << "%"
+                  << std::setw(9)
+                  << (playout_frames ? 100.0 * (devices_after.audible_frames - devices_before.audible_frames) /
+                                           playout_frames
+                                     : 0)
+                  << "%" << std::defaultfloat << std::endl;
+        return samples > 0;
+    }
+
+    VirtualAudioDevice::Counters SumDevices() const {
+        VirtualAudioDevice::Counters sum;
+        for (const auto& device : devices_) {
+            const VirtualAudioDevice::Counters counters = device->counters();
+            sum.capture_frames += counters.capture_frames;
+            sum.capture_ns += counters.capture_ns;
+            sum.playout_frames += counters.playout_frames;
+            sum.playout_ns += counters.playout_ns;
+            sum.audible_frames += counters.audible_frames;
+        }
+        return sum;
+    }
+
+    // Receiver-side audio counters of every pair.
+    static AudioTotals Collect(const std::vector<std::unique_ptr<LoopbackPair>>& pairs) {
+        AudioTotals totals;
+        for (const auto& pair : pairs) {
+            webrtc::scoped_refptr<const webrtc::RTCStatsReport> report = GetStatsBlocking(pair->answerer().pc);
+            if (!report) {
+                continue;
+            }
+            for (const auto* inbound : report->GetStatsOfType<webrtc::RTCInboundRtpStreamStats>()) {
+                if (inbound->kind.value_or("") != "audio") {
+                    continue;
+                }
+                totals.samples_received += inbound->total_samples_received.value_or(0);
+                totals.concealed_samples += inbound->concealed_samples.value_or(0);
+            }
+        }
+        return totals;
+    }
+
+    PeerConnectionFactoryPool::Options pool_options_;
+    webrtc::PeerConnectionInterface::RTCConfiguration config_;
+    AudioOptions options_;
+    // Filled while the pool is created.
+    std::vector<webrtc::scoped_refptr<VirtualAudioDevice>> devices_;
+};
@@ -0,0 +1 @@
+#include "batch_benchmark.h"
\ No newline at end of file
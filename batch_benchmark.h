@@ -0,0 +1,162 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <api/data_channel_interface.h>
+#include <api/peer_connection_interface.h>
+#include <api/units/time_delta.h>
+#include <rtc_base/copy_on_write_buffer.h>
+#include <rtc_base/event.h>
+#include <rtc_base/time_utils.h>
+
+#include "data_channel_message_handler.h"
+#include "async_log.h"
+#include "benchmark_pair.h"
+#include "factory_pool.h"
+#include "latency_recording_handler.h"
+#include "latency_stats.h"
+#include "loopback_pair.h"
+#include "message_batcher.h"
+#include "process_stats.h"
+#include "task.h"
+
+struct BatchBenchmarkOptions {
+    int message_size = 64;
+    // Offered load in messages per second.
+    int rate = 200000;
+    webrtc::TimeDelta warmup = webrtc::TimeDelta::Millis(500);
+    webrtc::TimeDelta duration = webrtc::TimeDelta::Seconds(3);
+    uint64_t high_watermark = 1024 * 1024;
+    BatchOptions batch;
+};
+
+// Offers the same paced stream of small messages to a plain data channel and
+// to a MessageBatcher, and compares delivered messages/s, one-way latency and
+// CPU time.
+class BatchBenchmark {
+public:
+    BatchBenchmark(PeerConnectionFactoryPool* pool,
+                   webrtc::PeerConnectionInterface::RTCConfiguration config,
+                   BatchBenchmarkOptions options)
+        : pool_(pool), config_(config), options_(options) {
+        config_.servers.clear();
+        options_.message_size = std::max<int>(options_.message_size, kTimestampBytes);
+    }
+
+    int Run() {
+        std::cout << "Batch mode: " << options_.message_size << " byte messages offered at " << options_.rate
+                  << " msgs/s, frames up to " << options_.batch.max_frame_bytes << " bytes or "
+                  << options_.batch.flush_delay.us() << " us" << std::endl;
+        std::cout << std::setw(10) << "sender" << std::setw(12) << "msgs/s" << std::setw(10) << "p50 ms"
+                  << std::setw(10) << "p99 ms" << std::setw(10) << "max ms" << std::setw(12) << "msgs/frame"
+                  << std::setw(10) << "CPU s" << std::endl;
+
+        const bool unbatched_ok = RunOne(false);
+        const bool batched_ok = RunOne(true);
+        return unbatched_ok && batched_ok ? 0 : -1;
+    }
+
+private:
+    bool RunOne(bool batched) {
+        webrtc::DataChannelInit dc_config;
+        dc_config.ordered = true;
+
+        LatencyRecordingHandler recorder;
+        MessageUnbatcher unbatcher(&recorder);
+        webrtc::Event opened;
+
+        ScopedLogLevel quiet(LogLevel::kWarning);
+        std::unique_ptr<BenchmarkPair> fixture =
+            BenchmarkPair::Create(pool_->Acquire(), pool_->Acquire(), config_, "Batch", dc_config, "batch");
+        if (!fixture) {
+            return false;
+        }
+        LoopbackPair* pair = fixture->pair();
+        pair->observer1()->GetDataObserver()->SetOpenHandler([&opened] { opened.Set(); });
+        pair->observer2()->GetDataObserver()->SetMessageHandler(
+            batched ? static_cast<DataChannelMessageHandler*>(&unbatcher) : &recorder);
+
+        if (!fixture->Connect(HandshakeTimeouts(), &opened)) {
+            return false;
+        }
+
+        webrtc::scoped_refptr<webrtc::DataChannelInterface> channel = pair->data_channel();
+        webrtc::scoped_refptr<MessageBatcher> batcher;
+        if (batched) {
+            batcher = MessageBatcher::Create(channel, fixture->network_thread1(), options_.batch);
+        }
+
+        std::atomic<bool> producing{true};
+        std::thread producer([&] {
+            std::vector<uint8_t> message(options_.message_size, 0x5A);
+            const auto start = std::chrono::steady_clock::now();
+            uint64_t sent = 0;
+            while (producing.load(std::memory_order_relaxed)) {
+                // One buffered_amount() query per tick; it is a hop to the
+                // network thread.
+                if (channel->buffered_amount() >= options_.high_watermark) {
+                    std::this_thread::sleep_for(std::chrono::microseconds(100));
+                    continue;
+                }
+                const double elapsed =
+                    std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                const uint64_t due = static_cast<uint64_t>(elapsed * options_.rate);
+                for (; sent < due && producing.load(std::memory_order_relaxed); ++sent) {
+                    const int64_t now_us = webrtc::TimeMicros();
+                    std::memcpy(message.data(), &now_us, kTimestampBytes);
+                    if (batcher) {
+                        batcher->Send(message);
+                    } else {
+                        channel->Send(
+                            webrtc::DataBuffer(webrtc::CopyOnWriteBuffer(message.data(), message.size()), true));
+                    }
+                }
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+        });
+
+        std::this_thread::sleep_for(std::chrono::microseconds(options_.warmup.us()));
+        const uint64_t messages_start = recorder.messages();
+        const uint64_t frames_start = batcher ? batcher->frames_sent() : 0;
+        const double cpu_start = ProcessStats::CpuSeconds();
+        recorder.StartMeasuring();
+        const auto window_start = std::chrono::steady_clock::now();
+
+        std::this_thread::sleep_for(std::chrono::microseconds(options_.duration.us()));
+        recorder.StopMeasuring();
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - window_start).count();
+        const uint64_t messages = recorder.messages() - messages_start;
+        const uint64_t frames = batcher ? batcher->frames_sent() - frames_start : 0;
+        const double cpu = ProcessStats::CpuSeconds() - cpu_start;
+
+        producing = false;
+        producer.join();
+        fixture->Close();
+
+        LatencyStats& latency = recorder.latency();
+        // Unbatched sends are one message per frame by definition.
+        const double per_frame = batched ? (frames ? static_cast<double>(messages) / frames : 0.0) : 1.0;
+        std::cout << std::fixed << std::setw(10) << (batched ? "batched" : "unbatched") << std::setw(12)
+                  << std::setprecision(0) << messages / seconds << std::setprecision(3) << std::setw(10)
+                  << latency.Percentile(50) << std::setw(10) << latency.Percentile(99) << std::setw(10)
+                  << latency.Max() << std::setprecision(1) << std::setw(12) << per_frame << std::setprecision(2)
+                  << std::setw(10) << cpu << std::defaultfloat << std::endl;
+        if (batched && unbatcher.malformed_frames() > 0) {
+            std::cerr << "Malformed frames: " << unbatcher.malformed_frames() << std::endl;
+        }
+        return messages > 0;
+    }
+
+    PeerConnectionFactoryPool* pool_;
+    webrtc::PeerConnectionInterface::RTCConfiguration config_;
+    BatchBenchmarkOptions options_;
+};
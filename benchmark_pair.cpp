@@ -0,0 +1 @@
+#include "benchmark_pair.h"
\ No newline at end of file
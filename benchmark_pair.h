@@ -0,0 +1,97 @@
+#pragma once
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include <api/data_channel_interface.h>
+#include <api/peer_connection_interface.h>
+#include <api/rtc_error.h>
+#include <api/units/time_delta.h>
+#include <rtc_base/event.h>
+#include <rtc_base/thread.h>
+
+#include "factory_pool.h"
+#include "local_signaling.h"
+#include "loopback_pair.h"
+#include "task.h"
+
+// The fixture the data channel benchmarks measure on: a LoopbackPair over
+// two factory leases, named after |name| ("Send" gives peers Send.Peer1 and
+// Send.Peer2). Create() and Connect() report failures on std::cerr.
+//
+// Close(), also run on destruction, closes the pair and then flushes both
+// peers' network threads: send tasks and message deliveries already queued
+// there run before it returns. Delayed tasks that are not yet due are not
+// drained, so anything that reposts itself with a delay (PacedSender, a
+// timer) must be stopped such that its pending tasks no longer touch it.
+// Declare the senders and handlers hooked into the pair's observers before
+// the BenchmarkPair, and stop them before closing.
+class BenchmarkPair {
+public:
+    static std::unique_ptr<BenchmarkPair> Create(FactoryShard::Lease lease1,
+                                                 FactoryShard::Lease lease2,
+                                                 const webrtc::PeerConnectionInterface::RTCConfiguration& config,
+                                                 const std::string& name,
+                                                 const webrtc::DataChannelInit& dc_config,
+                                                 const std::string& channel_label) {
+        webrtc::Thread* network_thread1 = lease1.shard()->network_thread();
+        webrtc::Thread* network_thread2 = lease2.shard()->network_thread();
+        auto pair_result = LoopbackPair::Create(std::move(lease1), std::move(lease2), config, name + ".Peer",
+                                                dc_config, channel_label);
+        if (!pair_result.ok()) {
+            std::cerr << "Failed to create loopback pair: " << pair_result.error().message() << std::endl;
+            return nullptr;
+        }
+        return std::unique_ptr<BenchmarkPair>(
+            new BenchmarkPair(name, pair_result.MoveValue(), network_thread1, network_thread2));
+    }
+
+    ~BenchmarkPair() { Close(); }
+
+    // Blocks until both peers are connected and, if |opened| is given (set
+    // from an open handler the caller installed), until it is set.
+    bool Connect(HandshakeTimeouts timeouts = HandshakeTimeouts(), webrtc::Event* opened = nullptr) {
+        webrtc::RTCError error = SyncWait(pair_->Connect(timeouts));
+        if (error.ok() && opened && !opened->Wait(webrtc::TimeDelta::Seconds(5))) {
+            error = webrtc::RTCError(webrtc::RTCErrorType::INTERNAL_ERROR, "Data channel open timed out");
+        }
+        if (!error.ok()) {
+            std::cerr << name_ << " pair failed to connect: " << error.message() << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Safe to call more than once.
+    void Close() {
+        if (closed_) {
+            return;
+        }
+        closed_ = true;
+        pair_->Close();
+        network_thread1_->BlockingCall([] {});
+        network_thread2_->BlockingCall([] {});
+    }
+
+    LoopbackPair* pair() { return pair_.get(); }
+    webrtc::Thread* network_thread1() const { return network_thread1_; }
+    webrtc::Thread* network_thread2() const { return network_thread2_; }
+
+private:
+    BenchmarkPair(const std::string& name,
+                  std::unique_ptr<LoopbackPair> pair,
+                  webrtc::Thread* network_thread1,
+                  webrtc::Thread* network_thread2)
+        : name_(name),
+          pair_(std::move(pair)),
+          network_thread1_(network_thread1),
+          network_thread2_(network_thread2) {}
+
+    const std::string name_;
+    std::unique_ptr<LoopbackPair> pair_;
+    webrtc::Thread* network_thread1_;
+    webrtc::Thread* network_thread2_;
+    bool closed_ = false;
+};
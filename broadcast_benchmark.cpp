@@ -0,0 +1 @@
+#include "broadcast_benchmark.h"
\ No newline at end of file
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <api/data_channel_interface.h>
+#include <api/peer_connection_interface.h>
+#include <api/units/time_delta.h>
+#include <rtc_base/thread.h>
+#include <rtc_base/time_utils.h>
+
+#include "async_log.h"
+#include "benchmark_pair.h"
+#include "broadcast_hub.h"
+#include "factory_pool.h"
+#include "latency_recording_handler.h"
+#include "latency_stats.h"
+#include "loopback_pair.h"
+#include "task.h"
+
+struct BroadcastBenchmarkOptions {
+    // Subscriber counts; one row per count and payload mode.
+    std::vector<int> subscribers = {1, 10, 100};
+    int message_size = 1024;
+    // Broadcasts per second.
+    int rate = 100;
+    webrtc::TimeDelta warmup = webrtc::TimeDelta::Millis(500);
+    webrtc::TimeDelta duration = webrtc::TimeDelta::Seconds(3);
+    BroadcastOptions hub;
+};
+
+// Publishes timestamped updates through a BroadcastHub to N loopback pairs,
+// once with the payload shared by every subscriber and once copied per
+// subscriber, and reports publish-to-receive latency across all deliveries,
+// the share of deliveries the slow-subscriber policy dropped or coalesced,
+// and the payload bytes the hub copied per broadcast.
+class BroadcastBenchmark {
+public:
+    BroadcastBenchmark(PeerConnectionFactoryPool* pool,
+                       webrtc::PeerConnectionInterface::RTCConfiguration config,
+                       BroadcastBenchmarkOptions options)
+        : pool_(pool), config_(config), options_(options) {
+        config_.servers.clear();
+        options_.message_size = std::max<int>(options_.message_size, kTimestampBytes);
+        options_.rate = std::max(options_.rate, 1);
+    }
+
+    int Run() {
+        std::cout << "Broadcast mode: " << options_.message_size << " byte updates at " << options_.rate
+                  << "/s, watermarks " << options_.hub.low_watermark / 1024 << "/"
+                  << options_.hub.high_watermark / 1024 << " KiB, slow subscribers "
+                  << (options_.hub.policy == SlowSubscriberPolicy::kDrop ? "dropped" : "coalesced") << ", "
+                  << options_.duration.ms() << " ms per row" << std::endl;
+        std::cout << std::setw(8) << "subs" << std::setw(8) << "payload" << std::setw(12) << "bcast/s"
+                  << std::setw(11) << "delivered" << std::setw(10) << "dropped" << std::setw(11) << "coalesced"
+                  << std::setw(10) << "p50 ms" << std::setw(10) << "p99 ms" << std::setw(10) << "max ms"
+                  << std::setw(14) << "copied/bcast" << std::endl;
+
+        bool ok = true;
+        for (int subscribers : options_.subscribers) {
+            ok = RunOne(subscribers, false) && ok;
+            ok = RunOne(subscribers, true) && ok;
+        }
+        return ok ? 0 : -1;
+    }
+
+private:
+    bool RunOne(int subscriber_count, bool copy_per_subscriber) {
+        webrtc::DataChannelInit dc_config;
+        dc_config.ordered = true;
+
+        BroadcastOptions hub_options = options_.hub;
+        hub_options.copy_per_subscriber = copy_per_subscriber;
+        BroadcastHub hub(hub_options);
+        std::vector<std::unique_ptr<LatencyRecordingHandler>> recorders;
+
+        ScopedLogLevel quiet(LogLevel::kWarning);
+        std::vector<std::unique_ptr<BenchmarkPair>> pairs;
+        // The hub posts fan-out tasks to every publisher thread, so it stops
+        // before any pair closes.
+        auto close_all = [&] {
+            hub.Close();
+            for (const auto& pair : pairs) {
+                pair->Close();
+            }
+        };
+        for (int i = 0; i < subscriber_count; ++i) {
+            std::unique_ptr<BenchmarkPair> pair = BenchmarkPair::Create(
+                pool_->Acquire(), pool_->Acquire(), config_, "Broadcast" + std::to_string(i), dc_config, "broadcast");
+            if (!pair) {
+                close_all();
+                return false;
+            }
+            pairs.push_back(std::move(pair));
+            recorders.push_back(std::make_unique<LatencyRecordingHandler>());
+            hub.Subscribe(pairs.back()->pair()->observer1()->GetDataObserver(), pairs.back()->network_thread1());
+            pairs.back()->pair()->observer2()->GetDataObserver()->SetMessageHandler(recorders.back().get());
+            if (!pairs.back()->Connect()) {
+                close_all();
+                return false;
+            }
+        }
+
+        std::atomic<bool> publishing{true};
+        std::thread publisher([&] {
+            const auto start = std::chrono::steady_clock::now();
+            for (uint64_t published = 0; publishing.load(std::memory_order_relaxed); ++published) {
+                std::this_thread::sleep_until(start + std::chrono::microseconds(published * 1000000 / options_.rate));
+                hub.Publish(options_.message_size, [this](uint8_t* out) {
+                    const int64_t now_us = webrtc::TimeMicros();
+                    std::memcpy(out, &now_us, kTimestampBytes);
+                    std::memset(out + kTimestampBytes, 0x5A, options_.message_size - kTimestampBytes);
+                });
+            }
+        });
+
+        std::this_thread::sleep_for(std::chrono::microseconds(options_.warmup.us()));
+        const BroadcastHub::Counters before = hub.counters();
+        uint64_t received_before = 0;
+        for (const auto& recorder : recorders) {
+            received_before += recorder->messages();
+            recorder->StartMeasuring();
+        }
+        const auto window_start = std::chrono::steady_clock::now();
+        std::this_thread::sleep_for(std::chrono::microseconds(options_.duration.us()));
+        uint64_t received_after = 0;
+        for (const auto& recorder : recorders) {
+            recorder->StopMeasuring();
+            received_after += recorder->messages();
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - window_start).count();
+        const BroadcastHub::Counters after = hub.counters();
+
+        publishing = false;
+        publisher.join();
+        close_all();
+
+        LatencyStats latency;
+        for (const auto& recorder : recorders) {
+            latency.Append(recorder->latency());
+        }
+        const uint64_t broadcasts = after.broadcasts - before.broadcasts;
+        const double offered = static_cast<double>(broadcasts) * subscriber_count;
+        const double per_offer = offered > 0 ? 100.0 / offered : 0.0;
+        std::cout << std::fixed << std::setw(8) << subscriber_count << std::setw(8)
+                  << (copy_per_subscriber ? "copy" : "shared") << std::setw(12) << std::setprecision(0)
+                  << broadcasts / seconds << std::setprecision(1) << std::setw(10)
+                  << (received_after - received_before) * per_offer << "%" << std::setw(9)
+                  << (after.dropped - before.dropped) * per_offer << "%" << std::setw(10)
+                  << (after.coalesced - before.coalesced) * per_offer << "%" << std::setprecision(3)
+                  << std::setw(10) << latency.Percentile(50) << std::setw(10) << latency.Percentile(99)
+                  << std::setw(10) << latency.Max() << std::setprecision(0) << std::setw(14)
+                  << (broadcasts ? static_cast<double>(after.bytes_copied - before.bytes_copied) / broadcasts : 0)
+                  << std::defaultfloat << std::endl;
+        return latency.count() > 0;
+    }
+
+    PeerConnectionFactoryPool* pool_;
+    webrtc::PeerConnectionInterface::RTCConfiguration config_;
+    BroadcastBenchmarkOptions options_;
+};
@@ -0,0 +1 @@
+#include "broadcast_hub.h"
\ No newline at end of file
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <api/data_channel_interface.h>
+#include <api/task_queue/task_queue_base.h>
+#include <rtc_base/copy_on_write_buffer.h>
+
+#include "data_channel_observer.h"
+
+// What a subscriber that is above its high watermark gets.
+enum class SlowSubscriberPolicy {
+    // Broadcasts are skipped until it drains to its low watermark.
+    kDrop,
+    // Only the latest broadcast is kept and sent once it drains; older ones
+    // it missed are replaced. Suits state updates where only the newest
+    // value matters.
+    kCoalesce,
+};
+
+struct BroadcastOptions {
+    // Per subscriber channel, in bytes of buffered_amount().
+    uint64_t high_watermark = 1024 * 1024;
+    uint64_t low_watermark = 256 * 1024;
+    SlowSubscriberPolicy policy = SlowSubscriberPolicy::kCoalesce;
+    // Give every subscriber its own copy of the payload, as one
+    // DataChannelObserver::Send() per peer would. For comparison only.
+    bool copy_per_subscriber = false;
+};
+
+// Sends the same messages to many data channels. Each broadcast is
+// serialized once into a CopyOnWriteBuffer that every subscriber's
+// DataBuffer references, and fanned out with one task per network thread
+// rather than one per subscriber. Subscribers are flow-controlled one by
+// one: a channel at its high watermark is handled by |policy| and never
+// holds up the others.
+//
+// Subscribe() every channel before the first Publish(). Publish() may be
+// called from any thread; everything else a subscriber does runs on its
+// network thread. Close() the hub, close the channels and flush their
+// network threads before destroying it.
+class BroadcastHub {
+public:
+    struct Counters {
+        uint64_t broadcasts = 0;
+        // Messages handed to a channel.
+        uint64_t sent = 0;
+        uint64_t dropped = 0;
+        // Pending broadcasts replaced by a newer one.
+        uint64_t coalesced = 0;
+        uint64_t send_failures = 0;
+        // Payload bytes written or copied by the hub.
+        uint64_t bytes_copied = 0;
+    };
+
+    explicit BroadcastHub(BroadcastOptions options = {}) : options_(options) {}
+
+    BroadcastHub(const BroadcastHub&) = delete;
+    BroadcastHub& operator=(const BroadcastHub&) = delete;
+
+    // Adds the channel |observer| watches and takes over its open and
+    // buffered amount handlers. |network_thread| is the channel's. Channels
+    // that are already open start receiving right away.
+    void Subscribe(DataChannelObserver* observer, webrtc::TaskQueueBase* network_thread) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        subscribers_.push_back(std::make_unique<Subscriber>());
+        Subscriber* subscriber = subscribers_.back().get();
+        subscriber->observer = observer;
+
+        Group* group = nullptr;
+        for (const auto& existing : groups_) {
+            if (existing->network_thread == network_thread) {
+                group = existing.get();
+            }
+        }
+        if (!group) {
+            groups_.push_back(std::make_unique<Group>());
+            group = groups_.back().get();
+            group->network_thread = network_thread;
+        }
+        group->subscribers.push_back(subscriber);
+
+        observer->SetOpenHandler([this, subscriber] { Open(subscriber); });
+        observer->SetBufferedAmountHandler([this, subscriber](uint64_t) { Drain(subscriber); });
+        network_thread->PostTask([this, subscriber] {
+            webrtc::scoped_refptr<webrtc::DataChannelInterface> channel = subscriber->observer->data_channel();
+            if (channel && channel->state() == webrtc::DataChannelInterface::kOpen) {
+                Open(subscriber);
+            }
+        });
+    }
+
+    // Broadcasts a |size|-byte binary message that |write| serializes in
+    // place into |size| writable bytes.
+    template <typename Write>
+    void Publish(size_t size, Write&& write) {
+        webrtc::CopyOnWriteBuffer payload(size);
+        write(payload.MutableData());
+        bytes_copied_.fetch_add(size, std::memory_order_relaxed);
+        broadcasts_.fetch_add(1, std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& group : groups_) {
+            const Group* target = group.get();
+            target->network_thread->PostTask([this, target, payload] {
+                for (Subscriber* subscriber : target->subscribers) {
+                    Offer(subscriber, payload);
+                }
+            });
+        }
+    }
+
+    // Pending fan-out tasks see this and return; nothing is sent after it.
+    void Close() { closed_ = true; }
+
+    size_t subscribers() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return subscribers_.size();
+    }
+
+    Counters counters() const {
+        Counters counters;
+        counters.broadcasts = broadcasts_.load(std::memory_order_relaxed);
+        counters.sent = sent_.load(std::memory_order_relaxed);
+        counters.dropped = dropped_.load(std::memory_order_relaxed);
+        counters.coalesced = coalesced_.load(std::memory_order_relaxed);
+        counters.send_failures = send_failures_.load(std::memory_order_relaxed);
+        counters.bytes_copied = bytes_copied_.load(std::memory_order_relaxed);
+        return counters;
+    }
+
+private:
+    // Fields are only touched on the subscriber's network thread.
+    struct Subscriber {
+        DataChannelObserver* observer = nullptr;
+        bool open = false;
+        // Set at the high watermark, cleared at the low one.
+        bool blocked = false;
+        bool has_pending = false;
+        webrtc::CopyOnWriteBuffer pending;
+    };
+
+    struct Group {
+        webrtc::TaskQueueBase* network_thread = nullptr;
+        std::vector<Subscriber*> subscribers;
+    };
+
+    void Open(Subscriber* subscriber) {
+        subscriber->open = true;
+        Flush(subscriber);
+    }
+
+    void Drain(Subscriber* subscriber) {
+        if (subscriber->blocked &&
+            subscriber->observer->data_channel()->buffered_amount() <= options_.low_watermark) {
+            subscriber->blocked = false;
+            Flush(subscriber);
+        }
+    }
+
+    void Offer(Subscriber* subscriber, const webrtc::CopyOnWriteBuffer& payload) {
+        if (closed_) {
+            return;
+        }
+        if (!subscriber->open || subscriber->blocked) {
+            if (options_.policy == SlowSubscriberPolicy::kDrop) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            if (subscriber->has_pending) {
+                coalesced_.fetch_add(1, std::memory_order_relaxed);
+            }
+            subscriber->pending = payload;
+            subscriber->has_pending = true;
+            return;
+        }
+        // Newer than anything pending, which is now stale.
+        if (subscriber->has_pending) {
+            subscriber->has_pending = false;
+            subscriber->pending = webrtc::CopyOnWriteBuffer();
+            coalesced_.fetch_add(1, std::memory_order_relaxed);
+        }
+        SendTo(subscriber, payload);
+    }
+
+    void Flush(Subscriber* subscriber) {
+        if (closed_ || !subscriber->has_pending) {
+            return;
+        }
+        subscriber->has_pending = false;
+        webrtc::CopyOnWriteBuffer payload = std::move(subscriber->pending);
+        subscriber->pending = webrtc::CopyOnWriteBuffer();
+        SendTo(subscriber, payload);
+    }
+
+    void SendTo(Subscriber* subscriber, const webrtc::CopyOnWriteBuffer& payload) {
+        webrtc::DataChannelInterface* channel = subscriber->observer->data_channel().get();
+        bool sent;
+        if (options_.copy_per_subscriber) {
+            bytes_copied_.fetch_add(payload.size(), std::memory_order_relaxed);
+            sent = channel->Send(webrtc::DataBuffer(webrtc::CopyOnWriteBuffer(payload.cdata(), payload.size()), true));
+        } else {
+            sent = channel->Send(webrtc::DataBuffer(payload, true));
+        }
+        if (!sent) {
+            send_failures_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        sent_.fetch_add(1, std::memory_order_relaxed);
+        if (channel->buffered_amount() >= options_.high_watermark) {
+            subscriber->blocked = true;
+        }
+    }
+
+    const BroadcastOptions options_;
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<Subscriber>> subscribers_;
+    // Subscribers sharing a network thread.
+    std::vector<std::unique_ptr<Group>> groups_;
+    std::atomic<bool> closed_{false};
+    std::atomic<uint64_t> broadcasts_{0};
+    std::atomic<uint64_t> sent_{0};
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<uint64_t> coalesced_{0};
+    std::atomic<uint64_t> send_failures_{0};
+    std::atomic<uint64_t> bytes_copied_{0};
+};
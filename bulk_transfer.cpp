@@ -0,0 +1 @@
+#include "bulk_transfer.h"
\ No newline at end of file
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <api/data_channel_interface.h>
+#include <api/peer_connection_interface.h>
+#include <api/task_queue/task_queue_base.h>
+#include <api/units/time_delta.h>
+#include <rtc_base/copy_on_write_buffer.h>
+
+#include "async_log.h"
+#include "benchmark_pair.h"
+#include "data_channel_message_handler.h"
+#include "data_channel_observer.h"
+#include "factory_pool.h"
+#include "loopback_pair.h"
+#include "process_stats.h"
+#include "task.h"
+
+// Streams fixed-size binary messages as fast as the channel drains them.
+// Sends stop once buffered_amount() reaches |high_watermark| and resume from
+// OnBufferedAmountChange when it falls to |low_watermark|, so the SCTP send
+// queue never overflows (which would close the channel).
+class BulkSender {
+public:
+    BulkSender(size_t message_size, uint64_t high_watermark, uint64_t low_watermark)
+        : payload_(message_size, message_size),
+          high_watermark_(high_watermark),
+          low_watermark_(low_watermark) {
+        // One shared payload; each DataBuffer only takes a reference to it.
+        std::memset(payload_.MutableData(), 0xA5, message_size);
+    }
+
+    // Hooks the sender into the channel opener's observer.
+    void Attach(DataChannelObserver* observer) {
+        observer->SetOpenHandler([this, observer] { Start(observer->data_channel()); });
+        observer->SetBufferedAmountHandler([this](uint64_t) {
+            if (channel_ && channel_->buffered_amount() <= low_watermark_) {
+                Pump();
+            }
+        });
+    }
+
+    // Starts pumping an open channel. Call on the channel's network thread;
+    // Attach() does so from the open handler.
+    void Start(webrtc::scoped_refptr<webrtc::DataChannelInterface> channel) {
+        channel_ = channel;
+        Pump();
+    }
+
+    // Pending pump tasks see this and return without rescheduling.
+    void Stop() { stopped_ = true; }
+
+    uint64_t messages_sent() const { return messages_sent_.load(std::memory_order_relaxed); }
+    uint64_t send_failures() const { return send_failures_.load(std::memory_order_relaxed); }
+
+private:
+    // Sends are bounded per pass so a channel whose data goes straight into
+    // SCTP (buffered_amount() stays 0) cannot monopolize the network thread.
+    static constexpr int kMaxSendsPerPass = 256;
+
+    void Pump() {
+        for (int i = 0; i < kMaxSendsPerPass; ++i) {
+            if (stopped_ || channel_->state() != webrtc::DataChannelInterface::kOpen ||
+                channel_->buffered_amount() >= high_watermark_) {
+                return;
+            }
+            if (!channel_->Send(webrtc::DataBuffer(payload_, true))) {
+                send_failures_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            messages_sent_.fetch_add(1, std::memory_order_relaxed);
+        }
+        webrtc::TaskQueueBase::Current()->PostTask([this] { Pump(); });
+    }
+
+    webrtc::CopyOnWriteBuffer payload_;
+    const uint64_t high_watermark_;
+    const uint64_t low_watermark_;
+    webrtc::scoped_refptr<webrtc::DataChannelInterface> channel_;
+    std::atomic<bool> stopped_{false};
+    std::atomic<uint64_t> messages_sent_{0};
+    std::atomic<uint64_t> send_failures_{0};
+};
+
+// Counts what arrives on the remote side of a bulk channel.
+class BulkReceiver : public DataChannelMessageHandler {
+public:
+    void Attach(DataChannelObserver* observer) { observer->SetMessageHandler(this); }
+
+    void OnMessage(std::span<const uint8_t> payload, bool, const webrtc::CopyOnWriteBuffer&) override {
+        bytes_.fetch_add(payload.size(), std::memory_order_relaxed);
+        messages_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    uint64_t bytes() const { return bytes_.load(std::memory_order_relaxed); }
+    uint64_t messages() const { return messages_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> bytes_{0};
+    std::atomic<uint64_t> messages_{0};
+};
+
+struct BulkOptions {
+    std::vector<int> message_sizes = {1024, 4096, 16384, 65536, 262144};
+    webrtc::TimeDelta warmup = webrtc::TimeDelta::Millis(500);
+    webrtc::TimeDelta duration = webrtc::TimeDelta::Seconds(5);
+    uint64_t high_watermark = 4 * 1024 * 1024;
+    uint64_t low_watermark = 1024 * 1024;
+    bool ordered = true;
+};
+
+// Measures sustained data channel throughput for each message size on a
+// fresh loopback pair.
+class BulkBenchmark {
+public:
+    BulkBenchmark(PeerConnectionFactoryPool* pool,
+                  webrtc::PeerConnectionInterface::RTCConfiguration config,
+                  BulkOptions options)
+        : pool_(pool), config_(config), options_(options) {
+        config_.servers.clear();
+    }
+
+    int Run() {
+        std::cout << "Bulk mode: " << (options_.ordered ? "ordered" : "unordered") << ", watermarks "
+                  << options_.low_watermark / 1024 << "/" << options_.high_watermark / 1024 << " KiB, "
+                  << options_.duration.ms() << " ms per size" << std::endl;
+        std::cout << std::setw(10) << "size" << std::setw(12) << "MB/s" << std::setw(12) << "msgs/s"
+                  << std::setw(12) << "CPU s" << std::setw(10) << "CPU %" << std::setw(10) << "failures"
+                  << std::endl;
+
+        int result = 0;
+        for (int size : options_.message_sizes) {
+            if (!RunOne(size)) {
+                result = -1;
+            }
+        }
+        return result;
+    }
+
+private:
+    bool RunOne(int message_size) {
+        webrtc::DataChannelInit dc_config;
+        dc_config.ordered = options_.ordered;
+
+        BulkSender sender(message_size, options_.high_watermark, options_.low_watermark);
+        BulkReceiver receiver;
+
+        ScopedLogLevel quiet(LogLevel::kWarning);
+        std::unique_ptr<BenchmarkPair> fixture =
+            BenchmarkPair::Create(pool_->Acquire(), pool_->Acquire(), config_, "Bulk", dc_config, "bulk");
+        if (!fixture) {
+            return false;
+        }
+        LoopbackPair* pair = fixture->pair();
+        sender.Attach(pair->observer1()->GetDataObserver());
+        receiver.Attach(pair->observer2()->GetDataObserver());
+
+        if (!fixture->Connect()) {
+            return false;
+        }
+
+        std::this_thread::sleep_for(std::chrono::microseconds(options_.warmup.us()));
+        const uint64_t bytes_start = receiver.bytes();
+        const uint64_t messages_start = receiver.messages();
+        const double cpu_start = ProcessStats::CpuSeconds();
+        const auto window_start = std::chrono::steady_clock::now();
+
+        std::this_thread::sleep_for(std::chrono::microseconds(options_.duration.us()));
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - window_start).count();
+        const uint64_t bytes = receiver.bytes() - bytes_start;
+        const uint64_t messages = receiver.messages() - messages_start;
+        const double cpu = ProcessStats::CpuSeconds() - cpu_start;
+
+        sender.Stop();
+        fixture->Close();
+
+        std::cout << std::fixed << std::setprecision(1) << std::setw(10) << message_size << std::setw(12)
+                  << bytes / seconds / 1e6 << std::setw(12) << messages / seconds << std::setw(12)
+                  << std::setprecision(2) << cpu << std::setw(10) << std::setprecision(0) << 100.0 * cpu / seconds
+                  << std::setw(10) << sender.send_failures() << std::defaultfloat << std::endl;
+        return bytes > 0;
+    }
+
+    PeerConnectionFactoryPool* pool_;
+    webrtc::PeerConnectionInterface::RTCConfiguration config_;
+    BulkOptions options_;
+};
@@ -0,0 +1 @@
+#include "command_line.h"
\ No newline at end of file
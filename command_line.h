@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdlib>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Minimal "--key=value" / "--flag" parser for selecting modes and their knobs.
+class CommandLine {
+public:
+    CommandLine(int argc, char* argv[]) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg.rfind("--", 0) != 0) {
+                continue;
+            }
+            arg.erase(0, 2);
+            const size_t eq = arg.find('=');
+            if (eq == std::string::npos) {
+                values_[arg] = "true";
+            } else {
+                values_[arg.substr(0, eq)] = arg.substr(eq + 1);
+            }
+        }
+    }
+
+    bool Has(const std::string& key) const { return values_.count(key) != 0; }
+
+    std::string GetString(const std::string& key, const std::string& fallback) const {
+        auto it = values_.find(key);
+        return it == values_.end() ? fallback : it->second;
+    }
+
+    int GetInt(const std::string& key, int fallback) const {
+        auto it = values_.find(key);
+        return it == values_.end() ? fallback : std::atoi(it->second.c_str());
+    }
+
+    // Comma-separated integers, e.g. --sizes=1024,4096,65536.
+    std::vector<int> GetIntList(const std::string& key, const std::vector<int>& fallback) const {
+        auto it = values_.find(key);
+        if (it == values_.end()) {
+            return fallback;
+        }
+        std::vector<int> list;
+        std::istringstream items(it->second);
+        std::string item;
+        while (std::getline(items, item, ',')) {
+            if (!item.empty()) {
+                list.push_back(std::atoi(item.c_str()));
+            }
+        }
+        return list;
+    }
+
+    // Comma-separated names, e.g. --links=lan,mobile.
+    std::vector<std::string> GetStringList(const std::string& key, const std::vector<std::string>& fallback) const {
+        auto it = values_.find(key);
+        if (it == values_.end()) {
+            return fallback;
+        }
+        std::vector<std::string> list;
+        std::istringstream items(it->second);
+        std::string item;
+        while (std::getline(items, item, ',')) {
+            if (!item.empty()) {
+                list.push_back(item);
+            }
+        }
+        return list;
+    }
+
+    bool GetBool(const std::string& key, bool fallback) const {
+        auto it = values_.find(key);
+        return it == values_.end() ? fallback : (it->second == "true" || it->second == "1");
+    }
+
+private:
+    std::map<std::string, std::string> values_;
+};
@@ -0,0 +1 @@
+#include "completion_signal.h"
\ No newline at end of file
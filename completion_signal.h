@@ -0,0 +1,54 @@
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include <api/rtc_error.h>
+
+// One-shot latched result that observers resolve from WebRTC threads.
+// Handlers subscribed after the result is latched run immediately on the
+// subscribing thread, so a waiter can never miss the callback.
+class CompletionSignal {
+public:
+    using Handler = std::function<void(webrtc::RTCError)>;
+
+    void Subscribe(Handler handler) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!result_) {
+            handlers_.push_back(std::move(handler));
+            return;
+        }
+        webrtc::RTCError result = *result_;
+        lock.unlock();
+        handler(std::move(result));
+    }
+
+    // Only the first call latches a result; later calls are ignored.
+    void Resolve(webrtc::RTCError result) {
+        std::vector<Handler> handlers;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (result_) {
+                return;
+            }
+            result_ = result;
+            handlers.swap(handlers_);
+        }
+        for (auto& handler : handlers) {
+            handler(result);
+        }
+    }
+
+    bool IsResolved() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return result_.has_value();
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::optional<webrtc::RTCError> result_;
+    std::vector<Handler> handlers_;
+};
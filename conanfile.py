@@ -4,7 +4,9 @@ from conan.tools.cmake import CMake, CMakeToolchain, cmake_layout
 
 class WebRTCExampleConan(ConanFile):
     settings = "os", "compiler", "build_type", "arch"
-    generators = "CMakeDeps", "CMakeToolchain"
+    options = {"network_emulation": [True, False], "allocation_counter": [True, False], "video_codecs": ["ANY"]}
+    default_options = {"network_emulation": False, "allocation_counter": False, "video_codecs": "VP8,VP9,H264,AV1"}
+    generators = "CMakeDeps"
 
     def validate(self):
         # Only allow Debug and RelWithDebInfo
@@ -25,6 +27,16 @@ class WebRTCExampleConan(ConanFile):
         # self.options["webrtc"].enable_rtti = False
         pass
 
+    def generate(self):
+        tc = CMakeToolchain(self)
+        # --mode=emulated; needs a WebRTC package built with rtc_include_tests=true
+        tc.cache_variables["WEBRTC_EXAMPLE_NETWORK_EMULATION"] = bool(self.options.network_emulation)
+        # Allocation counts in --mode=receive/send; replaces the global operator new
+        tc.cache_variables["WEBRTC_EXAMPLE_ALLOCATION_COUNTER"] = bool(self.options.allocation_counter)
+        # Comma-separated subset of VP8,VP9,H264,AV1, or "none" for data channels only
+        tc.cache_variables["WEBRTC_EXAMPLE_VIDEO_CODECS"] = str(self.options.video_codecs).replace(",", ";")
+        tc.generate()
+
     def layout(self):
         cmake_layout(self)
 
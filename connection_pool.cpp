@@ -0,0 +1 @@
+#include "connection_pool.h"
\ No newline at end of file
@@ -0,0 +1,321 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <api/data_channel_interface.h>
+#include <api/peer_connection_interface.h>
+#include <api/rtc_error.h>
+#include <api/units/time_delta.h>
+#include <rtc_base/event.h>
+#include <rtc_base/thread.h>
+#include <rtc_base/time_utils.h>
+
+#include "async_log.h"
+#include "data_channel_message_handler.h"
+#include "data_channel_observer.h"
+#include "factory_pool.h"
+#include "latency_stats.h"
+#include "loopback_pair.h"
+#include "task.h"
+
+// Keeps up to |size| loopback pairs connected, with their default channel
+// open at both ends, so a session can start sending without waiting for ICE,
+// DTLS and SCTP. A background thread tops the pool up; Checkout() takes a
+// warm pair if there is one and otherwise connects a new pair on the caller's
+// thread (a miss).
+//
+// A checked-out pair's channel is already open, so the open and
+// buffered-amount hooks no longer apply. Send with data_channel()->Send() and
+// receive through SetMessageHandler() on either side's default observer.
+// Return() keeps the pair if it is still connected with nothing buffered and
+// a marker sent each way after the session's messages comes back in time;
+// anything else is closed. Either way the message handlers are cleared and
+// no longer called once it returns. Only ordered channels are recycled: on
+// an unordered one the marker could overtake a session's last messages.
+class ConnectionPool {
+public:
+    struct Options {
+        int size = 4;
+        std::string name_prefix = "Pool.Peer";
+        std::string channel_label = "pooled";
+        // Pre-negotiated by default, so the channel opens with SCTP.
+        webrtc::DataChannelInit channel = NegotiatedChannel();
+        HandshakeTimeouts timeouts;
+        // Wait after a failed refill before trying again.
+        webrtc::TimeDelta refill_backoff = webrtc::TimeDelta::Millis(500);
+    };
+
+    static std::unique_ptr<ConnectionPool> Create(PeerConnectionFactoryPool* factories,
+                                                  webrtc::PeerConnectionInterface::RTCConfiguration config,
+                                                  Options options) {
+        std::unique_ptr<ConnectionPool> pool(new ConnectionPool(factories, config, options));
+        pool->refill_thread_ = std::thread([raw = pool.get()] { raw->RefillLoop(); });
+        return pool;
+    }
+
+    ~ConnectionPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        changed_.notify_all();
+        // Waits for a refill in progress; the handshake timeouts bound it.
+        refill_thread_.join();
+        idle_.clear();
+    }
+
+    // Connects a pair and waits until its default channel is open at both
+    // ends. This is the cold path a checkout miss takes.
+    static webrtc::RTCErrorOr<std::unique_ptr<LoopbackPair>> Connect(
+        PeerConnectionFactoryPool* factories,
+        const webrtc::PeerConnectionInterface::RTCConfiguration& config,
+        const Options& options) {
+        auto pair_result = LoopbackPair::Create(factories->Acquire(), factories->Acquire(), config,
+                                                options.name_prefix, options.channel, options.channel_label);
+        if (!pair_result.ok()) {
+            return pair_result.MoveError();
+        }
+        std::unique_ptr<LoopbackPair> pair = pair_result.MoveValue();
+
+        // Shared so a late open callback never touches a dead Event. The
+        // handlers also stop the observers from sending their hello message.
+        auto local_open = std::make_shared<webrtc::Event>();
+        auto remote_open = std::make_shared<webrtc::Event>();
+        pair->observer1()->GetDataObserver()->SetOpenHandler([local_open] { local_open->Set(); });
+        pair->observer2()->GetDataObserver()->SetOpenHandler([remote_open] { remote_open->Set(); });
+
+        webrtc::RTCError error = SyncWait(pair->Connect(options.timeouts));
+        if (!error.ok()) {
+            return error;
+        }
+        if (!local_open->Wait(options.timeouts.first_message) || !remote_open->Wait(options.timeouts.first_message)) {
+            return webrtc::RTCError(webrtc::RTCErrorType::INTERNAL_ERROR, "Pooled data channel open timed out");
+        }
+        return pair;
+    }
+
+    // Returns a connected pair with its channel open, or nullptr if none was
+    // warm and connecting a new one failed.
+    std::unique_ptr<LoopbackPair> Checkout() {
+        const int64_t start_us = webrtc::TimeMicros();
+        std::unique_ptr<LoopbackPair> pair = TakeIdle();
+        // Idle pairs are checked outside the lock; a stale one is closed and
+        // the next one tried.
+        while (pair && !IsReusable(*pair)) {
+            pair = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                ++discarded_;
+            }
+            pair = TakeIdle();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pair ? ++hits_ : ++misses_;
+        }
+        changed_.notify_all();
+
+        if (!pair) {
+            auto result = Connect(factories_, config_, options_);
+            if (!result.ok()) {
+                ASYNC_LOG(kWarning, options_.name_prefix, "Checkout failed", nullptr, result.error().message());
+                return nullptr;
+            }
+            pair = result.MoveValue();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        checkout_latency_.Add((webrtc::TimeMicros() - start_us) / 1000.0);
+        return pair;
+    }
+
+    // Hands a pair back. It goes back into the pool if it is still usable
+    // and the pool has room; otherwise it is closed.
+    void Return(std::unique_ptr<LoopbackPair> pair) {
+        if (!pair) {
+            return;
+        }
+        if (IsReusable(*pair) && Drain(*pair)) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!stopping_ && static_cast<int>(idle_.size()) < options_.size) {
+                idle_.push_back(std::move(pair));
+                ++recycled_;
+                return;
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++discarded_;
+        }
+        pair->observer1()->GetDataObserver()->SetMessageHandler(nullptr);
+        pair->observer2()->GetDataObserver()->SetMessageHandler(nullptr);
+        pair = nullptr;
+    }
+
+    void PrintStats(std::ostream& out) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const uint64_t checkouts = hits_ + misses_;
+        out << std::fixed << "Connection pool: " << idle_.size() << "/" << options_.size << " warm, "
+            << std::setprecision(1) << (checkouts ? 100.0 * hits_ / checkouts : 0.0) << "% hit rate (" << hits_
+            << " hits, " << misses_ << " misses), " << recycled_ << " recycled, " << discarded_ << " discarded, "
+            << refills_ << " refills (" << refill_failures_ << " failed)" << std::endl;
+        out << "    checkout p50 " << std::setprecision(3) << checkout_latency_.Percentile(50) << " ms, p99 "
+            << checkout_latency_.Percentile(99) << " ms, max " << checkout_latency_.Max() << " ms"
+            << std::defaultfloat << std::endl;
+    }
+
+    // Blocks until the pool is full or |timeout| passes; true if full.
+    bool WaitWarm(webrtc::TimeDelta timeout) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return changed_.wait_for(lock, std::chrono::microseconds(timeout.us()),
+                                 [this] { return static_cast<int>(idle_.size()) >= options_.size; });
+    }
+
+    uint64_t hits() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return hits_;
+    }
+    uint64_t misses() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return misses_;
+    }
+
+private:
+    ConnectionPool(PeerConnectionFactoryPool* factories,
+                   webrtc::PeerConnectionInterface::RTCConfiguration config,
+                   Options options)
+        : factories_(factories), config_(config), options_(options) {}
+
+    // Waits for the marker that follows the last session's messages.
+    class DrainHandler : public DataChannelMessageHandler {
+    public:
+        void OnMessage(std::span<const uint8_t> payload, bool, const webrtc::CopyOnWriteBuffer&) override {
+            if (std::string_view(reinterpret_cast<const char*>(payload.data()), payload.size()) == kDrainMarker) {
+                arrived_.Set();
+            }
+        }
+
+        bool Wait(webrtc::TimeDelta timeout) { return arrived_.Wait(timeout); }
+
+    private:
+        webrtc::Event arrived_;
+    };
+
+    static constexpr std::string_view kDrainMarker{"\0ConnectionPool.drain", 21};
+
+    static webrtc::DataChannelInit NegotiatedChannel() {
+        webrtc::DataChannelInit init;
+        init.ordered = true;
+        init.negotiated = true;
+        init.id = 0;
+        return init;
+    }
+
+    std::unique_ptr<LoopbackPair> TakeIdle() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (idle_.empty()) {
+            return nullptr;
+        }
+        std::unique_ptr<LoopbackPair> pair = std::move(idle_.front());
+        idle_.pop_front();
+        return pair;
+    }
+
+    // Still connected, channel open at both ends and nothing left to send.
+    // Each check is a hop to the signaling or network thread.
+    static bool IsReusable(LoopbackPair& pair) {
+        webrtc::scoped_refptr<webrtc::DataChannelInterface> local = pair.data_channel();
+        webrtc::scoped_refptr<webrtc::DataChannelInterface> remote = pair.observer2()->GetDataObserver()->data_channel();
+        return pair.offerer().pc->peer_connection_state() ==
+                   webrtc::PeerConnectionInterface::PeerConnectionState::kConnected &&
+               local && local->state() == webrtc::DataChannelInterface::kOpen && local->buffered_amount() == 0 &&
+               remote && remote->state() == webrtc::DataChannelInterface::kOpen && remote->buffered_amount() == 0;
+    }
+
+    // Sends a marker each way behind whatever the last session left in
+    // flight and waits for both, so none of it reaches the next session's
+    // handlers. Clears the handlers and flushes both network threads before
+    // returning; false if the channel is unordered or a marker is lost.
+    bool Drain(LoopbackPair& pair) {
+        DataChannelObserver* local = pair.observer1()->GetDataObserver();
+        DataChannelObserver* remote = pair.observer2()->GetDataObserver();
+        DrainHandler local_drain;
+        DrainHandler remote_drain;
+        local->SetMessageHandler(&local_drain);
+        remote->SetMessageHandler(&remote_drain);
+
+        const webrtc::DataBuffer marker{std::string(kDrainMarker)};
+        const bool drained = options_.channel.ordered && pair.data_channel()->Send(marker) &&
+                             remote->data_channel()->Send(marker) &&
+                             remote_drain.Wait(options_.timeouts.first_message) &&
+                             local_drain.Wait(options_.timeouts.first_message);
+
+        local->SetMessageHandler(nullptr);
+        remote->SetMessageHandler(nullptr);
+        // A delivery that picked up a drain handler before it was cleared
+        // has finished once these return.
+        pair.network_thread1()->BlockingCall([] {});
+        pair.network_thread2()->BlockingCall([] {});
+        return drained;
+    }
+
+    void RefillLoop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            changed_.wait(lock, [this] { return stopping_ || static_cast<int>(idle_.size()) < options_.size; });
+            if (stopping_) {
+                return;
+            }
+            lock.unlock();
+            auto result = Connect(factories_, config_, options_);
+            lock.lock();
+            if (!result.ok()) {
+                ++refill_failures_;
+                ASYNC_LOG(kWarning, options_.name_prefix, "Refill failed", nullptr, result.error().message());
+                changed_.wait_for(lock, std::chrono::microseconds(options_.refill_backoff.us()),
+                                  [this] { return stopping_; });
+                continue;
+            }
+            ++refills_;
+            if (!stopping_ && static_cast<int>(idle_.size()) < options_.size) {
+                idle_.push_back(result.MoveValue());
+                changed_.notify_all();
+                continue;
+            }
+            // Return() filled the pool meanwhile; close the extra pair
+            // without holding the lock.
+            std::unique_ptr<LoopbackPair> extra = result.MoveValue();
+            lock.unlock();
+            extra = nullptr;
+            lock.lock();
+        }
+    }
+
+    PeerConnectionFactoryPool* factories_;
+    const webrtc::PeerConnectionInterface::RTCConfiguration config_;
+    const Options options_;
+
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::deque<std::unique_ptr<LoopbackPair>> idle_;
+    bool stopping_ = false;
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+    uint64_t recycled_ = 0;
+    uint64_t discarded_ = 0;
+    uint64_t refills_ = 0;
+    uint64_t refill_failures_ = 0;
+    LatencyStats checkout_latency_;
+    std::thread refill_thread_;
+};
@@ -0,0 +1 @@
+#include "data_channel_message_handler.h"
\ No newline at end of file
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+
+#include <rtc_base/copy_on_write_buffer.h>
+
+// Receives data channel messages without copying them. |payload| views the
+// bytes of |buffer| and is only valid during the call; to keep the message or
+// hand it to another thread, copy |buffer| instead, which only takes a
+// reference on the underlying storage.
+//
+// Called on the network thread (DataChannelObserver opts in to network-thread
+// delivery), so implementations must not block.
+class DataChannelMessageHandler {
+public:
+    virtual ~DataChannelMessageHandler() = default;
+
+    virtual void OnMessage(std::span<const uint8_t> payload, bool binary, const webrtc::CopyOnWriteBuffer& buffer) = 0;
+};
@@ -1,8 +1,21 @@
 #pragma once
 
-#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <span>
 #include <string>
+#include <string_view>
 #include <api/data_channel_interface.h>
+#include <api/scoped_refptr.h>
+#include <rtc_base/copy_on_write_buffer.h>
+
+#include "async_log.h"
+#include "completion_signal.h"
+#include "data_channel_message_handler.h"
+#include "handshake_trace.h"
+#include "send_buffer_pool.h"
 
 class DataChannelObserver : public webrtc::DataChannelObserver {
 public:
@@ -11,30 +24,40 @@ public:
     void OnStateChange() override {
         if (data_channel_) {
             webrtc::DataChannelInterface::DataState state = data_channel_->state();
-            std::cout << "[" << label_ << "] Data channel state: ";
-
-            switch (state) {
-                case webrtc::DataChannelInterface::kConnecting:
-                    std::cout << "Connecting" << std::endl;
-                    break;
-                case webrtc::DataChannelInterface::kOpen:
-                    std::cout << "Open" << std::endl;
+            ASYNC_LOG(kInfo, label_, "Data channel state", DataStateToString(state));
+            if (state == webrtc::DataChannelInterface::kOpen) {
+                HandshakeTrace::Instant(trace_track_, "data channel open");
+                if (on_open_) {
+                    on_open_();
+                } else {
                     SendHelloMessage();
-                    break;
-                case webrtc::DataChannelInterface::kClosing:
-                    std::cout << "Closing" << std::endl;
-                    break;
-                case webrtc::DataChannelInterface::kClosed:
-                    std::cout << "Closed" << std::endl;
-                    break;
+                }
             }
         }
     }
 
     void OnMessage(const webrtc::DataBuffer& buffer) override {
-        std::string message(buffer.data.data<char>(), buffer.data.size());
-        std::cout << "[" << label_ << "] Received: " << message << std::endl;
-        message_received_ = true;
+        std::span<const uint8_t> payload(buffer.data.cdata(), buffer.data.size());
+        if (DataChannelMessageHandler* handler = message_handler_.load(std::memory_order_acquire)) {
+            handler->OnMessage(payload, buffer.binary, buffer.data);
+        } else {
+            ASYNC_LOG(kInfo, label_, "Received", nullptr,
+                      std::string_view(reinterpret_cast<const char*>(payload.data()), payload.size()));
+        }
+        if (!message_received_.exchange(true)) {
+            HandshakeTrace::Instant(trace_track_, "first message");
+            first_message_.Resolve(webrtc::RTCError::OK());
+        }
+    }
+
+    // Deliver callbacks straight from the network thread instead of hopping
+    // every message over to the signaling thread.
+    bool IsOkToCallOnTheNetworkThread() override { return true; }
+
+    void OnBufferedAmountChange(uint64_t sent_data_size) override {
+        if (on_buffered_amount_change_) {
+            on_buffered_amount_change_(sent_data_size);
+        }
     }
 
     void SetDataChannel(webrtc::scoped_refptr<webrtc::DataChannelInterface> channel) {
@@ -44,18 +67,118 @@ public:
         }
     }
 
+    // Hooks for modes that drive the channel themselves; set them before the
+    // channel opens. They run on the network thread. |on_open| replaces the
+    // hello message and |handler| (not owned) the console echo. The message
+    // handler alone may also be swapped while the channel is open; a
+    // delivery already in progress may still reach the previous one.
+    void SetOpenHandler(std::function<void()> on_open) { on_open_ = std::move(on_open); }
+    void SetBufferedAmountHandler(std::function<void(uint64_t)> on_change) {
+        on_buffered_amount_change_ = std::move(on_change);
+    }
+    void SetMessageHandler(DataChannelMessageHandler* handler) {
+        message_handler_.store(handler, std::memory_order_release);
+    }
+
+    // The HandshakeTrace track the open and first message milestones go to;
+    // set by the owning SimplePeerConnectionObserver.
+    void SetTraceTrack(uint32_t track) { trace_track_ = track; }
+
+    // Send buffers for Send() come from |pool| instead of the heap. Set it
+    // before the channel opens.
+    void SetSendBufferPool(webrtc::scoped_refptr<SendBufferPool> pool) { send_pool_ = std::move(pool); }
+
+    // Sends a |size|-byte message that |write| serializes in place: it is
+    // called with |size| writable bytes and must fill all of them. With a
+    // pool and a message that fits a size class, nothing is allocated for
+    // the buffer once the pool is warm. Call on the network thread, where
+    // the data channel proxy calls straight through.
+    template <typename Write>
+    bool Send(size_t size, bool binary, Write&& write) {
+        if (!data_channel_) {
+            return false;
+        }
+        if (holding_) {
+            if (held_bytes_ + size > max_held_bytes_) {
+                return false;
+            }
+            webrtc::CopyOnWriteBuffer buffer(size);
+            write(buffer.MutableData());
+            held_.emplace_back(buffer, binary);
+            held_bytes_ += size;
+            return true;
+        }
+        webrtc::CopyOnWriteBuffer buffer = send_pool_ ? send_pool_->Acquire(size) : webrtc::CopyOnWriteBuffer(size);
+        write(buffer.MutableData());
+        const bool sent = data_channel_->Send(webrtc::DataBuffer(buffer, binary));
+        if (send_pool_) {
+            send_pool_->Recycle(std::move(buffer));
+        }
+        return sent;
+    }
+
+    // While held, Send() queues up to |max_held_bytes| of messages here
+    // instead of handing them to a channel whose connection is down, and
+    // ReleaseSends() sends them in order once it is back. Nothing waits in
+    // SCTP behind a dead path and its backed-off retransmission timer. Call
+    // both on the network thread.
+    void HoldSends(size_t max_held_bytes) {
+        holding_ = true;
+        max_held_bytes_ = max_held_bytes;
+    }
+
+    // Returns the number of held messages sent.
+    size_t ReleaseSends() {
+        holding_ = false;
+        size_t sent = 0;
+        for (const webrtc::DataBuffer& buffer : held_) {
+            if (data_channel_ && data_channel_->Send(buffer)) {
+                ++sent;
+            }
+        }
+        if (sent < held_.size()) {
+            ASYNC_LOG(kWarning, label_, "Failed to send held messages", nullptr,
+                      std::to_string(held_.size() - sent));
+        }
+        held_.clear();
+        held_bytes_ = 0;
+        return sent;
+    }
+
+    webrtc::scoped_refptr<webrtc::DataChannelInterface> data_channel() const { return data_channel_; }
+
     bool HasReceivedMessage() const { return message_received_.load(); }
 
+    // Resolved by the first OnMessage() on this channel.
+    CompletionSignal& FirstMessage() { return first_message_; }
+
 private:
+    static const char* DataStateToString(webrtc::DataChannelInterface::DataState state) {
+        switch (state) {
+            case webrtc::DataChannelInterface::kConnecting: return "Connecting";
+            case webrtc::DataChannelInterface::kOpen: return "Open";
+            case webrtc::DataChannelInterface::kClosing: return "Closing";
+            case webrtc::DataChannelInterface::kClosed: return "Closed";
+            default: return "Unknown";
+        }
+    }
+
     void SendHelloMessage() {
         if (data_channel_ && data_channel_->state() == webrtc::DataChannelInterface::kOpen) {
-            std::string msg = "Hello from " + label_ + "!";
-            webrtc::DataBuffer buffer(msg);
-
-            if (data_channel_->Send(buffer)) {
-                std::cout << "[" << label_ << "] Sent: " << msg << std::endl;
+            static constexpr std::string_view kPrefix = "Hello from ";
+            const size_t size = kPrefix.size() + label_.size() + 1;
+            // The log keeps no more than this of the message anyway.
+            char logged[LogRecord::kDetailBytes];
+            const bool sent = Send(size, false, [this, size, &logged](uint8_t* out) {
+                uint8_t* end = std::copy(kPrefix.begin(), kPrefix.end(), out);
+                end = std::copy(label_.begin(), label_.end(), end);
+                *end = '!';
+                std::copy_n(out, std::min(size, sizeof(logged)), logged);
+            });
+            if (sent) {
+                ASYNC_LOG(kInfo, label_, "Sent", nullptr, std::string_view(logged, std::min(size, sizeof(logged))));
             } else {
-                std::cout << "[" << label_ << "] Failed to send message" << std::endl;
+                ASYNC_LOG(kWarning, label_, "Failed to send message");
             }
         }
     }
@@ -63,4 +186,17 @@ private:
     std::string label_;
     webrtc::scoped_refptr<webrtc::DataChannelInterface> data_channel_;
     std::atomic<bool> message_received_{false};
+    CompletionSignal first_message_;
+
+    std::function<void()> on_open_;
+    std::function<void(uint64_t)> on_buffered_amount_change_;
+    std::atomic<DataChannelMessageHandler*> message_handler_{nullptr};
+    webrtc::scoped_refptr<SendBufferPool> send_pool_;
+    uint32_t trace_track_ = 0;
+
+    // Held sends; network thread only.
+    bool holding_ = false;
+    size_t max_held_bytes_ = 0;
+    size_t held_bytes_ = 0;
+    std::deque<webrtc::DataBuffer> held_;
 };
@@ -0,0 +1 @@
+#include "emulation_benchmark.h"
\ No newline at end of file
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <api/data_channel_interface.h>
+#include <api/peer_connection_interface.h>
+#include <api/units/time_delta.h>
+
+#include "async_log.h"
+#include "benchmark_pair.h"
+#include "latency_recording_handler.h"
+#include "loopback_pair.h"
+#include "network_emulation.h"
+#include "paced_sender.h"
+#include "task.h"
+
+// A data channel configuration in the matrix.
+struct ChannelVariant {
+    std::string name;
+    webrtc::DataChannelInit init;
+};
+
+inline std::vector<ChannelVariant> DefaultChannelVariants() {
+    std::vector<ChannelVariant> variants(4);
+    variants[0].name = "ordered";
+    variants[0].init.ordered = true;
+    variants[1].name = "unordered";
+    variants[1].init.ordered = false;
+    variants[2].name = "unord/rtx=0";
+    variants[2].init.ordered = false;
+    variants[2].init.maxRetransmits = 0;
+    variants[3].name = "unord/100ms";
+    variants[3].init.ordered = false;
+    variants[3].init.maxRetransmitTime = 100;
+    return variants;
+}
+
+struct EmulationOptions {
+    std::vector<LinkProfile> profiles = DefaultLinkProfiles();
+    std::vector<ChannelVariant> channels = DefaultChannelVariants();
+    int message_size = 1024;
+    // Offered load in messages per second.
+    int rate = 1000;
+    webrtc::TimeDelta warmup = webrtc::TimeDelta::Seconds(1);
+    webrtc::TimeDelta duration = webrtc::TimeDelta::Seconds(5);
+    // Time after sending stops for in-flight messages to arrive.
+    webrtc::TimeDelta drain = webrtc::TimeDelta::Seconds(1);
+    uint64_t high_watermark = 1024 * 1024;
+};
+
+// Runs a paced data channel stream over every (link profile, channel
+// variant) cell of the matrix, each on a fresh emulated network, and
+// reports goodput, delivery ratio and one-way latency.
+class EmulationBenchmark {
+public:
+    EmulationBenchmark(webrtc::PeerConnectionInterface::RTCConfiguration config, EmulationOptions options)
+        : config_(config), options_(options) {
+        // Emulated endpoints only have host candidates.
+        config_.servers.clear();
+        options_.message_size = std::max<int>(options_.message_size, kTimestampBytes);
+    }
+
+    int Run() {
+        std::cout << "Emulated mode: " << options_.message_size << " byte messages offered at " << options_.rate
+                  << " msgs/s, " << options_.duration.ms() << " ms per cell" << std::endl;
+        std::cout << std::setw(10) << "link" << std::setw(14) << "channel" << std::setw(10) << "MB/s"
+                  << std::setw(10) << "sent/s" << std::setw(12) << "delivered" << std::setw(10) << "p50 ms"
+                  << std::setw(10) << "p99 ms" << std::endl;
+
+        int result = 0;
+        for (const LinkProfile& profile : options_.profiles) {
+            for (const ChannelVariant& channel : options_.channels) {
+                if (!RunOne(profile, channel)) {
+                    result = -1;
+                }
+            }
+        }
+        return result;
+    }
+
+private:
+    bool RunOne(const LinkProfile& profile, const ChannelVariant& variant) {
+        std::unique_ptr<EmulatedNetwork> network = EmulatedNetwork::Create(profile);
+        if (!network) {
+            std::cerr << "Failed to create emulated network for " << profile.name << std::endl;
+            return false;
+        }
+
+        PacedSender sender(options_.message_size, options_.rate, options_.high_watermark);
+        LatencyRecordingHandler recorder;
+
+        ScopedLogLevel quiet(LogLevel::kWarning);
+        std::unique_ptr<BenchmarkPair> fixture =
+            BenchmarkPair::Create(network->shard1()->Acquire(), network->shard2()->Acquire(), config_,
+                                  profile.name + "/" + variant.name, variant.init, "emulated");
+        if (!fixture) {
+            return false;
+        }
+        LoopbackPair* pair = fixture->pair();
+        sender.Attach(pair->observer1()->GetDataObserver());
+        pair->observer2()->GetDataObserver()->SetMessageHandler(&recorder);
+
+        // Slow links need longer than the loopback defaults to connect.
+        HandshakeTimeouts timeouts;
+        timeouts.connection = webrtc::TimeDelta::Seconds(30);
+        if (!fixture->Connect(timeouts)) {
+            return false;
+        }
+
+        std::this_thread::sleep_for(std::chrono::microseconds(options_.warmup.us()));
+        const uint64_t received_start = recorder.messages();
+        const uint64_t sent_start = sender.messages_sent();
+        recorder.StartMeasuring();
+        const auto window_start = std::chrono::steady_clock::now();
+        std::this_thread::sleep_for(std::chrono::microseconds(options_.duration.us()));
+        recorder.StopMeasuring();
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - window_start).count();
+        const uint64_t received = recorder.messages() - received_start;
+        const uint64_t sent = sender.messages_sent() - sent_start;
+
+        sender.Stop();
+        std::this_thread::sleep_for(std::chrono::microseconds(options_.drain.us()));
+        const uint64_t sent_total = sender.messages_sent();
+        const uint64_t received_total = recorder.messages();
+
+        fixture->Close();
+
+        LatencyStats& latency = recorder.latency();
+        std::cout << std::fixed << std::setw(10) << profile.name << std::setw(14) << variant.name
+                  << std::setprecision(2) << std::setw(10) << received * options_.message_size / seconds / 1e6
+                  << std::setprecision(0) << std::setw(10) << sent / seconds << std::setprecision(1)
+                  << std::setw(11) << (sent_total ? 100.0 * received_total / sent_total : 0.0) << "%"
+                  << std::setprecision(2) << std::setw(10) << latency.Percentile(50) << std::setw(10)
+                  << latency.Percentile(99) << std::defaultfloat << std::endl;
+        return received > 0;
+    }
+
+    webrtc::PeerConnectionInterface::RTCConfiguration config_;
+    EmulationOptions options_;
+};
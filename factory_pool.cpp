@@ -0,0 +1 @@
+#include "factory_pool.h"
\ No newline at end of file
@@ -0,0 +1,276 @@
+#pragma once
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <api/audio/audio_device.h>
+#include <api/peer_connection_interface.h>
+#if defined(WEBRTC_EXAMPLE_DATA_ONLY)
+#include <api/task_queue/default_task_queue_factory.h>
+#else
+#include <api/create_peerconnection_factory.h>
+#include <api/audio_codecs/builtin_audio_decoder_factory.h>
+#include <api/audio_codecs/builtin_audio_encoder_factory.h>
+// #include <api/video_codecs/builtin_video_decoder_factory.h>
+// #include <api/video_codecs/builtin_video_encoder_factory.h>
+#endif
+#include <rtc_base/thread.h>
+
+#include "video_codec_config.h"
+
+// One PeerConnectionFactory with its own network/worker/signaling threads.
+// Every PeerConnection created from it runs its ICE, DTLS and SCTP work on
+// this shard's network thread.
+class FactoryShard {
+public:
+    // Counts one connection against the shard for as long as it is alive.
+    class Lease {
+    public:
+        Lease() = default;
+        explicit Lease(FactoryShard* shard) : shard_(shard) {
+            ++shard_->active_connections_;
+            ++shard_->total_connections_;
+        }
+        Lease(Lease&& other) noexcept : shard_(std::exchange(other.shard_, nullptr)) {}
+        Lease& operator=(Lease&& other) noexcept {
+            Reset();
+            shard_ = std::exchange(other.shard_, nullptr);
+            return *this;
+        }
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        ~Lease() { Reset(); }
+
+        void Reset() {
+            if (shard_) {
+                --shard_->active_connections_;
+                shard_ = nullptr;
+            }
+        }
+
+        FactoryShard* shard() const { return shard_; }
+        webrtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> factory() const { return shard_->factory(); }
+        webrtc::Thread* signaling_thread() const { return shard_->signaling_thread(); }
+        webrtc::Thread* network_thread() const { return shard_->network_thread(); }
+
+    private:
+        FactoryShard* shard_ = nullptr;
+    };
+
+    // Builds the audio device for the factory of shard |index|.
+    using AudioDeviceBuilder = std::function<webrtc::scoped_refptr<webrtc::AudioDeviceModule>(int index)>;
+
+    // |cpu| < 0 leaves the threads unpinned. Without |audio_device| the
+    // factory uses the platform's default audio device.
+    static std::unique_ptr<FactoryShard> Create(int index, int cpu, const AudioDeviceBuilder& audio_device = nullptr) {
+        std::unique_ptr<FactoryShard> shard(new FactoryShard(index));
+
+        // Create threads
+        shard->network_thread_ = webrtc::Thread::CreateWithSocketServer();
+        shard->worker_thread_ = webrtc::Thread::Create();
+        shard->signaling_thread_ = webrtc::Thread::Create();
+
+        const std::string suffix = "-" + std::to_string(index);
+        shard->network_thread_->SetName("network" + suffix, nullptr);
+        shard->worker_thread_->SetName("worker" + suffix, nullptr);
+        shard->signaling_thread_->SetName("signaling" + suffix, nullptr);
+
+        shard->network_thread_->Start();
+        shard->network_ = shard->network_thread_.get();
+        shard->worker_thread_->Start();
+        shard->signaling_thread_->Start();
+
+        if (cpu >= 0) {
+            PinToCpu(shard->network_thread_.get(), cpu);
+            PinToCpu(shard->worker_thread_.get(), cpu);
+            PinToCpu(shard->signaling_thread_.get(), cpu);
+            shard->cpu_ = cpu;
+        }
+
+        shard->factory_ = CreateFactory(shard->network_thread_.get(), shard->worker_thread_.get(),
+                                        shard->signaling_thread_.get(), audio_device ? audio_device(index) : nullptr);
+        if (!shard->factory_) {
+            return nullptr;
+        }
+        return shard;
+    }
+
+    using FactoryBuilder = std::function<webrtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface>(
+        webrtc::Thread* network_thread, webrtc::Thread* worker_thread, webrtc::Thread* signaling_thread)>;
+
+    // A shard that runs on a network thread owned elsewhere (e.g. by the
+    // network emulation) and builds its factory with |build|. Only the
+    // worker and signaling threads belong to the shard.
+    static std::unique_ptr<FactoryShard> CreateOnNetworkThread(int index,
+                                                               webrtc::Thread* network_thread,
+                                                               const FactoryBuilder& build) {
+        std::unique_ptr<FactoryShard> shard(new FactoryShard(index));
+        shard->network_ = network_thread;
+        shard->worker_thread_ = webrtc::Thread::Create();
+        shard->signaling_thread_ = webrtc::Thread::Create();
+
+        const std::string suffix = "-" + std::to_string(index);
+        shard->worker_thread_->SetName("worker" + suffix, nullptr);
+        shard->signaling_thread_->SetName("signaling" + suffix, nullptr);
+        shard->worker_thread_->Start();
+        shard->signaling_thread_->Start();
+
+        shard->factory_ = build(network_thread, shard->worker_thread_.get(), shard->signaling_thread_.get());
+        if (!shard->factory_) {
+            return nullptr;
+        }
+        return shard;
+    }
+
+    // Media engines and video codecs as configured in video_codec_config.h.
+    // Data-only builds have no audio engine and ignore |audio_device|.
+    static webrtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> CreateFactory(
+        webrtc::Thread* network_thread,
+        webrtc::Thread* worker_thread,
+        webrtc::Thread* signaling_thread,
+        webrtc::scoped_refptr<webrtc::AudioDeviceModule> audio_device = nullptr) {
+#if defined(WEBRTC_EXAMPLE_DATA_ONLY)
+        webrtc::PeerConnectionFactoryDependencies deps;
+        deps.network_thread = network_thread;
+        deps.worker_thread = worker_thread;
+        deps.signaling_thread = signaling_thread;
+        deps.task_queue_factory = webrtc::CreateDefaultTaskQueueFactory();
+        return webrtc::CreateModularPeerConnectionFactory(std::move(deps));
+#else
+        return webrtc::CreatePeerConnectionFactory(
+            network_thread,
+            worker_thread,
+            signaling_thread,
+            audio_device,
+            webrtc::CreateBuiltinAudioEncoderFactory(),
+            webrtc::CreateBuiltinAudioDecoderFactory(),
+            // https://issues.webrtc.org/issues/42223784#comment26
+            // webrtc::CreateBuiltinVideoEncoderFactory(),
+            // webrtc::CreateBuiltinVideoDecoderFactory(),
+            std::make_unique<video_codec_config::EncoderFactory>(),
+            std::make_unique<video_codec_config::DecoderFactory>(),
+            nullptr, // audio mixer
+            nullptr  // audio processing
+        );
+#endif
+    }
+
+    ~FactoryShard() {
+        // The factory must go before the threads it runs on.
+        factory_ = nullptr;
+    }
+
+    Lease Acquire() { return Lease(this); }
+
+    int index() const { return index_; }
+    int cpu() const { return cpu_; }
+    int active_connections() const { return active_connections_.load(); }
+    int64_t total_connections() const { return total_connections_.load(); }
+
+    webrtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> factory() const { return factory_; }
+    webrtc::Thread* network_thread() const { return network_; }
+    webrtc::Thread* worker_thread() const { return worker_thread_.get(); }
+    webrtc::Thread* signaling_thread() const { return signaling_thread_.get(); }
+
+private:
+    explicit FactoryShard(int index) : index_(index) {}
+
+    static void PinToCpu(webrtc::Thread* thread, int cpu) {
+        thread->BlockingCall([cpu] {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(cpu, &cpus);
+            if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0) {
+                std::cerr << "Failed to pin thread to CPU " << cpu << std::endl;
+            }
+        });
+    }
+
+    int index_;
+    int cpu_ = -1;
+    // Null when the network thread is owned elsewhere; |network_| is always set.
+    std::unique_ptr<webrtc::Thread> network_thread_;
+    webrtc::Thread* network_ = nullptr;
+    std::unique_ptr<webrtc::Thread> worker_thread_;
+    std::unique_ptr<webrtc::Thread> signaling_thread_;
+    webrtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> factory_;
+    std::atomic<int> active_connections_{0};
+    std::atomic<int64_t> total_connections_{0};
+};
+
+enum class ShardPlacement {
+    kRoundRobin,
+    kLeastLoaded,
+};
+
+// K factory shards; new connections are spread across them so network work
+// scales with cores instead of serializing on one network thread.
+class PeerConnectionFactoryPool {
+public:
+    struct Options {
+        int shards = 1;
+        bool pin_cpus = false;
+        ShardPlacement placement = ShardPlacement::kRoundRobin;
+        // Unset: the platform's default audio device.
+        FactoryShard::AudioDeviceBuilder audio_device;
+    };
+
+    static std::unique_ptr<PeerConnectionFactoryPool> Create(const Options& options) {
+        std::unique_ptr<PeerConnectionFactoryPool> pool(new PeerConnectionFactoryPool(options.placement));
+        const int cpus = std::max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+        for (int i = 0; i < std::max(1, options.shards); ++i) {
+            auto shard = FactoryShard::Create(i, options.pin_cpus ? i % cpus : -1, options.audio_device);
+            if (!shard) {
+                std::cerr << "Failed to create PeerConnectionFactory for shard " << i << std::endl;
+                return nullptr;
+            }
+            pool->shards_.push_back(std::move(shard));
+        }
+        return pool;
+    }
+
+    // Picks a shard for a new PeerConnection according to the placement.
+    FactoryShard::Lease Acquire() {
+        if (placement_ == ShardPlacement::kLeastLoaded) {
+            FactoryShard* least = shards_.front().get();
+            for (const auto& shard : shards_) {
+                if (shard->active_connections() < least->active_connections()) {
+                    least = shard.get();
+                }
+            }
+            return least->Acquire();
+        }
+        const uint64_t next = next_shard_.fetch_add(1, std::memory_order_relaxed);
+        return shards_[next % shards_.size()]->Acquire();
+    }
+
+    size_t size() const { return shards_.size(); }
+    FactoryShard* shard(size_t index) const { return shards_[index].get(); }
+
+    void PrintLoad(std::ostream& out) const {
+        out << "Factory shards:" << std::endl;
+        for (const auto& shard : shards_) {
+            out << "    shard " << shard->index() << (shard->cpu() >= 0 ? " (cpu " + std::to_string(shard->cpu()) + ")" : "")
+                << ": " << shard->active_connections() << " active, " << shard->total_connections() << " total"
+                << std::endl;
+        }
+    }
+
+private:
+    explicit PeerConnectionFactoryPool(ShardPlacement placement) : placement_(placement) {}
+
+    ShardPlacement placement_;
+    std::vector<std::unique_ptr<FactoryShard>> shards_;
+    std::atomic<uint64_t> next_shard_{0};
+};
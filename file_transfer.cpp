@@ -0,0 +1 @@
+#include "file_transfer.h"
\ No newline at end of file
@@ -0,0 +1,623 @@
+#pragma once
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <api/data_channel_interface.h>
+#include <api/peer_connection_interface.h>
+#include <api/task_queue/task_queue_base.h>
+#include <api/units/time_delta.h>
+#include <rtc_base/copy_on_write_buffer.h>
+#include <rtc_base/crc32.h>
+
+#include "async_log.h"
+#include "benchmark_pair.h"
+#include "data_channel_message_handler.h"
+#include "data_channel_observer.h"
+#include "factory_pool.h"
+#include "loopback_pair.h"
+#include "mapped_file.h"
+#include "process_stats.h"
+#include "task.h"
+
+// Messages on a file transfer channel, all binary with big-endian integers:
+//
+//   kOffer  u8 type | u64 file size | u32 chunk size      sender -> receiver
+//   kHave   u8 type | u32 first chunk | u8 last | bitmap   receiver -> sender
+//   kChunk  u8 type | u32 index | u32 CRC-32 | payload     sender -> receiver
+//   kNack   u8 type | u32 index                            receiver -> sender
+//   kDone   u8 type                                        receiver -> sender
+//
+// The receiver answers an offer with the chunks it already has, as bitmap
+// pieces (chunk i is bit i % 8 of byte i / 8, counted from |first chunk|),
+// and the sender then streams the rest. A chunk whose checksum does not
+// match is nacked and sent again.
+namespace file_transfer_wire {
+
+enum class MessageType : uint8_t {
+    kOffer = 1,
+    kHave = 2,
+    kChunk = 3,
+    kNack = 4,
+    kDone = 5,
+};
+
+constexpr size_t kOfferBytes = 1 + 8 + 4;
+constexpr size_t kHaveHeaderBytes = 1 + 4 + 1;
+constexpr size_t kChunkHeaderBytes = 1 + 4 + 4;
+constexpr size_t kNackBytes = 1 + 4;
+// Bitmap bytes per kHave message, well under the SCTP message size limit.
+constexpr size_t kMaxHaveBitmapBytes = 64 * 1024;
+
+inline void PutU32(uint8_t* out, uint32_t value) {
+    out[0] = static_cast<uint8_t>(value >> 24);
+    out[1] = static_cast<uint8_t>(value >> 16);
+    out[2] = static_cast<uint8_t>(value >> 8);
+    out[3] = static_cast<uint8_t>(value);
+}
+
+inline void PutU64(uint8_t* out, uint64_t value) {
+    PutU32(out, static_cast<uint32_t>(value >> 32));
+    PutU32(out + 4, static_cast<uint32_t>(value));
+}
+
+inline uint32_t GetU32(const uint8_t* data) {
+    return uint32_t{data[0]} << 24 | uint32_t{data[1]} << 16 | uint32_t{data[2]} << 8 | uint32_t{data[3]};
+}
+
+inline uint64_t GetU64(const uint8_t* data) { return uint64_t{GetU32(data)} << 32 | GetU32(data + 4); }
+
+inline uint32_t ChunkCount(uint64_t file_size, uint32_t chunk_size) {
+    return static_cast<uint32_t>((file_size + chunk_size - 1) / chunk_size);
+}
+
+inline bool TestBit(const uint8_t* bitmap, uint32_t index) { return bitmap[index / 8] >> (index % 8) & 1; }
+inline void SetBit(uint8_t* bitmap, uint32_t index) { bitmap[index / 8] |= static_cast<uint8_t>(1 << (index % 8)); }
+
+inline webrtc::DataBuffer Control(MessageType type, uint32_t index = 0) {
+    webrtc::CopyOnWriteBuffer message(type == MessageType::kNack ? kNackBytes : 1);
+    message.MutableData()[0] = static_cast<uint8_t>(type);
+    if (type == MessageType::kNack) {
+        PutU32(message.MutableData() + 1, index);
+    }
+    return webrtc::DataBuffer(message, true);
+}
+
+}  // namespace file_transfer_wire
+
+// Sends a mapped file as fixed-size chunks. Each chunk is copied once,
+// straight from the mapping into its message, and its pages are released
+// as soon as the message is queued, so only the chunks in the SCTP send
+// buffer are resident however large the file is. Sends are paced by
+// buffered_amount() like BulkSender's; everything runs on the sending
+// peer's network thread.
+class FileSender : public DataChannelMessageHandler {
+public:
+    FileSender(MappedFile* source, uint32_t chunk_size, uint64_t high_watermark, uint64_t low_watermark)
+        : source_(source),
+          chunk_size_(chunk_size),
+          chunk_count_(file_transfer_wire::ChunkCount(source->size(), chunk_size)),
+          high_watermark_(high_watermark),
+          low_watermark_(low_watermark),
+          have_((chunk_count_ + 7) / 8) {}
+
+    // Hooks the sender into the channel opener's observer; the offer goes
+    // out when the channel opens.
+    void Attach(DataChannelObserver* observer) {
+        observer->SetOpenHandler([this, observer] { Start(observer->data_channel()); });
+        observer->SetBufferedAmountHandler([this](uint64_t) {
+            if (channel_ && channel_->buffered_amount() <= low_watermark_) {
+                Pump();
+            }
+        });
+        observer->SetMessageHandler(this);
+    }
+
+    void Start(webrtc::scoped_refptr<webrtc::DataChannelInterface> channel) {
+        channel_ = channel;
+        webrtc::CopyOnWriteBuffer offer(file_transfer_wire::kOfferBytes);
+        offer.MutableData()[0] = static_cast<uint8_t>(file_transfer_wire::MessageType::kOffer);
+        file_transfer_wire::PutU64(offer.MutableData() + 1, source_->size());
+        file_transfer_wire::PutU32(offer.MutableData() + 9, chunk_size_);
+        channel_->Send(webrtc::DataBuffer(offer, true));
+    }
+
+    // Pending pump tasks see this and return without rescheduling.
+    void Stop() { stopped_ = true; }
+
+    void OnMessage(std::span<const uint8_t> payload, bool, const webrtc::CopyOnWriteBuffer&) override {
+        using file_transfer_wire::MessageType;
+        if (payload.empty()) {
+            return;
+        }
+        switch (static_cast<MessageType>(payload[0])) {
+            case MessageType::kHave:
+                OnHave(payload);
+                break;
+            case MessageType::kNack:
+                if (payload.size() >= file_transfer_wire::kNackBytes) {
+                    const uint32_t index = file_transfer_wire::GetU32(payload.data() + 1);
+                    if (index < chunk_count_) {
+                        resend_.push_back(index);
+                        Pump();
+                    }
+                }
+                break;
+            case MessageType::kDone:
+                done_ = true;
+                break;
+            default:
+                break;
+        }
+    }
+
+    // The receiver has every chunk.
+    bool done() const { return done_.load(); }
+    uint32_t chunk_count() const { return chunk_count_; }
+    // Chunks the receiver already had when the transfer (re)started.
+    uint64_t chunks_skipped() const { return chunks_skipped_.load(std::memory_order_relaxed); }
+    uint64_t chunks_sent() const { return chunks_sent_.load(std::memory_order_relaxed); }
+    uint64_t chunks_resent() const { return chunks_resent_.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr int kMaxSendsPerPass = 64;
+
+    void OnHave(std::span<const uint8_t> payload) {
+        if (payload.size() < file_transfer_wire::kHaveHeaderBytes) {
+            return;
+        }
+        const uint32_t first = file_transfer_wire::GetU32(payload.data() + 1);
+        const bool last = payload[5] != 0;
+        std::span<const uint8_t> bits = payload.subspan(file_transfer_wire::kHaveHeaderBytes);
+        if (first % 8 == 0 && first / 8 <= have_.size()) {
+            const size_t count = std::min(bits.size(), have_.size() - first / 8);
+            std::memcpy(have_.data() + first / 8, bits.data(), count);
+        }
+        if (!last) {
+            return;
+        }
+        uint64_t skipped = 0;
+        for (uint32_t i = 0; i < chunk_count_; ++i) {
+            skipped += file_transfer_wire::TestBit(have_.data(), i);
+        }
+        chunks_skipped_ = skipped;
+        sending_ = true;
+        Pump();
+    }
+
+    void Pump() {
+        for (int i = 0; i < kMaxSendsPerPass; ++i) {
+            if (stopped_ || !sending_ || channel_->state() != webrtc::DataChannelInterface::kOpen ||
+                channel_->buffered_amount() >= high_watermark_) {
+                return;
+            }
+            uint32_t index = 0;
+            bool resend = false;
+            if (!resend_.empty()) {
+                index = resend_.front();
+                resend_.pop_front();
+                resend = true;
+            } else {
+                while (next_ < chunk_count_ && file_transfer_wire::TestBit(have_.data(), next_)) {
+                    ++next_;
+                }
+                if (next_ == chunk_count_) {
+                    return;
+                }
+                index = next_++;
+            }
+            if (!SendChunk(index)) {
+                // Retried on the next buffered amount change.
+                resend_.push_front(index);
+                return;
+            }
+            (resend ? chunks_resent_ : chunks_sent_).fetch_add(1, std::memory_order_relaxed);
+        }
+        webrtc::TaskQueueBase::Current()->PostTask([this] { Pump(); });
+    }
+
+    bool SendChunk(uint32_t index) {
+        const uint64_t offset = uint64_t{index} * chunk_size_;
+        const size_t length = static_cast<size_t>(std::min<uint64_t>(chunk_size_, source_->size() - offset));
+        const uint8_t* chunk = source_->data() + offset;
+
+        webrtc::CopyOnWriteBuffer message(file_transfer_wire::kChunkHeaderBytes + length);
+        uint8_t* out = message.MutableData();
+        out[0] = static_cast<uint8_t>(file_transfer_wire::MessageType::kChunk);
+        file_transfer_wire::PutU32(out + 1, index);
+        file_transfer_wire::PutU32(out + 5, webrtc::ComputeCrc32(chunk, length));
+        std::memcpy(out + file_transfer_wire::kChunkHeaderBytes, chunk, length);
+        const bool sent = channel_->Send(webrtc::DataBuffer(message, true));
+        source_->Release(offset, length);
+        return sent;
+    }
+
+    MappedFile* const source_;
+    const uint32_t chunk_size_;
+    const uint32_t chunk_count_;
+    const uint64_t high_watermark_;
+    const uint64_t low_watermark_;
+    webrtc::scoped_refptr<webrtc::DataChannelInterface> channel_;
+
+    // Network thread only.
+    std::vector<uint8_t> have_;
+    std::deque<uint32_t> resend_;
+    uint32_t next_ = 0;
+    bool sending_ = false;
+
+    std::atomic<bool> stopped_{false};
+    std::atomic<bool> done_{false};
+    std::atomic<uint64_t> chunks_skipped_{0};
+    std::atomic<uint64_t> chunks_sent_{0};
+    std::atomic<uint64_t> chunks_resent_{0};
+};
+
+// Writes an offered file through a mapping of the output, pre-sized to the
+// file's length, releasing each chunk's pages once written. Which chunks
+// have landed is kept in a mapped bitmap next to the output (ProgressPath()),
+// so a transfer that is cut off can be resumed by a later receiver for the
+// same path. The bitmap is removed once the file is complete.
+//
+// Runs on the receiving peer's network thread.
+class FileReceiver : public DataChannelMessageHandler {
+public:
+    explicit FileReceiver(std::string path) : path_(std::move(path)) {}
+
+    static std::string ProgressPath(const std::string& path) { return path + ".part"; }
+
+    void Attach(DataChannelObserver* observer) {
+        observer_ = observer;
+        observer->SetMessageHandler(this);
+    }
+
+    void OnMessage(std::span<const uint8_t> payload, bool, const webrtc::CopyOnWriteBuffer&) override {
+        using file_transfer_wire::MessageType;
+        if (payload.empty()) {
+            return;
+        }
+        switch (static_cast<MessageType>(payload[0])) {
+            case MessageType::kOffer:
+                if (payload.size() >= file_transfer_wire::kOfferBytes) {
+                    OnOffer(file_transfer_wire::GetU64(payload.data() + 1),
+                            file_transfer_wire::GetU32(payload.data() + 9));
+                }
+                break;
+            case MessageType::kChunk:
+                if (payload.size() >= file_transfer_wire::kChunkHeaderBytes) {
+                    OnChunk(file_transfer_wire::GetU32(payload.data() + 1),
+                            file_transfer_wire::GetU32(payload.data() + 5),
+                            payload.subspan(file_transfer_wire::kChunkHeaderBytes));
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    bool complete() const { return complete_.load(); }
+    bool failed() const { return failed_.load(); }
+    // Chunks found in the progress bitmap when the offer arrived.
+    uint64_t chunks_resumed() const { return chunks_resumed_.load(std::memory_order_relaxed); }
+    uint64_t chunks_received() const { return chunks_received_.load(std::memory_order_relaxed); }
+    uint64_t bytes_received() const { return bytes_received_.load(std::memory_order_relaxed); }
+    uint64_t checksum_failures() const { return checksum_failures_.load(std::memory_order_relaxed); }
+
+private:
+    // Progress file: u32 magic | u32 chunk size | u64 file size | bitmap.
+    static constexpr uint32_t kProgressMagic = 0x57465450;  // "WFTP"
+    static constexpr size_t kProgressHeaderBytes = 16;
+
+    void OnOffer(uint64_t file_size, uint32_t chunk_size) {
+        if (chunk_size == 0 || output_) {
+            return;
+        }
+        file_size_ = file_size;
+        chunk_size_ = chunk_size;
+        chunk_count_ = file_transfer_wire::ChunkCount(file_size, chunk_size);
+
+        // Earlier progress only counts if the output it describes is still there.
+        const std::string progress_path = ProgressPath(path_);
+        struct stat output_info {};
+        const bool output_exists =
+            stat(path_.c_str(), &output_info) == 0 && static_cast<uint64_t>(output_info.st_size) == file_size;
+        progress_ = MappedFile::OpenForWrite(progress_path, kProgressHeaderBytes + (chunk_count_ + 7) / 8);
+        output_ = progress_ ? MappedFile::OpenForWrite(path_, file_size) : nullptr;
+        if (!output_) {
+            failed_ = true;
+            return;
+        }
+        uint8_t* header = progress_->mutable_data();
+        if (!output_exists || file_transfer_wire::GetU32(header) != kProgressMagic ||
+            file_transfer_wire::GetU32(header + 4) != chunk_size || file_transfer_wire::GetU64(header + 8) != file_size) {
+            std::memset(header, 0, progress_->size());
+            file_transfer_wire::PutU32(header, kProgressMagic);
+            file_transfer_wire::PutU32(header + 4, chunk_size);
+            file_transfer_wire::PutU64(header + 8, file_size);
+        }
+        bitmap_ = header + kProgressHeaderBytes;
+        for (uint32_t i = 0; i < chunk_count_; ++i) {
+            have_count_ += file_transfer_wire::TestBit(bitmap_, i);
+        }
+        chunks_resumed_ = have_count_;
+
+        // The bitmap in pieces; the last one tells the sender to go.
+        const size_t bitmap_bytes = (chunk_count_ + 7) / 8;
+        size_t offset = 0;
+        do {
+            const size_t piece = std::min(bitmap_bytes - offset, file_transfer_wire::kMaxHaveBitmapBytes);
+            webrtc::CopyOnWriteBuffer have(file_transfer_wire::kHaveHeaderBytes + piece);
+            uint8_t* out = have.MutableData();
+            out[0] = static_cast<uint8_t>(file_transfer_wire::MessageType::kHave);
+            file_transfer_wire::PutU32(out + 1, static_cast<uint32_t>(offset * 8));
+            out[5] = offset + piece == bitmap_bytes ? 1 : 0;
+            std::memcpy(out + file_transfer_wire::kHaveHeaderBytes, bitmap_ + offset, piece);
+            Reply(webrtc::DataBuffer(have, true));
+            offset += piece;
+        } while (offset < bitmap_bytes);
+
+        if (have_count_ == chunk_count_) {
+            Finish();
+        }
+    }
+
+    void OnChunk(uint32_t index, uint32_t crc, std::span<const uint8_t> data) {
+        if (!output_ || complete_ || index >= chunk_count_ || file_transfer_wire::TestBit(bitmap_, index)) {
+            return;
+        }
+        const uint64_t offset = uint64_t{index} * chunk_size_;
+        if (data.size() != std::min<uint64_t>(chunk_size_, file_size_ - offset) ||
+            webrtc::ComputeCrc32(data.data(), data.size()) != crc) {
+            checksum_failures_.fetch_add(1, std::memory_order_relaxed);
+            Reply(file_transfer_wire::Control(file_transfer_wire::MessageType::kNack, index));
+            return;
+        }
+        std::memcpy(output_->mutable_data() + offset, data.data(), data.size());
+        output_->Release(offset, data.size());
+        // Marked only after the data is in the mapping, so a chunk recorded
+        // as present always is.
+        file_transfer_wire::SetBit(bitmap_, index);
+        ++have_count_;
+        chunks_received_.fetch_add(1, std::memory_order_relaxed);
+        bytes_received_.fetch_add(data.size(), std::memory_order_relaxed);
+        if (have_count_ == chunk_count_) {
+            Finish();
+        }
+    }
+
+    void Finish() {
+        bitmap_ = nullptr;
+        progress_ = nullptr;
+        unlink(ProgressPath(path_).c_str());
+        complete_ = true;
+        Reply(file_transfer_wire::Control(file_transfer_wire::MessageType::kDone));
+    }
+
+    void Reply(const webrtc::DataBuffer& message) {
+        if (webrtc::scoped_refptr<webrtc::DataChannelInterface> channel = observer_->data_channel()) {
+            channel->Send(message);
+        }
+    }
+
+    const std::string path_;
+    DataChannelObserver* observer_ = nullptr;
+
+    // Network thread only.
+    std::unique_ptr<MappedFile> output_;
+    std::unique_ptr<MappedFile> progress_;
+    uint8_t* bitmap_ = nullptr;
+    uint64_t file_size_ = 0;
+    uint32_t chunk_size_ = 0;
+    uint32_t chunk_count_ = 0;
+    uint32_t have_count_ = 0;
+
+    std::atomic<bool> complete_{false};
+    std::atomic<bool> failed_{false};
+    std::atomic<uint64_t> chunks_resumed_{0};
+    std::atomic<uint64_t> chunks_received_{0};
+    std::atomic<uint64_t> bytes_received_{0};
+    std::atomic<uint64_t> checksum_failures_{0};
+};
+
+struct FileOptions {
+    // File to send; empty generates |generate_bytes| of random data next to
+    // |output|.
+    std::string source;
+    uint64_t generate_bytes = 1024ull * 1024 * 1024;
+    std::string output = "/tmp/webrtc-file-transfer.bin";
+    // Rounded down to whole pages so every chunk's pages can be released.
+    uint32_t chunk_size = 64 * 1024;
+    uint64_t high_watermark = 4 * 1024 * 1024;
+    uint64_t low_watermark = 1024 * 1024;
+    // Cut the first attempt off after this share of the chunks (0-99) and
+    // resume on a fresh pair; 0 sends in one go.
+    int interrupt_percent = 0;
+    // Continue a partial output left by an earlier run instead of starting over.
+    bool resume = false;
+    // Keep the output (and a generated source) afterwards.
+    bool keep = false;
+    webrtc::TimeDelta timeout = webrtc::TimeDelta::Seconds(600);
+};
+
+// Transfers a file over a loopback pair and reports the sustained rate and
+// how much the process's resident set grew while doing it. With both files
+// mapped and released chunk by chunk, the growth stays at the SCTP buffers
+// whatever the file size.
+class FileBenchmark {
+public:
+    FileBenchmark(PeerConnectionFactoryPool* pool,
+                  webrtc::PeerConnectionInterface::RTCConfiguration config,
+                  FileOptions options)
+        : pool_(pool), config_(config), options_(options) {
+        config_.servers.clear();
+        const uint32_t page = static_cast<uint32_t>(sysconf(_SC_PAGESIZE));
+        // Whole pages, and small enough to fit a data channel message.
+        options_.chunk_size = std::clamp(options_.chunk_size / page * page, page, kMaxChunkSize / page * page);
+        options_.interrupt_percent = std::clamp(options_.interrupt_percent, 0, 99);
+    }
+
+    int Run() {
+        std::string source_path = options_.source;
+        const bool generated = source_path.empty();
+        if (generated) {
+            source_path = options_.output + ".src";
+            if (!Generate(source_path, options_.generate_bytes)) {
+                return -1;
+            }
+        }
+        std::unique_ptr<MappedFile> source = MappedFile::OpenForRead(source_path);
+        if (!source) {
+            return -1;
+        }
+        if (!options_.resume) {
+            unlink(options_.output.c_str());
+            unlink(FileReceiver::ProgressPath(options_.output).c_str());
+        }
+
+        std::cout << "File mode: " << source->size() / (1024.0 * 1024.0) << " MiB in "
+                  << options_.chunk_size / 1024 << " KiB chunks, watermarks " << options_.low_watermark / 1024 << "/"
+                  << options_.high_watermark / 1024 << " KiB" << std::endl;
+        std::cout << std::setw(8) << "attempt" << std::setw(10) << "resumed" << std::setw(10) << "sent"
+                  << std::setw(8) << "resent" << std::setw(10) << "MB/s" << std::setw(12) << "RSS MiB"
+                  << std::setw(12) << "growth MiB" << "  result" << std::endl;
+
+        bool complete = false;
+        int attempt = 1;
+        if (options_.interrupt_percent > 0) {
+            const uint32_t chunks = file_transfer_wire::ChunkCount(source->size(), options_.chunk_size);
+            complete = RunAttempt(source.get(), attempt++, uint64_t{chunks} * options_.interrupt_percent / 100);
+        }
+        if (!complete) {
+            complete = RunAttempt(source.get(), attempt, 0);
+        }
+
+        bool verified = false;
+        if (complete) {
+            verified = Verify(*source);
+            std::cout << (verified ? "Output matches the source" : "Output differs from the source") << std::endl;
+        }
+        source = nullptr;
+        if (!options_.keep) {
+            if (generated) {
+                unlink(source_path.c_str());
+            }
+            if (complete) {
+                unlink(options_.output.c_str());
+            }
+        }
+        return verified ? 0 : -1;
+    }
+
+private:
+    // Message size limit less the chunk header, rounded down to pages.
+    static constexpr uint32_t kMaxChunkSize = 256 * 1024 - 4096;
+
+    // Sends until the receiver has the whole file, or only until it has
+    // received |stop_after_chunks| (if non-zero) to simulate a dropped
+    // connection. Returns whether the output is complete.
+    bool RunAttempt(MappedFile* source, int attempt, uint64_t stop_after_chunks) {
+        webrtc::DataChannelInit dc_config;
+        dc_config.ordered = true;
+
+        FileSender sender(source, options_.chunk_size, options_.high_watermark, options_.low_watermark);
+        FileReceiver receiver(options_.output);
+
+        ScopedLogLevel quiet(LogLevel::kWarning);
+        std::unique_ptr<BenchmarkPair> fixture =
+            BenchmarkPair::Create(pool_->Acquire(), pool_->Acquire(), config_, "File", dc_config, "file");
+        if (!fixture) {
+            return false;
+        }
+        LoopbackPair* pair = fixture->pair();
+        sender.Attach(pair->observer1()->GetDataObserver());
+        receiver.Attach(pair->observer2()->GetDataObserver());
+
+        const int64_t rss_before = ProcessStats::ResidentSetBytes();
+        int64_t rss_peak = rss_before;
+        if (!fixture->Connect()) {
+            return false;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        const auto deadline = start + std::chrono::microseconds(options_.timeout.us());
+        while (!(receiver.complete() && sender.done()) && !receiver.failed() &&
+               !(stop_after_chunks > 0 && receiver.chunks_received() >= stop_after_chunks) &&
+               std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            rss_peak = std::max(rss_peak, ProcessStats::ResidentSetBytes());
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        sender.Stop();
+        fixture->Close();
+
+        const bool complete = receiver.complete();
+        std::cout << std::fixed << std::setw(8) << attempt << std::setw(10) << receiver.chunks_resumed()
+                  << std::setw(10) << sender.chunks_sent() << std::setw(8) << sender.chunks_resent()
+                  << std::setprecision(1) << std::setw(10) << receiver.bytes_received() / seconds / 1e6
+                  << std::setw(12) << rss_peak / (1024.0 * 1024.0) << std::setw(12)
+                  << (rss_peak - rss_before) / (1024.0 * 1024.0) << "  "
+                  << (complete                ? "complete"
+                      : receiver.failed()     ? "failed"
+                      : stop_after_chunks > 0 ? "interrupted"
+                                              : "timed out")
+                  << std::defaultfloat << std::endl;
+        return complete;
+    }
+
+    // Compares the output with |source| chunk by chunk, releasing both as it goes.
+    bool Verify(MappedFile& source) const {
+        std::unique_ptr<MappedFile> output = MappedFile::OpenForRead(options_.output);
+        if (!output || output->size() != source.size()) {
+            return false;
+        }
+        for (uint64_t offset = 0; offset < source.size(); offset += options_.chunk_size) {
+            const uint64_t length = std::min<uint64_t>(options_.chunk_size, source.size() - offset);
+            if (std::memcmp(source.data() + offset, output->data() + offset, length) != 0) {
+                return false;
+            }
+            source.Release(offset, length);
+            output->Release(offset, length);
+        }
+        return true;
+    }
+
+    // Writes |size| pseudo-random (incompressible) bytes to |path|.
+    static bool Generate(const std::string& path, uint64_t size) {
+        std::unique_ptr<MappedFile> file = MappedFile::OpenForWrite(path, size);
+        if (!file) {
+            return false;
+        }
+        constexpr uint64_t kBlock = 1024 * 1024;
+        uint64_t state = 0x9E3779B97F4A7C15ull;
+        for (uint64_t offset = 0; offset < size; offset += kBlock) {
+            const uint64_t length = std::min(kBlock, size - offset);
+            uint8_t* block = file->mutable_data() + offset;
+            for (uint64_t i = 0; i < length; i += sizeof(state)) {
+                state ^= state << 13;
+                state ^= state >> 7;
+                state ^= state << 17;
+                std::memcpy(block + i, &state, std::min<uint64_t>(sizeof(state), length - i));
+            }
+            file->Release(offset, length);
+        }
+        return true;
+    }
+
+    PeerConnectionFactoryPool* pool_;
+    webrtc::PeerConnectionInterface::RTCConfiguration config_;
+    FileOptions options_;
+};
@@ -0,0 +1 @@
+#include "handshake_limiter.h"
\ No newline at end of file
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+#include "latency_stats.h"
+
+// Keeps at most |concurrency| of |total| handshakes in flight and records
+// the setup time of each one that connects. The issuing thread calls
+// Acquire() before starting a handshake and WaitForAll() after the last one;
+// Release() may run on whichever thread finishes the handshake.
+class HandshakeLimiter {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    HandshakeLimiter(int concurrency, int total) : concurrency_(Clamp(concurrency)), total_(total) {
+        setup_ms_.Reserve(total);
+    }
+
+    // The concurrency a limiter created with |concurrency| allows. Below 1
+    // is raised to 1; with no slot to hand out, Acquire() would wait forever.
+    static int Clamp(int concurrency) { return std::max(concurrency, 1); }
+
+    // Blocks until a slot is free. Returns the handshake's start time, to be
+    // passed back to Release().
+    Clock::time_point Acquire() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        slot_freed_.wait(lock, [this] { return in_flight_ < concurrency_; });
+        ++in_flight_;
+        return Clock::now();
+    }
+
+    void Release(Clock::time_point start, bool connected) {
+        const double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (connected) {
+            setup_ms_.Add(ms);
+        } else {
+            ++failed_;
+        }
+        --in_flight_;
+        ++finished_;
+        slot_freed_.notify_all();
+    }
+
+    // Blocks until all |total| handshakes have been released.
+    void WaitForAll() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        slot_freed_.wait(lock, [this] { return finished_ == total_; });
+    }
+
+    // Read after WaitForAll().
+    int failed() const { return failed_; }
+    LatencyStats& setup_ms() { return setup_ms_; }
+
+private:
+    const int concurrency_;
+    const int total_;
+
+    std::mutex mutex_;
+    std::condition_variable slot_freed_;
+    int in_flight_ = 0;
+    int finished_ = 0;
+    int failed_ = 0;
+    LatencyStats setup_ms_;
+};
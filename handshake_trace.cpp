@@ -0,0 +1 @@
+#include "handshake_trace.h"
\ No newline at end of file
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <rtc_base/time_utils.h>
+
+// Timestamped connection setup phases, written out as Chrome trace JSON for
+// chrome://tracing or ui.perfetto.dev. Every traced peer gets a track (a row
+// in the viewer) holding spans for the SDP steps and the ICE, DTLS and data
+// channel phases, plus instants for milestones such as the first candidate.
+//
+// Off until Start(). Peers created while it is off get track 0, and every
+// recording call returns on that before reading the clock, so an untraced
+// run pays one branch per phase.
+class HandshakeTrace {
+public:
+    static void Start() {
+        HandshakeTrace& trace = Instance();
+        std::lock_guard<std::mutex> lock(trace.mutex_);
+        trace.origin_us_ = webrtc::TimeMicros();
+        trace.on_.store(true, std::memory_order_relaxed);
+    }
+
+    static bool IsOn() { return Instance().on_.load(std::memory_order_relaxed); }
+
+    // A new track labelled |peer|, or 0 while tracing is off.
+    static uint32_t Track(std::string_view peer) {
+        if (!IsOn()) {
+            return 0;
+        }
+        HandshakeTrace& trace = Instance();
+        std::lock_guard<std::mutex> lock(trace.mutex_);
+        trace.tracks_.emplace_back(peer);
+        return static_cast<uint32_t>(trace.tracks_.size());
+    }
+
+    // |name| must be a string literal.
+    static void Span(uint32_t track, const char* name, int64_t start_us, int64_t end_us) {
+        if (track != 0) {
+            Instance().Add({name, track, 'X', start_us, end_us - start_us});
+        }
+    }
+
+    static void Instant(uint32_t track, const char* name) {
+        if (track != 0) {
+            Instance().Add({name, track, 'i', webrtc::TimeMicros(), 0});
+        }
+    }
+
+    // Writes every event recorded so far to |path|.
+    static bool WriteJson(const std::string& path) {
+        HandshakeTrace& trace = Instance();
+        std::lock_guard<std::mutex> lock(trace.mutex_);
+        FILE* file = std::fopen(path.c_str(), "w");
+        if (!file) {
+            std::cerr << "Cannot write trace to " << path << std::endl;
+            return false;
+        }
+        std::fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", file);
+        bool first = true;
+        auto separator = [&first, file] {
+            if (!first) {
+                std::fputs(",\n", file);
+            }
+            first = false;
+        };
+        for (size_t i = 0; i < trace.tracks_.size(); ++i) {
+            separator();
+            std::fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%zu,\"args\":{\"name\":\"%s\"}}",
+                         i + 1, Escape(trace.tracks_[i]).c_str());
+        }
+        for (const Event& event : trace.events_) {
+            separator();
+            const long long ts = static_cast<long long>(event.start_us - trace.origin_us_);
+            if (event.phase == 'X') {
+                std::fprintf(file,
+                             "{\"name\":\"%s\",\"cat\":\"handshake\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%lld,"
+                             "\"dur\":%lld}",
+                             event.name, event.track, ts, static_cast<long long>(event.duration_us));
+            } else {
+                std::fprintf(file,
+                             "{\"name\":\"%s\",\"cat\":\"handshake\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%u,"
+                             "\"ts\":%lld}",
+                             event.name, event.track, ts);
+            }
+        }
+        std::fputs("\n]}\n", file);
+        const bool ok = std::fclose(file) == 0;
+        std::cout << "Wrote " << trace.events_.size() << " trace events for " << trace.tracks_.size()
+                  << " peers to " << path << std::endl;
+        return ok;
+    }
+
+private:
+    struct Event {
+        const char* name;
+        uint32_t track;
+        // 'X' (complete span) or 'i' (instant), as in the trace format.
+        char phase;
+        int64_t start_us;
+        int64_t duration_us;
+    };
+
+    static HandshakeTrace& Instance() {
+        static HandshakeTrace* trace = new HandshakeTrace();  // Leaked: peers may record during exit.
+        return *trace;
+    }
+
+    void Add(const Event& event) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        events_.push_back(event);
+    }
+
+    // Peer names are ours, but keep the JSON valid whatever they hold.
+    static std::string Escape(std::string_view text) {
+        std::string escaped;
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                escaped += '\\';
+            }
+            if (static_cast<unsigned char>(c) >= 0x20) {
+                escaped += c;
+            }
+        }
+        return escaped;
+    }
+
+    std::atomic<bool> on_{false};
+    std::mutex mutex_;
+    int64_t origin_us_ = 0;
+    std::vector<std::string> tracks_;
+    std::vector<Event> events_;
+};
+
+// Records the time from construction to End() (or destruction) as a span.
+// Lives across co_await in a coroutine frame like any other local.
+class TraceSpan {
+public:
+    TraceSpan(uint32_t track, const char* name)
+        : track_(track), name_(name), start_us_(track != 0 ? webrtc::TimeMicros() : 0) {}
+    ~TraceSpan() { End(); }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    void End() {
+        if (track_ != 0) {
+            HandshakeTrace::Span(track_, name_, start_us_, webrtc::TimeMicros());
+            track_ = 0;
+        }
+    }
+
+private:
+    uint32_t track_;
+    const char* name_;
+    int64_t start_us_;
+};
@@ -0,0 +1 @@
+#include "ice_candidate_relay.h"
\ No newline at end of file
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include <api/peer_connection_interface.h>
+#include <api/ref_count.h>
+#include <api/scoped_refptr.h>
+#include <api/task_queue/task_queue_base.h>
+
+#include "async_log.h"
+#include "mpsc_queue.h"
+
+// Where a peer's gathered candidates go. Push() is called on the local
+// peer's signaling thread.
+class IceCandidateSink : public webrtc::RefCountInterface {
+public:
+    virtual void Push(std::unique_ptr<webrtc::IceCandidateInterface> candidate) = 0;
+
+protected:
+    ~IceCandidateSink() override = default;
+};
+
+// Trickles ICE candidates from one peer into the remote PeerConnection.
+// OnIceCandidate pushes into a lock-free queue; a drain task on the remote
+// peer's signaling thread hands each candidate to AddIceCandidate as soon as
+// the remote description is in place.
+class IceCandidateRelay : public IceCandidateSink {
+public:
+    static webrtc::scoped_refptr<IceCandidateRelay> Create(
+        const std::string& name,
+        webrtc::scoped_refptr<webrtc::PeerConnectionInterface> remote_pc,
+        webrtc::TaskQueueBase* remote_signaling_thread) {
+        return webrtc::make_ref_counted<IceCandidateRelay>(name, remote_pc, remote_signaling_thread);
+    }
+
+    // Called from the local peer's signaling thread.
+    void Push(std::unique_ptr<webrtc::IceCandidateInterface> candidate) override {
+        queue_.Push(std::move(candidate));
+        ScheduleDrain();
+    }
+
+    // AddIceCandidate fails without a remote description, so candidates are
+    // held back until the remote side has applied the offer/answer.
+    void SetRemoteReady() {
+        remote_ready_ = true;
+        ScheduleDrain();
+    }
+
+    int relayed_count() const { return relayed_count_.load(); }
+
+protected:
+    IceCandidateRelay(const std::string& name,
+                      webrtc::scoped_refptr<webrtc::PeerConnectionInterface> remote_pc,
+                      webrtc::TaskQueueBase* remote_signaling_thread)
+        : name_(name), remote_pc_(remote_pc), remote_signaling_thread_(remote_signaling_thread) {}
+    ~IceCandidateRelay() override = default;
+
+private:
+    void ScheduleDrain() {
+        if (!remote_ready_.load() || drain_scheduled_.exchange(true)) {
+            return;
+        }
+        webrtc::scoped_refptr<IceCandidateRelay> self(this);
+        remote_signaling_thread_->PostTask([self]() { self->Drain(); });
+    }
+
+    // Runs on the remote signaling thread, the queue's only consumer.
+    void Drain() {
+        drain_scheduled_ = false;
+        while (auto candidate = queue_.Pop()) {
+            remote_pc_->AddIceCandidate(std::move(*candidate), [name = name_](webrtc::RTCError error) {
+                if (!error.ok()) {
+                    ASYNC_LOG(kError, name, "Failed to add ICE candidate", nullptr, error.message());
+                }
+            });
+            ++relayed_count_;
+        }
+    }
+
+    std::string name_;
+    webrtc::scoped_refptr<webrtc::PeerConnectionInterface> remote_pc_;
+    webrtc::TaskQueueBase* remote_signaling_thread_;
+    MpscQueue<std::unique_ptr<webrtc::IceCandidateInterface>> queue_;
+    std::atomic<bool> remote_ready_{false};
+    std::atomic<bool> drain_scheduled_{false};
+    std::atomic<int> relayed_count_{0};
+};
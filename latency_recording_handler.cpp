@@ -0,0 +1 @@
+#include "latency_recording_handler.h"
\ No newline at end of file
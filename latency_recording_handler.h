@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+#include <rtc_base/copy_on_write_buffer.h>
+#include <rtc_base/time_utils.h>
+
+#include "data_channel_message_handler.h"
+#include "latency_stats.h"
+
+// Every benchmark message starts with its send time, so the receiver can
+// compute one-way latency (both peers share the process clock).
+constexpr size_t kTimestampBytes = sizeof(int64_t);
+
+// Records one-way latency of timestamped messages. Runs on the receiving
+// network thread; read the results only after that thread has been flushed.
+class LatencyRecordingHandler : public DataChannelMessageHandler {
+public:
+    void OnMessage(std::span<const uint8_t> payload, bool, const webrtc::CopyOnWriteBuffer&) override {
+        if (payload.size() < kTimestampBytes) {
+            return;
+        }
+        int64_t sent_us;
+        std::memcpy(&sent_us, payload.data(), kTimestampBytes);
+        messages_.fetch_add(1, std::memory_order_relaxed);
+        if (measuring_.load(std::memory_order_relaxed)) {
+            latency_.Add((webrtc::TimeMicros() - sent_us) / 1000.0);
+        }
+    }
+
+    void StartMeasuring() { measuring_ = true; }
+    void StopMeasuring() { measuring_ = false; }
+
+    uint64_t messages() const { return messages_.load(std::memory_order_relaxed); }
+    LatencyStats& latency() { return latency_; }
+
+private:
+    std::atomic<bool> measuring_{false};
+    std::atomic<uint64_t> messages_{0};
+    LatencyStats latency_;
+};
@@ -0,0 +1 @@
+#include "latency_stats.h"
\ No newline at end of file
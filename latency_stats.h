@@ -0,0 +1,54 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+// Collects latency samples (in milliseconds) and reports percentiles.
+// Not thread-safe; record from one thread or guard externally.
+class LatencyStats {
+public:
+    void Reserve(size_t count) { samples_.reserve(count); }
+    void Add(double ms) {
+        samples_.push_back(ms);
+        sorted_ = false;
+    }
+
+    void Append(const LatencyStats& other) {
+        samples_.insert(samples_.end(), other.samples_.begin(), other.samples_.end());
+        sorted_ = samples_.empty();
+    }
+
+    size_t count() const { return samples_.size(); }
+
+    // Nearest-rank percentile, |p| in [0, 100].
+    double Percentile(double p) {
+        if (samples_.empty()) {
+            return 0;
+        }
+        if (!sorted_) {
+            std::sort(samples_.begin(), samples_.end());
+            sorted_ = true;
+        }
+        const size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * samples_.size()));
+        return samples_[std::clamp<size_t>(rank, 1, samples_.size()) - 1];
+    }
+
+    double Max() { return Percentile(100); }
+
+    double Mean() const {
+        if (samples_.empty()) {
+            return 0;
+        }
+        double sum = 0;
+        for (double sample : samples_) {
+            sum += sample;
+        }
+        return sum / samples_.size();
+    }
+
+private:
+    std::vector<double> samples_;
+    bool sorted_ = true;
+};
@@ -1,47 +1,252 @@
 #pragma once
-#include <thread>
+#include <memory>
+#include <string>
+
+#include <api/jsep.h>
 #include <api/peer_connection_interface.h>
 #include <api/scoped_refptr.h>
+#include <api/task_queue/task_queue_base.h>
+#include <api/units/time_delta.h>
 
-#include "sdp_observer.h"
+#include "async_handshake.h"
+#include "handshake_trace.h"
+#include "ice_candidate_relay.h"
+#include "sdp_template_cache.h"
 #include "simple_peer_connection_observer.h"
+#include "task.h"
+
+// Per-step limits for the loopback handshake. |timer| runs the timeout tasks;
+// any WebRTC thread works since they only resume the waiting coroutine.
+struct HandshakeTimeouts {
+    webrtc::TaskQueueBase* timer = nullptr;
+    webrtc::TimeDelta sdp_step = webrtc::TimeDelta::Seconds(5);
+    webrtc::TimeDelta connection = webrtc::TimeDelta::Seconds(10);
+    webrtc::TimeDelta first_message = webrtc::TimeDelta::Seconds(5);
+};
+
+// One side of a locally signaled pair. |signaling_thread| is the thread the
+// PeerConnection was created on; trickled candidates are posted there.
+struct PeerEndpoint {
+    webrtc::scoped_refptr<webrtc::PeerConnectionInterface> pc;
+    SimplePeerConnectionObserver* observer = nullptr;
+    webrtc::TaskQueueBase* signaling_thread = nullptr;
+};
 
+// How created descriptions reach both peers. Each one goes to its own peer
+// as-is and a Clone() to the other; |reparse| brings back the old
+// ToString()/CreateSessionDescription() copies for comparison. With
+// |templates| set, handshakes for |template_key| after the first one apply
+// patched templates instead of creating an offer and answer.
+struct SdpOptions {
+    bool reparse = false;
+    SdpTemplateCache* templates = nullptr;
+    std::string template_key;
+};
 
 // Simple local signaling (simulates signaling server)
 class LocalSignaling {
 public:
-    static void ExchangeSDPs(webrtc::scoped_refptr<webrtc::PeerConnectionInterface> pc1,
-                             webrtc::scoped_refptr<webrtc::PeerConnectionInterface> pc2,
-                             std::unique_ptr<webrtc::SessionDescriptionInterface> offer,
-                             webrtc::scoped_refptr<CreateSDPObserver> answer_observer) {
+    // Runs offer/answer between |offerer| and |answerer|, trickling ICE
+    // candidates as they are gathered, and completes once both peers report
+    // kConnected.
+    static Task<webrtc::RTCError> Connect(PeerEndpoint offerer,
+                                          PeerEndpoint answerer,
+                                          HandshakeTimeouts timeouts,
+                                          SdpOptions sdp = {}) {
+        using namespace async_handshake;
+
+        webrtc::scoped_refptr<webrtc::PeerConnectionInterface> pc1 = offerer.pc;
+        webrtc::scoped_refptr<webrtc::PeerConnectionInterface> pc2 = answerer.pc;
+        SimplePeerConnectionObserver* observer1 = offerer.observer;
+        SimplePeerConnectionObserver* observer2 = answerer.observer;
+
+        auto relay_to_pc2 =
+            IceCandidateRelay::Create(observer1->name() + "->" + observer2->name(), pc2, answerer.signaling_thread);
+        auto relay_to_pc1 =
+            IceCandidateRelay::Create(observer2->name() + "->" + observer1->name(), pc1, offerer.signaling_thread);
+        observer1->SetIceCandidateRelay(relay_to_pc2);
+        observer2->SetIceCandidateRelay(relay_to_pc1);
+
+        const uint32_t track1 = observer1->trace_track();
+        const uint32_t track2 = observer2->trace_track();
+        TraceSpan handshake1(track1, "handshake");
+        TraceSpan handshake2(track2, "handshake");
+
+        // Every step runs on its PeerConnection's signaling thread; see
+        // ResumeOn. Steps on the same peer need no hop in between.
+        ASYNC_LOG(kInfo, {}, "Creating offer...");
+        co_await ResumeOn(offerer.signaling_thread);
+        TraceSpan create_offer(track1, "create offer");
+        std::unique_ptr<webrtc::SessionDescriptionInterface> offer_for_pc1 =
+            sdp.templates ? sdp.templates->Instantiate(sdp.template_key, webrtc::SdpType::kOffer) : nullptr;
+        if (!offer_for_pc1) {
+            SdpResult offer = co_await CreateOffer(pc1, timeouts.timer, timeouts.sdp_step);
+            if (!offer.ok()) {
+                co_return offer.MoveError();
+            }
+            offer_for_pc1 = offer.MoveValue();
+            if (sdp.templates) {
+                sdp.templates->Store(sdp.template_key, *offer_for_pc1);
+            }
+        }
+        std::unique_ptr<webrtc::SessionDescriptionInterface> offer_for_pc2 = Copy(*offer_for_pc1, sdp.reparse);
+        if (sdp.reparse) {
+            offer_for_pc1 = Copy(*offer_for_pc1, true);
+        }
+        create_offer.End();
+
+        TraceSpan set_local_offer(track1, "set local offer");
+        webrtc::RTCError error = co_await SetLocal(pc1, std::move(offer_for_pc1), timeouts.timer, timeouts.sdp_step);
+        if (!error.ok()) {
+            co_return error;
+        }
+        set_local_offer.End();
+
+        ASYNC_LOG(kInfo, {}, "Exchanging offer and creating answer...");
+        co_await ResumeOn(answerer.signaling_thread);
+        TraceSpan set_remote_offer(track2, "set remote offer");
+        error = co_await SetRemote(pc2, std::move(offer_for_pc2), timeouts.timer, timeouts.sdp_step);
+        if (!error.ok()) {
+            co_return error;
+        }
+        set_remote_offer.End();
+        relay_to_pc2->SetRemoteReady();
+
+        TraceSpan create_answer(track2, "create answer");
+
+        std::unique_ptr<webrtc::SessionDescriptionInterface> answer_for_pc2 =
+            sdp.templates ? sdp.templates->Instantiate(sdp.template_key, webrtc::SdpType::kAnswer) : nullptr;
+        if (!answer_for_pc2) {
+            SdpResult answer = co_await CreateAnswer(pc2, timeouts.timer, timeouts.sdp_step);
+            if (!answer.ok()) {
+                co_return answer.MoveError();
+            }
+            answer_for_pc2 = answer.MoveValue();
+            if (sdp.templates) {
+                sdp.templates->Store(sdp.template_key, *answer_for_pc2);
+            }
+        }
+        std::unique_ptr<webrtc::SessionDescriptionInterface> answer_for_pc1 = Copy(*answer_for_pc2, sdp.reparse);
+        if (sdp.reparse) {
+            answer_for_pc2 = Copy(*answer_for_pc2, true);
+        }
+        create_answer.End();
+
+        TraceSpan set_local_answer(track2, "set local answer");
+        error = co_await SetLocal(pc2, std::move(answer_for_pc2), timeouts.timer, timeouts.sdp_step);
+        if (!error.ok()) {
+            co_return error;
+        }
+        set_local_answer.End();
 
-        // Set remote description (offer) on pc2
-        webrtc::scoped_refptr<SetSDPObserver> set_observer = SetSDPObserver::Create();
-        pc2->SetRemoteDescription(set_observer.get(), offer.release());
+        co_await ResumeOn(offerer.signaling_thread);
+        TraceSpan set_remote_answer(track1, "set remote answer");
+        error = co_await SetRemote(pc1, std::move(answer_for_pc1), timeouts.timer, timeouts.sdp_step);
+        if (!error.ok()) {
+            co_return error;
+        }
+        set_remote_answer.End();
+        relay_to_pc1->SetRemoteReady();
 
-        // Wait for set to complete
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        ASYNC_LOG(kInfo, {}, "SDP exchange completed");
 
-        // Create answer on pc2
-        pc2->CreateAnswer(answer_observer.get(), webrtc::PeerConnectionInterface::RTCOfferAnswerOptions());
+        ASYNC_LOG(kInfo, {}, "Waiting for connection establishment...");
+        error = co_await Connected(*observer1, timeouts.timer, timeouts.connection);
+        if (!error.ok()) {
+            co_return error;
+        }
+        handshake1.End();
+        co_return co_await Connected(*observer2, timeouts.timer, timeouts.connection);
     }
 
-    static void ExchangeICECandidates(webrtc::scoped_refptr<webrtc::PeerConnectionInterface> pc1,
-                                      webrtc::scoped_refptr<webrtc::PeerConnectionInterface> pc2,
-                                      SimplePeerConnectionObserver* observer1,
-                                      SimplePeerConnectionObserver* observer2) {
+    // Completes once both peers have received their first data channel message.
+    static Task<webrtc::RTCError> AwaitFirstMessages(SimplePeerConnectionObserver* observer1,
+                                                     SimplePeerConnectionObserver* observer2,
+                                                     HandshakeTimeouts timeouts) {
+        using namespace async_handshake;
+
+        webrtc::RTCError error = co_await FirstMessage(*observer1, timeouts.timer, timeouts.first_message);
+        if (!error.ok()) {
+            co_return error;
+        }
+        co_return co_await FirstMessage(*observer2, timeouts.timer, timeouts.first_message);
+    }
+
+    // Restarts ICE between two peers that have connected before: an offer
+    // with ice_restart set and its answer, over fresh relays so candidates
+    // for the new credentials trickle again once each side has the
+    // description they belong to. The DTLS transport, the SCTP association
+    // and the data channels are kept. Completes once both descriptions are
+    // applied; the connection is back when the new checks succeed.
+    static Task<webrtc::RTCError> RestartIce(PeerEndpoint offerer, PeerEndpoint answerer, HandshakeTimeouts timeouts) {
+        using namespace async_handshake;
+
+        webrtc::scoped_refptr<webrtc::PeerConnectionInterface> pc1 = offerer.pc;
+        webrtc::scoped_refptr<webrtc::PeerConnectionInterface> pc2 = answerer.pc;
+        SimplePeerConnectionObserver* observer1 = offerer.observer;
+        SimplePeerConnectionObserver* observer2 = answerer.observer;
+
+        auto relay_to_pc2 =
+            IceCandidateRelay::Create(observer1->name() + "->" + observer2->name(), pc2, answerer.signaling_thread);
+        auto relay_to_pc1 =
+            IceCandidateRelay::Create(observer2->name() + "->" + observer1->name(), pc1, offerer.signaling_thread);
+        observer1->SetIceCandidateRelay(relay_to_pc2);
+        observer2->SetIceCandidateRelay(relay_to_pc1);
 
-        // Exchange ICE candidates from pc1 to pc2
-        for (const auto& candidate : observer1->GetIceCandidates()) {
-            pc2->AddIceCandidate(candidate.get());
+        TraceSpan restart1(observer1->trace_track(), "ICE restart");
+        TraceSpan restart2(observer2->trace_track(), "ICE restart");
+
+        // Same thread hops as Connect().
+        co_await ResumeOn(offerer.signaling_thread);
+        webrtc::PeerConnectionInterface::RTCOfferAnswerOptions options;
+        options.ice_restart = true;
+        SdpResult offer = co_await CreateOffer(pc1, timeouts.timer, timeouts.sdp_step, options);
+        if (!offer.ok()) {
+            co_return offer.MoveError();
         }
+        std::unique_ptr<webrtc::SessionDescriptionInterface> offer_for_pc1 = offer.MoveValue();
+        std::unique_ptr<webrtc::SessionDescriptionInterface> offer_for_pc2 = Copy(*offer_for_pc1, false);
 
-        // Exchange ICE candidates from pc2 to pc1
-        for (const auto& candidate : observer2->GetIceCandidates()) {
-            pc1->AddIceCandidate(candidate.get());
+        webrtc::RTCError error = co_await SetLocal(pc1, std::move(offer_for_pc1), timeouts.timer, timeouts.sdp_step);
+        if (!error.ok()) {
+            co_return error;
+        }
+        co_await ResumeOn(answerer.signaling_thread);
+        error = co_await SetRemote(pc2, std::move(offer_for_pc2), timeouts.timer, timeouts.sdp_step);
+        if (!error.ok()) {
+            co_return error;
         }
+        relay_to_pc2->SetRemoteReady();
 
-        observer1->ClearIceCandidates();
-        observer2->ClearIceCandidates();
+        SdpResult answer = co_await CreateAnswer(pc2, timeouts.timer, timeouts.sdp_step);
+        if (!answer.ok()) {
+            co_return answer.MoveError();
+        }
+        std::unique_ptr<webrtc::SessionDescriptionInterface> answer_for_pc2 = answer.MoveValue();
+        std::unique_ptr<webrtc::SessionDescriptionInterface> answer_for_pc1 = Copy(*answer_for_pc2, false);
+
+        error = co_await SetLocal(pc2, std::move(answer_for_pc2), timeouts.timer, timeouts.sdp_step);
+        if (!error.ok()) {
+            co_return error;
+        }
+        co_await ResumeOn(offerer.signaling_thread);
+        error = co_await SetRemote(pc1, std::move(answer_for_pc1), timeouts.timer, timeouts.sdp_step);
+        if (!error.ok()) {
+            co_return error;
+        }
+        relay_to_pc1->SetRemoteReady();
+        co_return webrtc::RTCError::OK();
+    }
+
+private:
+    // A second, independent description for the other peer.
+    static std::unique_ptr<webrtc::SessionDescriptionInterface> Copy(
+        const webrtc::SessionDescriptionInterface& description, bool reparse) {
+        if (!reparse) {
+            return description.Clone();
+        }
+        std::string text;
+        description.ToString(&text);
+        return webrtc::CreateSessionDescription(description.GetType(), text);
     }
-};
\ No newline at end of file
+};
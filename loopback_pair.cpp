@@ -0,0 +1 @@
+#include "loopback_pair.h"
\ No newline at end of file
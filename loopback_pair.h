@@ -0,0 +1,222 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <api/media_stream_interface.h>
+#include <api/peer_connection_interface.h>
+#include <api/rtc_error.h>
+#include <api/rtp_parameters.h>
+#include <api/rtp_transceiver_interface.h>
+#include <api/scoped_refptr.h>
+
+#include "factory_pool.h"
+#include "local_signaling.h"
+#include "simple_peer_connection_observer.h"
+#include "task.h"
+
+// Two PeerConnections from the same process wired together through
+// LocalSignaling, with a data channel opened by the first peer. Each side
+// may live on a different factory shard.
+//
+// If |dc_config| is negotiated, the default channel is created on both peers
+// with the same stream id instead, and opens as soon as SCTP is up without
+// the in-band DCEP handshake. More such channels can be added with
+// AddNegotiatedChannel().
+class LoopbackPair {
+public:
+    static webrtc::RTCErrorOr<std::unique_ptr<LoopbackPair>> Create(
+        FactoryShard::Lease shard1,
+        FactoryShard::Lease shard2,
+        const webrtc::PeerConnectionInterface::RTCConfiguration& config,
+        const std::string& name_prefix,
+        const webrtc::DataChannelInit& dc_config,
+        const std::string& channel_label = "hello_channel") {
+        std::unique_ptr<LoopbackPair> pair(new LoopbackPair(name_prefix));
+
+        // Create PeerConnections using CreatePeerConnectionOrError
+        webrtc::PeerConnectionDependencies pc1_dependencies(pair->observer1_.get());
+        auto pc1_result = shard1.factory()->CreatePeerConnectionOrError(config, std::move(pc1_dependencies));
+        if (!pc1_result.ok()) {
+            return pc1_result.MoveError();
+        }
+        pair->pc1_ = pc1_result.MoveValue();
+
+        webrtc::PeerConnectionDependencies pc2_dependencies(pair->observer2_.get());
+        auto pc2_result = shard2.factory()->CreatePeerConnectionOrError(config, std::move(pc2_dependencies));
+        if (!pc2_result.ok()) {
+            return pc2_result.MoveError();
+        }
+        pair->pc2_ = pc2_result.MoveValue();
+        pair->shard1_ = std::move(shard1);
+        pair->shard2_ = std::move(shard2);
+
+        auto data_channel_result = pair->pc1_->CreateDataChannelOrError(channel_label, &dc_config);
+        if (!data_channel_result.ok()) {
+            return data_channel_result.MoveError();
+        }
+        pair->data_channel_ = data_channel_result.MoveValue();
+        pair->observer1_->GetDataObserver()->SetDataChannel(pair->data_channel_);
+
+        if (dc_config.negotiated) {
+            auto remote_result = pair->pc2_->CreateDataChannelOrError(channel_label, &dc_config);
+            if (!remote_result.ok()) {
+                return remote_result.MoveError();
+            }
+            pair->negotiated_channels_.push_back(remote_result.MoveValue());
+            pair->observer2_->GetDataObserver()->SetDataChannel(pair->negotiated_channels_.back());
+        }
+
+        return pair;
+    }
+
+    ~LoopbackPair() { Close(); }
+
+    // Creates channel |label| on both peers with |init|.id as its SCTP stream
+    // id, and binds each end to its side's observer for |label|. Call before
+    // Connect(); ids must be unique per pair. Reserved ids are skipped when
+    // an in-band channel is later given one.
+    webrtc::RTCError AddNegotiatedChannel(const std::string& label, webrtc::DataChannelInit init) {
+        if (init.id < 0) {
+            return webrtc::RTCError(webrtc::RTCErrorType::INVALID_PARAMETER,
+                                    "Negotiated channel " + label + " needs a stream id");
+        }
+        init.negotiated = true;
+        auto local_result = pc1_->CreateDataChannelOrError(label, &init);
+        if (!local_result.ok()) {
+            return local_result.MoveError();
+        }
+        auto remote_result = pc2_->CreateDataChannelOrError(label, &init);
+        if (!remote_result.ok()) {
+            return remote_result.MoveError();
+        }
+        negotiated_channels_.push_back(local_result.MoveValue());
+        observer1_->GetDataObserver(label)->SetDataChannel(negotiated_channels_.back());
+        negotiated_channels_.push_back(remote_result.MoveValue());
+        observer2_->GetDataObserver(label)->SetDataChannel(negotiated_channels_.back());
+        return webrtc::RTCError::OK();
+    }
+
+    // Sends a video track fed by |source| from the first peer to the second,
+    // which sees it through its observer's video track handler. With |codec|
+    // set (an SDP name such as "VP8"), negotiation is limited to that codec;
+    // UNSUPPORTED_OPERATION means this build has no encoder and decoder for
+    // it. Call before Connect().
+    webrtc::RTCErrorOr<webrtc::scoped_refptr<webrtc::RtpTransceiverInterface>> AddVideoTrack(
+        const std::string& track_id,
+        webrtc::scoped_refptr<webrtc::VideoTrackSourceInterface> source,
+        const std::string& codec = "") {
+        return AddSendOnlyTrack(shard1_.factory()->CreateVideoTrack(source, track_id), webrtc::MediaType::VIDEO,
+                                codec);
+    }
+
+    // Sends an audio track from the first peer to the second. Audio tracks
+    // carry whatever the sending factory's audio device captures, and the
+    // second peer plays them out through its factory's audio device. |codec|
+    // works as in AddVideoTrack(), e.g. "opus".
+    webrtc::RTCErrorOr<webrtc::scoped_refptr<webrtc::RtpTransceiverInterface>> AddAudioTrack(
+        const std::string& track_id,
+        webrtc::scoped_refptr<webrtc::AudioSourceInterface> source,
+        const std::string& codec = "") {
+        return AddSendOnlyTrack(shard1_.factory()->CreateAudioTrack(track_id, source.get()), webrtc::MediaType::AUDIO,
+                                codec);
+    }
+
+    // Timeouts run on the offerer's signaling thread unless |timeouts.timer|
+    // is set.
+    Task<webrtc::RTCError> Connect(HandshakeTimeouts timeouts, SdpOptions sdp = {}) {
+        if (!timeouts.timer) {
+            timeouts.timer = shard1_.signaling_thread();
+        }
+        return LocalSignaling::Connect(offerer(), answerer(), timeouts, std::move(sdp));
+    }
+
+    // Drops the relays (they hold the remote PeerConnection) and closes both
+    // PeerConnections. Safe to call more than once.
+    void Close() {
+        observer1_->SetIceCandidateRelay(nullptr);
+        observer2_->SetIceCandidateRelay(nullptr);
+        data_channel_ = nullptr;
+        negotiated_channels_.clear();
+        if (pc1_) {
+            pc1_->Close();
+            pc1_ = nullptr;
+        }
+        if (pc2_) {
+            pc2_->Close();
+            pc2_ = nullptr;
+        }
+        shard1_.Reset();
+        shard2_.Reset();
+    }
+
+    PeerEndpoint offerer() { return {pc1_, observer1_.get(), shard1_.signaling_thread()}; }
+    PeerEndpoint answerer() { return {pc2_, observer2_.get(), shard2_.signaling_thread()}; }
+
+    SimplePeerConnectionObserver* observer1() { return observer1_.get(); }
+    SimplePeerConnectionObserver* observer2() { return observer2_.get(); }
+    webrtc::scoped_refptr<webrtc::DataChannelInterface> data_channel() { return data_channel_; }
+    webrtc::Thread* network_thread1() const { return shard1_.network_thread(); }
+    webrtc::Thread* network_thread2() const { return shard2_.network_thread(); }
+
+private:
+    // Adds |track| to the first peer as send-only, limited to |codec| if set.
+    webrtc::RTCErrorOr<webrtc::scoped_refptr<webrtc::RtpTransceiverInterface>> AddSendOnlyTrack(
+        webrtc::scoped_refptr<webrtc::MediaStreamTrackInterface> track,
+        webrtc::MediaType media_type,
+        const std::string& codec) {
+        webrtc::RtpTransceiverInit init;
+        init.direction = webrtc::RtpTransceiverDirection::kSendOnly;
+        auto transceiver_result = pc1_->AddTransceiver(track, init);
+        if (!transceiver_result.ok()) {
+            return transceiver_result.MoveError();
+        }
+        webrtc::scoped_refptr<webrtc::RtpTransceiverInterface> transceiver = transceiver_result.MoveValue();
+        if (codec.empty()) {
+            return transceiver;
+        }
+
+        // Both ends must support the codec, so filter what the sending
+        // factory can encode by what the receiving factory can decode.
+        const webrtc::RtpCapabilities receivable = shard2_.factory()->GetRtpReceiverCapabilities(media_type);
+        std::vector<webrtc::RtpCodecCapability> preferred;
+        for (const webrtc::RtpCodecCapability& sendable :
+             shard1_.factory()->GetRtpSenderCapabilities(media_type).codecs) {
+            if (sendable.name != codec) {
+                continue;
+            }
+            for (const webrtc::RtpCodecCapability& candidate : receivable.codecs) {
+                if (candidate == sendable) {
+                    preferred.push_back(sendable);
+                    break;
+                }
+            }
+        }
+        if (preferred.empty()) {
+            return webrtc::RTCError(webrtc::RTCErrorType::UNSUPPORTED_OPERATION, codec + " is not available");
+        }
+        webrtc::RTCError error = transceiver->SetCodecPreferences(preferred);
+        if (!error.ok()) {
+            return error;
+        }
+        return transceiver;
+    }
+
+    explicit LoopbackPair(const std::string& name_prefix)
+        : observer1_(std::make_unique<SimplePeerConnectionObserver>(name_prefix + "1")),
+          observer2_(std::make_unique<SimplePeerConnectionObserver>(name_prefix + "2")) {}
+
+    // Observers are declared first so they outlive the PeerConnections.
+    std::unique_ptr<SimplePeerConnectionObserver> observer1_;
+    std::unique_ptr<SimplePeerConnectionObserver> observer2_;
+    webrtc::scoped_refptr<webrtc::PeerConnectionInterface> pc1_;
+    webrtc::scoped_refptr<webrtc::PeerConnectionInterface> pc2_;
+    webrtc::scoped_refptr<webrtc::DataChannelInterface> data_channel_;
+    // Negotiated channel ends other than |data_channel_|, kept so Close()
+    // releases them.
+    std::vector<webrtc::scoped_refptr<webrtc::DataChannelInterface>> negotiated_channels_;
+    FactoryShard::Lease shard1_;
+    FactoryShard::Lease shard2_;
+};
@@ -1,242 +1,464 @@
+#include <algorithm>
 #include <chrono>
+#include <cstdint>
 #include <iostream>
-#include <thread>
+#include <string>
 
 #include <api/peer_connection_interface.h>
-#include <api/create_peerconnection_factory.h>
-#include <api/audio_codecs/builtin_audio_decoder_factory.h>
-#include <api/audio_codecs/builtin_audio_encoder_factory.h>
-// #include <api/video_codecs/builtin_video_decoder_factory.h>
-// #include <api/video_codecs/builtin_video_encoder_factory.h>
-#include <api/video_codecs/video_decoder_factory_template.h>
-#include <api/video_codecs/video_decoder_factory_template_dav1d_adapter.h>
-#include <api/video_codecs/video_decoder_factory_template_libvpx_vp8_adapter.h>
-#include <api/video_codecs/video_decoder_factory_template_libvpx_vp9_adapter.h>
-#include <api/video_codecs/video_decoder_factory_template_open_h264_adapter.h>
-#include <api/video_codecs/video_encoder_factory_template.h>
-#include <api/video_codecs/video_encoder_factory_template_libaom_av1_adapter.h>
-#include <api/video_codecs/video_encoder_factory_template_libvpx_vp8_adapter.h>
-#include <api/video_codecs/video_encoder_factory_template_libvpx_vp9_adapter.h>
-#include <api/video_codecs/video_encoder_factory_template_open_h264_adapter.h>
 
+#include "async_log.h"
+#include "batch_benchmark.h"
+#include "broadcast_benchmark.h"
+#include "bulk_transfer.h"
+#include "command_line.h"
+#include "factory_pool.h"
+#include "file_transfer.h"
+#include "handshake_trace.h"
 #include "local_signaling.h"
-#include "sdp_observer.h"
+#include "loopback_pair.h"
+#include "pool_benchmark.h"
+#include "priority_benchmark.h"
+#include "receive_benchmark.h"
+#include "rpc_benchmark.h"
+#include "scale_benchmark.h"
+#include "sdp_benchmark.h"
+#include "send_benchmark.h"
 #include "simple_peer_connection_observer.h"
+#include "startup_benchmark.h"
+#include "stats_collector.h"
+#include "task.h"
+#include "uds_benchmark.h"
+#include "uds_signaling.h"
+#include "uds_signaling_server.h"
+
+#if !defined(WEBRTC_EXAMPLE_DATA_ONLY)
+#include "audio_benchmark.h"
+#include "video_benchmark.h"
+#endif
+
+#if defined(WEBRTC_EXAMPLE_NETWORK_EMULATION)
+#include "emulation_benchmark.h"
+#include "reconnect_benchmark.h"
+#endif
 
 #include "rtc_base/ssl_adapter.h"
 
-int main(int argc, char *argv[]) {
-    // Initialize SSL
-    webrtc::InitializeSSL();
+// Connects one loopback pair and exchanges a hello message in each direction.
+static int RunHelloWorld(FactoryShard* shard,
+                         const webrtc::PeerConnectionInterface::RTCConfiguration& config,
+                         StatsCollector* stats) {
+    // Create data channel on pc1
+    webrtc::DataChannelInit dc_config;
+    dc_config.ordered = true;
 
-    // Create threads
-    std::unique_ptr<webrtc::Thread> network_thread = webrtc::Thread::CreateWithSocketServer();
-    std::unique_ptr<webrtc::Thread> worker_thread = webrtc::Thread::Create();
-    std::unique_ptr<webrtc::Thread> signaling_thread = webrtc::Thread::Create();
-
-    network_thread->Start();
-    worker_thread->Start();
-    signaling_thread->Start();
-
-    // Create PeerConnection factory
-    webrtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> pc_factory =
-        webrtc::CreatePeerConnectionFactory(
-            network_thread.get(),
-            worker_thread.get(),
-            signaling_thread.get(),
-            nullptr, // audio device module
-            webrtc::CreateBuiltinAudioEncoderFactory(),
-            webrtc::CreateBuiltinAudioDecoderFactory(),
-            // https://issues.webrtc.org/issues/42223784#comment26
-            // webrtc::CreateBuiltinVideoEncoderFactory(),
-            // webrtc::CreateBuiltinVideoDecoderFactory(),
-            std::make_unique<webrtc::VideoEncoderFactoryTemplate<
-              webrtc::LibvpxVp8EncoderTemplateAdapter,
-              webrtc::LibvpxVp9EncoderTemplateAdapter,
-              webrtc::OpenH264EncoderTemplateAdapter,
-              webrtc::LibaomAv1EncoderTemplateAdapter>>(),
-            std::make_unique<webrtc::VideoDecoderFactoryTemplate<
-              webrtc::LibvpxVp8DecoderTemplateAdapter,
-              webrtc::LibvpxVp9DecoderTemplateAdapter,
-              webrtc::OpenH264DecoderTemplateAdapter,
-              webrtc::Dav1dDecoderTemplateAdapter>>(),
-            nullptr, // audio mixer
-            nullptr  // audio processing
-        );
-
-    if (!pc_factory) {
-        std::cerr << "Failed to create PeerConnectionFactory!" << std::endl;
+    auto pair_result = LoopbackPair::Create(shard->Acquire(), shard->Acquire(), config, "Peer", dc_config);
+    if (!pair_result.ok()) {
+        std::cerr << "Failed to create loopback pair: " << pair_result.error().message() << std::endl;
         return -1;
     }
+    std::unique_ptr<LoopbackPair> pair = pair_result.MoveValue();
+    SimplePeerConnectionObserver* observer1 = pair->observer1();
+    SimplePeerConnectionObserver* observer2 = pair->observer2();
 
-    std::cout << "PeerConnectionFactory created successfully" << std::endl;
+    AsyncLog::Flush();
+    std::cout << "PeerConnections created successfully" << std::endl;
+    std::cout << "Data channel created: " << pair->data_channel()->label() << std::endl;
 
-    // Configure PeerConnections
-    webrtc::PeerConnectionInterface::RTCConfiguration config;
-    webrtc::PeerConnectionInterface::IceServer stun_server;
-    stun_server.uri = "stun:stun.l.google.com:19302";
-    config.servers.push_back(stun_server);
+    // Run the handshake; every step resumes straight from its WebRTC callback
+    HandshakeTimeouts timeouts;
+    timeouts.timer = shard->signaling_thread();
 
-    // Create observers
-    auto observer1 = std::make_unique<SimplePeerConnectionObserver>("Peer1");
-    auto observer2 = std::make_unique<SimplePeerConnectionObserver>("Peer2");
+    const auto handshake_start = std::chrono::steady_clock::now();
+    webrtc::RTCError handshake = SyncWait(pair->Connect(timeouts));
+    const auto time_to_connected = std::chrono::steady_clock::now() - handshake_start;
+    AsyncLog::Flush();
 
-    // Create PeerConnections using CreatePeerConnectionOrError
-    webrtc::PeerConnectionDependencies pc1_dependencies(observer1.get());
-    webrtc::PeerConnectionDependencies pc2_dependencies(observer2.get());
+    if (handshake.ok()) {
+        std::cout << "✅ WebRTC connection established successfully!" << std::endl;
+        std::cout << "Time to connected: "
+                  << std::chrono::duration_cast<std::chrono::microseconds>(time_to_connected).count() / 1000.0
+                  << " ms" << std::endl;
+
+        // Connectivity checks start with the first trickled candidate
+        const int64_t first_candidate_us =
+            std::min(observer1->FirstCandidateTimeUs(), observer2->FirstCandidateTimeUs());
+        const int64_t connected_us = std::max(observer1->ConnectedTimeUs(), observer2->ConnectedTimeUs());
+        std::cout << "First candidate to connected: " << (connected_us - first_candidate_us) / 1000.0 << " ms"
+                  << std::endl;
+
+        if (stats) {
+            stats->Track(observer1->name(), pair->offerer().pc);
+            stats->Track(observer2->name(), pair->answerer().pc);
+        }
 
-    auto pc1_result = pc_factory->CreatePeerConnectionOrError(config, std::move(pc1_dependencies));
-    if (!pc1_result.ok()) {
-        std::cerr << "Failed to create PeerConnection 1: " << pc1_result.error().message() << std::endl;
-        return -1;
-    }
+        // Wait for data channel messages
+        std::cout << "Waiting for data channel messages..." << std::endl;
+        webrtc::RTCError messages = SyncWait(LocalSignaling::AwaitFirstMessages(observer1, observer2, timeouts));
+        AsyncLog::Flush();
 
-    webrtc::scoped_refptr<webrtc::PeerConnectionInterface> pc1 = pc1_result.MoveValue();
+        if (messages.ok()) {
+            std::cout << "✅ Data channel communication successful!" << std::endl;
+        } else {
+            std::cout << "⚠️  Data channel communication partially successful" << std::endl;
+        }
 
-    auto pc2_result = pc_factory->CreatePeerConnectionOrError(config, std::move(pc2_dependencies));
-    if (!pc2_result.ok()) {
-        std::cerr << "Failed to create PeerConnection 2: " << pc2_result.error().message() << std::endl;
-        return -1;
+    } else {
+        std::cout << "❌ Failed to establish WebRTC connection: " << handshake.message() << std::endl;
     }
-    webrtc::scoped_refptr<webrtc::PeerConnectionInterface> pc2 = pc2_result.MoveValue();
 
-    std::cout << "PeerConnections created successfully" << std::endl;
+    std::cout << "\nWebRTC Hello World completed!" << std::endl;
+    std::cout << "Connection summary:" << std::endl;
+    std::cout << "- Peer1 connected: " << (observer1->IsPeerConnected() ? "Yes" : "No") << std::endl;
+    std::cout << "- Peer2 connected: " << (observer2->IsPeerConnected() ? "Yes" : "No") << std::endl;
+    std::cout << "- Messages exchanged: " << (observer1->HasReceivedMessage() && observer2->HasReceivedMessage() ? "Yes" : "Partial/No") << std::endl;
 
-    // Create data channel on pc1
-    webrtc::DataChannelInit dc_config;
-    dc_config.ordered = true;
+    if (stats) {
+        stats->PrintSummary(std::cout);
+        stats->Untrack(observer1->name());
+        stats->Untrack(observer2->name());
+    }
+    pair->Close();
+    return 0;
+}
 
-    auto data_channel_result = pc1->CreateDataChannelOrError("hello_channel", &dc_config);
-    if (!data_channel_result.ok()) {
-        std::cerr << "Failed to create data channel: " << data_channel_result.error().message() << std::endl;
+// One peer of a hello exchange with a peer in another process, signaled
+// through the UdsSignalingServer at |socket_path| (see --mode=uds-server).
+// The offerer opens the data channel.
+static int RunUdsPeer(FactoryShard* shard,
+                      const webrtc::PeerConnectionInterface::RTCConfiguration& config,
+                      const std::string& socket_path,
+                      bool offerer,
+                      uint32_t id,
+                      uint32_t peer_id) {
+    SimplePeerConnectionObserver observer(offerer ? "Offerer" : "Answerer");
+    FactoryShard::Lease lease = shard->Acquire();
+    webrtc::PeerConnectionDependencies dependencies(&observer);
+    auto pc_result = lease.factory()->CreatePeerConnectionOrError(config, std::move(dependencies));
+    if (!pc_result.ok()) {
+        std::cerr << "Failed to create PeerConnection: " << pc_result.error().message() << std::endl;
         return -1;
     }
-
-    webrtc::scoped_refptr<webrtc::DataChannelInterface> data_channel = data_channel_result.MoveValue();
-    observer1->GetDataObserver()->SetDataChannel(data_channel);
-    std::cout << "Data channel created: " << data_channel->label() << std::endl;
-
-    // Create offer
-    webrtc::scoped_refptr<CreateSDPObserver> offer_observer = CreateSDPObserver::Create();
-    pc1->CreateOffer(offer_observer.get(), webrtc::PeerConnectionInterface::RTCOfferAnswerOptions());
-
-    std::cout << "Creating offer..." << std::endl;
-
-    // Wait for offer creation
-    int timeout = 50; // 5 seconds
-    while (!offer_observer->IsSuccessful() && timeout-- > 0) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    webrtc::scoped_refptr<webrtc::PeerConnectionInterface> pc = pc_result.MoveValue();
+
+    if (offerer) {
+        webrtc::DataChannelInit dc_config;
+        dc_config.ordered = true;
+        auto channel_result = pc->CreateDataChannelOrError("hello_channel", &dc_config);
+        if (!channel_result.ok()) {
+            std::cerr << "Failed to create data channel: " << channel_result.error().message() << std::endl;
+            pc->Close();
+            return -1;
+        }
+        observer.GetDataObserver()->SetDataChannel(channel_result.MoveValue());
     }
 
-    if (!offer_observer->IsSuccessful()) {
-        std::cerr << "Failed to create offer!" << std::endl;
+    webrtc::scoped_refptr<UdsSignalingClient> client = UdsSignalingClient::Connect(socket_path, id);
+    if (!client) {
+        std::cerr << "Failed to connect to signaling server at " << socket_path << std::endl;
+        pc->Close();
         return -1;
     }
 
-    // Get the created offer and clone it immediately
-    auto offer = offer_observer->TakeCreatedSDP();
-    std::string offer_sdp;
-    offer->ToString(&offer_sdp);
-
-    // Create two separate copies of the SDP
-    auto offer_for_pc1 = webrtc::CreateSessionDescription(offer->GetType(), offer_sdp);
-    auto offer_for_pc2 = webrtc::CreateSessionDescription(offer->GetType(), offer_sdp);
+    HandshakeTimeouts timeouts;
+    timeouts.timer = lease.signaling_thread();
+    const auto handshake_start = std::chrono::steady_clock::now();
+    webrtc::RTCError result = SyncWait(
+        UdsSignaling::Connect({pc, &observer, lease.signaling_thread()}, client, peer_id, offerer, timeouts));
+    const auto time_to_connected = std::chrono::steady_clock::now() - handshake_start;
+    if (result.ok()) {
+        std::cout << "Time to connected: "
+                  << std::chrono::duration_cast<std::chrono::microseconds>(time_to_connected).count() / 1000.0
+                  << " ms" << std::endl;
+        result = SyncWait(UdsSignaling::AwaitFirstMessage(&observer, timeouts));
+    }
+    AsyncLog::Flush();
+    if (result.ok()) {
+        std::cout << "✅ Data channel communication with peer " << peer_id << " successful!" << std::endl;
+    } else {
+        std::cout << "❌ " << result.message() << std::endl;
+    }
 
-    // Set local description on pc1
-    webrtc::scoped_refptr<SetSDPObserver> set_local_observer = SetSDPObserver::Create();
-    pc1->SetLocalDescription(set_local_observer.get(), offer_for_pc1.release());
+    observer.SetIceCandidateRelay(nullptr);
+    client->Close();
+    pc->Close();
+    return result.ok() ? 0 : -1;
+}
 
-    // Exchange SDPs and create answer
-    webrtc::scoped_refptr<CreateSDPObserver> answer_observer = CreateSDPObserver::Create();
+int main(int argc, char *argv[]) {
+    CommandLine args(argc, argv);
+
+    // Observer logging goes through the asynchronous sink
+    AsyncLog::SetMinLevel(AsyncLog::LevelFromString(args.GetString("log-level", "info"), LogLevel::kInfo));
+    AsyncLog::Start();
+
+    // Startup measurements need a fresh process, so they run before the usual setup
+    const std::string mode = args.GetString("mode", "hello");
+    if (mode == "startup-probe" || mode == "startup") {
+        int result = 0;
+        if (mode == "startup-probe") {
+            result = StartupBenchmark::RunProbe();
+        } else {
+            StartupOptions options;
+            options.runs = args.GetInt("runs", options.runs);
+            options.binaries = args.GetStringList("binaries", options.binaries);
+            result = StartupBenchmark(options).Run();
+        }
+        AsyncLog::Stop();
+        return result;
+    }
 
-    LocalSignaling::ExchangeSDPs(pc1, pc2, std::move(offer_for_pc2), answer_observer);
+    // Initialize SSL
+    webrtc::InitializeSSL();
 
-    std::cout << "Exchanging offer and creating answer..." << std::endl;
+    // Optional handshake phase tracing; peers created from here on get a track
+    const std::string trace_path = args.GetString("trace", "");
+    if (!trace_path.empty()) {
+        HandshakeTrace::Start();
+    }
 
-    // Wait for answer creation
-    timeout = 50;
-    while (!answer_observer->IsSuccessful() && timeout-- > 0) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    // Create the PeerConnection factories, one per shard of threads
+    PeerConnectionFactoryPool::Options pool_options;
+    pool_options.shards = args.GetInt("shards", pool_options.shards);
+    pool_options.pin_cpus = args.GetBool("pin-cpus", pool_options.pin_cpus);
+    if (args.GetString("placement", "round-robin") == "least-loaded") {
+        pool_options.placement = ShardPlacement::kLeastLoaded;
     }
 
-    if (!answer_observer->IsSuccessful()) {
-        std::cerr << "Failed to create answer!" << std::endl;
+    std::unique_ptr<PeerConnectionFactoryPool> factory_pool = PeerConnectionFactoryPool::Create(pool_options);
+    if (!factory_pool) {
+        std::cerr << "Failed to create PeerConnectionFactory!" << std::endl;
+        AsyncLog::Stop();
         return -1;
     }
 
-    auto answer = answer_observer->TakeCreatedSDP();
-    std::string answer_sdp;
-    answer->ToString(&answer_sdp);
-
-    // Create two separate copies of the answer SDP
-    auto answer_for_pc2 = webrtc::CreateSessionDescription(answer->GetType(), answer_sdp);
-    auto answer_for_pc1 = webrtc::CreateSessionDescription(answer->GetType(), answer_sdp);
-
-    // Set local description on pc2
-    webrtc::scoped_refptr<SetSDPObserver> set_local2_observer = SetSDPObserver::Create();
-    pc2->SetLocalDescription(set_local2_observer.get(), answer_for_pc2.release());
-
-    // Set remote description (answer) on pc1
-    webrtc::scoped_refptr<SetSDPObserver> set_remote_observer = SetSDPObserver::Create();
-    pc1->SetRemoteDescription(set_remote_observer.get(), answer_for_pc1.release());
-
-    std::cout << "SDP exchange completed" << std::endl;
+    std::cout << "PeerConnectionFactory created successfully" << std::endl;
 
-    // Wait for ICE gathering and exchange candidates
-    std::cout << "Waiting for ICE gathering..." << std::endl;
-    timeout = 100; // 10 seconds
-    while ((!observer1->IsIceGatheringComplete() || !observer2->IsIceGatheringComplete()) && timeout-- > 0) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    // Configure PeerConnections
+    webrtc::PeerConnectionInterface::RTCConfiguration config;
+    webrtc::PeerConnectionInterface::IceServer stun_server;
+    stun_server.uri = "stun:stun.l.google.com:19302";
+    config.servers.push_back(stun_server);
 
-        // Periodically exchange ICE candidates
-        if (timeout % 10 == 0) {
-            LocalSignaling::ExchangeICECandidates(pc1, pc2, observer1.get(), observer2.get());
+    // Optional periodic GetStats export
+    std::unique_ptr<StatsCollector> stats;
+    if (args.Has("stats-out")) {
+        StatsOptions stats_options;
+        stats_options.output_path = args.GetString("stats-out", "");
+        stats_options.interval =
+            webrtc::TimeDelta::Millis(args.GetInt("stats-interval-ms", stats_options.interval.ms()));
+        if (args.GetString("stats-format", "jsonl") == "prometheus") {
+            stats_options.format = StatsFormat::kPrometheus;
+        }
+        stats = StatsCollector::Create(stats_options);
+        if (!stats) {
+            AsyncLog::Stop();
+            return -1;
         }
     }
 
-    // Final ICE candidate exchange
-    LocalSignaling::ExchangeICECandidates(pc1, pc2, observer1.get(), observer2.get());
-
-    std::cout << "Waiting for connection establishment..." << std::endl;
-
-    // Wait for connection establishment
-    timeout = 100; // 10 seconds
-    while ((!observer1->IsPeerConnected() || !observer2->IsPeerConnected()) && timeout-- > 0) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
-    }
-
-    if (observer1->IsPeerConnected() && observer2->IsPeerConnected()) {
-        std::cout << "✅ WebRTC connection established successfully!" << std::endl;
-
-        // Wait for data channel messages
-        std::cout << "Waiting for data channel messages..." << std::endl;
-        timeout = 50; // 5 seconds
-        while ((!observer1->HasReceivedMessage() || !observer2->HasReceivedMessage()) && timeout-- > 0) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    int result = 0;
+    if (mode == "scale") {
+        ScaleOptions options;
+        options.pairs = args.GetInt("pairs", options.pairs);
+        options.concurrency = args.GetInt("concurrency", options.concurrency);
+        options.use_stun = args.GetBool("stun", options.use_stun);
+        options.stats = stats.get();
+        options.hold = webrtc::TimeDelta::Millis(args.GetInt("hold-ms", 0));
+        result = ScaleBenchmark(factory_pool.get(), config, options).Run();
+    } else if (mode == "bulk") {
+        BulkOptions options;
+        options.message_sizes = args.GetIntList("sizes", options.message_sizes);
+        options.duration = webrtc::TimeDelta::Millis(args.GetInt("duration-ms", options.duration.ms()));
+        options.high_watermark = args.GetInt("high-watermark", options.high_watermark);
+        options.low_watermark = args.GetInt("low-watermark", options.low_watermark);
+        options.ordered = !args.GetBool("unordered", false);
+        result = BulkBenchmark(factory_pool.get(), config, options).Run();
+    } else if (mode == "file") {
+        FileOptions options;
+        options.source = args.GetString("file", options.source);
+        options.generate_bytes =
+            static_cast<uint64_t>(args.GetInt("size-mb", static_cast<int>(options.generate_bytes >> 20))) << 20;
+        options.output = args.GetString("out", options.output);
+        options.chunk_size = args.GetInt("chunk-kb", options.chunk_size / 1024) * 1024;
+        options.high_watermark = args.GetInt("high-watermark", options.high_watermark);
+        options.low_watermark = args.GetInt("low-watermark", options.low_watermark);
+        options.interrupt_percent = args.GetInt("interrupt-at", options.interrupt_percent);
+        options.resume = args.GetBool("resume", options.resume);
+        options.keep = args.GetBool("keep", options.keep);
+        result = FileBenchmark(factory_pool.get(), config, options).Run();
+    } else if (mode == "receive") {
+        ReceiveOptions options;
+        options.message_size = args.GetInt("size", options.message_size);
+        options.duration = webrtc::TimeDelta::Millis(args.GetInt("duration-ms", options.duration.ms()));
+        result = ReceiveBenchmark(pool_options, config, options).Run();
+    } else if (mode == "rpc") {
+        RpcBenchmarkOptions options;
+        options.rates = args.GetIntList("rates", options.rates);
+        options.request_size = args.GetInt("size", options.request_size);
+        options.deadline = webrtc::TimeDelta::Millis(args.GetInt("deadline-ms", options.deadline.ms()));
+        options.duration = webrtc::TimeDelta::Millis(args.GetInt("duration-ms", options.duration.ms()));
+        options.ordered = !args.GetBool("unordered", false);
+        result = RpcBenchmark(factory_pool.get(), config, options).Run();
+    } else if (mode == "send") {
+        SendOptions options;
+        options.message_sizes = args.GetIntList("sizes", options.message_sizes);
+        options.duration = webrtc::TimeDelta::Millis(args.GetInt("duration-ms", options.duration.ms()));
+        result = SendBenchmark(factory_pool.get(), config, options).Run();
+    } else if (mode == "batch") {
+        BatchBenchmarkOptions options;
+        options.message_size = args.GetInt("size", options.message_size);
+        options.rate = args.GetInt("rate", options.rate);
+        options.duration = webrtc::TimeDelta::Millis(args.GetInt("duration-ms", options.duration.ms()));
+        options.batch.max_frame_bytes = args.GetInt("frame-bytes", options.batch.max_frame_bytes);
+        options.batch.flush_delay = webrtc::TimeDelta::Micros(args.GetInt("flush-us", options.batch.flush_delay.us()));
+        result = BatchBenchmark(factory_pool.get(), config, options).Run();
+    } else if (mode == "broadcast") {
+        BroadcastBenchmarkOptions options;
+        options.subscribers = args.GetIntList("subscribers", options.subscribers);
+        options.message_size = args.GetInt("size", options.message_size);
+        options.rate = args.GetInt("rate", options.rate);
+        options.duration = webrtc::TimeDelta::Millis(args.GetInt("duration-ms", options.duration.ms()));
+        options.hub.high_watermark = args.GetInt("high-watermark", options.hub.high_watermark);
+        options.hub.low_watermark = args.GetInt("low-watermark", options.hub.low_watermark);
+        if (args.GetString("policy", "coalesce") == "drop") {
+            options.hub.policy = SlowSubscriberPolicy::kDrop;
         }
-
-        if (observer1->HasReceivedMessage() && observer2->HasReceivedMessage()) {
-            std::cout << "✅ Data channel communication successful!" << std::endl;
+        result = BroadcastBenchmark(factory_pool.get(), config, options).Run();
+    } else if (mode == "priority") {
+        PriorityOptions options;
+        options.bulk_message_size = args.GetInt("size", options.bulk_message_size);
+        options.control_message_size = args.GetInt("control-size", options.control_message_size);
+        options.control_rate = args.GetInt("rate", options.control_rate);
+        options.duration = webrtc::TimeDelta::Millis(args.GetInt("duration-ms", options.duration.ms()));
+        result = PriorityBenchmark(factory_pool.get(), config, options).Run();
+    } else if (mode == "pool") {
+        PoolOptions options;
+        options.sessions = args.GetInt("sessions", options.sessions);
+        options.pool_size = args.GetInt("pool-size", options.pool_size);
+        options.interval = webrtc::TimeDelta::Millis(args.GetInt("interval-ms", options.interval.ms()));
+        result = PoolBenchmark(factory_pool.get(), config, options).Run();
+    } else if (mode == "sdp") {
+        SdpBenchmarkOptions options;
+        options.pairs = args.GetInt("pairs", options.pairs);
+        result = SdpBenchmark(factory_pool.get(), config, options).Run();
+    } else if (mode == "video") {
+#if !defined(WEBRTC_EXAMPLE_DATA_ONLY)
+        VideoOptions options;
+        options.codecs = args.GetStringList("codecs", options.codecs);
+        options.source.width = args.GetInt("width", options.source.width);
+        options.source.height = args.GetInt("height", options.source.height);
+        options.source.fps = args.GetInt("fps", options.source.fps);
+        options.streams = args.GetInt("streams", options.streams);
+        options.start_bitrate_kbps = args.GetInt("start-kbps", options.start_bitrate_kbps);
+        options.duration = webrtc::TimeDelta::Millis(args.GetInt("duration-ms", options.duration.ms()));
+        result = VideoBenchmark(factory_pool.get(), config, options).Run();
+#else
+        std::cerr << "--mode=video needs a build with video codecs (WEBRTC_EXAMPLE_VIDEO_CODECS)" << std::endl;
+        result = -1;
+#endif
+    } else if (mode == "audio") {
+#if !defined(WEBRTC_EXAMPLE_DATA_ONLY)
+        AudioOptions options;
+        options.pairs = args.GetInt("pairs", options.pairs);
+        options.streams = args.GetIntList("streams", options.streams);
+        options.apm = args.GetBool("apm", options.apm);
+        options.device.sample_rate = args.GetInt("sample-rate", options.device.sample_rate);
+        options.device.channels = args.GetInt("channels", options.device.channels);
+        options.device.tone_hz = args.GetInt("tone-hz", options.device.tone_hz);
+        options.device.capture_wav = args.GetString("capture-wav", options.device.capture_wav);
+        options.device.playout_wav = args.GetString("playout-wav", options.device.playout_wav);
+        options.duration = webrtc::TimeDelta::Millis(args.GetInt("duration-ms", options.duration.ms()));
+        result = AudioBenchmark(pool_options, config, options).Run();
+#else
+        std::cerr << "--mode=audio needs a build with a media engine (WEBRTC_EXAMPLE_VIDEO_CODECS other than none)"
+                  << std::endl;
+        result = -1;
+#endif
+    } else if (mode == "uds") {
+        UdsOptions options;
+        options.pairs = args.GetInt("pairs", options.pairs);
+        options.concurrency = args.GetInt("concurrency", options.concurrency);
+        options.socket_path = args.GetString("socket", options.socket_path);
+        result = UdsBenchmark(factory_pool.get(), config, options).Run();
+    } else if (mode == "uds-server") {
+        // Relays until stdin closes (Ctrl-D) so peers in other processes can
+        // connect.
+        std::unique_ptr<UdsSignalingServer> server =
+            UdsSignalingServer::Create(args.GetString("socket", "/tmp/webrtc-signaling.sock"));
+        if (server) {
+            std::cout << "Signaling server listening on " << server->path() << std::endl;
+            std::string line;
+            while (std::getline(std::cin, line)) {
+            }
+            std::cout << "Relayed " << server->frames_relayed() << " frames (" << server->frames_dropped()
+                      << " dropped)" << std::endl;
         } else {
-            std::cout << "⚠️  Data channel communication partially successful" << std::endl;
+            result = -1;
         }
-
+    } else if (mode == "uds-peer") {
+        const bool offerer = args.GetString("role", "offerer") == "offerer";
+        const uint32_t id = args.GetInt("id", offerer ? 1 : 2);
+        const uint32_t peer_id = args.GetInt("peer-id", offerer ? 2 : 1);
+        result = RunUdsPeer(factory_pool->shard(0), config,
+                            args.GetString("socket", "/tmp/webrtc-signaling.sock"), offerer, id, peer_id);
+    } else if (mode == "emulated") {
+#if defined(WEBRTC_EXAMPLE_NETWORK_EMULATION)
+        EmulationOptions options;
+        const std::vector<std::string> links = args.GetStringList("links", {});
+        if (!links.empty()) {
+            std::erase_if(options.profiles, [&links](const LinkProfile& profile) {
+                return std::find(links.begin(), links.end(), profile.name) == links.end();
+            });
+        }
+        options.message_size = args.GetInt("size", options.message_size);
+        options.rate = args.GetInt("rate", options.rate);
+        options.duration = webrtc::TimeDelta::Millis(args.GetInt("duration-ms", options.duration.ms()));
+        result = EmulationBenchmark(config, options).Run();
+#else
+        std::cerr << "--mode=emulated needs a build with -DWEBRTC_EXAMPLE_NETWORK_EMULATION=ON" << std::endl;
+        result = -1;
+#endif
+    } else if (mode == "reconnect") {
+#if defined(WEBRTC_EXAMPLE_NETWORK_EMULATION)
+        ReconnectBenchmarkOptions options;
+        const std::string link = args.GetString("link", options.link.name);
+        for (const LinkProfile& profile : DefaultLinkProfiles()) {
+            if (profile.name == link) {
+                options.link = profile;
+            }
+        }
+        options.flaps = args.GetInt("flaps", options.flaps);
+        options.outage = webrtc::TimeDelta::Millis(args.GetInt("outage-ms", options.outage.ms()));
+        options.rate = args.GetInt("rate", options.rate);
+        options.message_size = args.GetInt("size", options.message_size);
+        options.receiving_timeout =
+            webrtc::TimeDelta::Millis(args.GetInt("receiving-timeout-ms", options.receiving_timeout.ms()));
+        options.reconnect.retry_interval =
+            webrtc::TimeDelta::Millis(args.GetInt("retry-ms", options.reconnect.retry_interval.ms()));
+        result = ReconnectBenchmark(config, options).Run();
+#else
+        std::cerr << "--mode=reconnect needs a build with -DWEBRTC_EXAMPLE_NETWORK_EMULATION=ON" << std::endl;
+        result = -1;
+#endif
+    } else if (mode == "hello") {
+        result = RunHelloWorld(factory_pool->shard(0), config, stats.get());
     } else {
-        std::cout << "❌ Failed to establish WebRTC connection" << std::endl;
+        std::cerr << "Unknown --mode=" << mode
+                  << "; valid modes: hello, scale, bulk, file, receive, rpc, send, batch, broadcast, priority, pool, "
+                     "sdp, video, audio, uds, uds-server, uds-peer, emulated, reconnect, startup"
+                  << std::endl;
+        result = -1;
     }
 
-    std::cout << "\nWebRTC Hello World completed!" << std::endl;
-    std::cout << "Connection summary:" << std::endl;
-    std::cout << "- Peer1 connected: " << (observer1->IsPeerConnected() ? "Yes" : "No") << std::endl;
-    std::cout << "- Peer2 connected: " << (observer2->IsPeerConnected() ? "Yes" : "No") << std::endl;
-    std::cout << "- Messages exchanged: " << (observer1->HasReceivedMessage() && observer2->HasReceivedMessage() ? "Yes" : "Partial/No") << std::endl;
+    if (!trace_path.empty() && !HandshakeTrace::WriteJson(trace_path)) {
+        result = -1;
+    }
 
     // Cleanup
-    data_channel = nullptr;
-    pc1 = nullptr;
-    pc2 = nullptr;
-    pc_factory = nullptr;
+    stats = nullptr;
+    factory_pool = nullptr;
 
     webrtc::CleanupSSL();
-    return 0;
+    AsyncLog::Stop();
+    return result;
 }
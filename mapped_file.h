@@ -0,0 +1,121 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+
+// A whole file mapped into memory. Pages are faulted in on first access and
+// can be handed back with Release(), so walking a file of any size through
+// the mapping keeps the resident set bounded by what is between the two.
+class MappedFile {
+public:
+    // Maps an existing file read-only for one sequential pass.
+    static std::unique_ptr<MappedFile> OpenForRead(const std::string& path) {
+        std::unique_ptr<MappedFile> file(new MappedFile(path, false));
+        file->fd_ = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat info {};
+        if (file->fd_ < 0 || fstat(file->fd_, &info) != 0) {
+            std::cerr << "Failed to open " << path << ": " << std::strerror(errno) << std::endl;
+            return nullptr;
+        }
+        file->size_ = static_cast<uint64_t>(info.st_size);
+        if (!file->Map()) {
+            return nullptr;
+        }
+        madvise(file->data_, file->size_, MADV_SEQUENTIAL);
+        return file;
+    }
+
+    // Maps |path| read-write at exactly |size| bytes, creating it if needed.
+    // Existing contents up to |size| are kept, so a partial file can be
+    // completed. Disk space is reserved up front where the file system
+    // supports it, so a full disk fails here instead of as SIGBUS later.
+    static std::unique_ptr<MappedFile> OpenForWrite(const std::string& path, uint64_t size) {
+        std::unique_ptr<MappedFile> file(new MappedFile(path, true));
+        file->fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (file->fd_ < 0 || ftruncate(file->fd_, static_cast<off_t>(size)) != 0) {
+            std::cerr << "Failed to create " << path << ": " << std::strerror(errno) << std::endl;
+            return nullptr;
+        }
+        const int reserved = size > 0 ? posix_fallocate(file->fd_, 0, static_cast<off_t>(size)) : 0;
+        if (reserved != 0 && reserved != EOPNOTSUPP && reserved != EINVAL) {
+            std::cerr << "Failed to reserve " << size << " bytes for " << path << ": " << std::strerror(reserved)
+                      << std::endl;
+            return nullptr;
+        }
+        file->size_ = size;
+        if (!file->Map()) {
+            return nullptr;
+        }
+        return file;
+    }
+
+    ~MappedFile() {
+        if (data_) {
+            munmap(data_, size_);
+        }
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const std::string& path() const { return path_; }
+    uint64_t size() const { return size_; }
+    const uint8_t* data() const { return data_; }
+    // Null for read-only mappings.
+    uint8_t* mutable_data() { return writable_ ? data_ : nullptr; }
+
+    // Drops the pages wholly inside [offset, offset + length) from this
+    // process. Written pages are queued for writeback first; their contents
+    // stay in the file and are read back from it if touched again.
+    void Release(uint64_t offset, uint64_t length) {
+        const uint64_t page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+        const uint64_t begin = (offset + page - 1) / page * page;
+        const uint64_t end = std::min(offset + length, size_) / page * page;
+        if (!data_ || end <= begin) {
+            return;
+        }
+        if (writable_) {
+            sync_file_range(fd_, static_cast<off_t>(begin), static_cast<off_t>(end - begin), SYNC_FILE_RANGE_WRITE);
+        }
+        madvise(data_ + begin, end - begin, MADV_DONTNEED);
+    }
+
+    // Writes every dirty page back and waits for it.
+    bool Flush() { return !data_ || msync(data_, size_, MS_SYNC) == 0; }
+
+private:
+    MappedFile(const std::string& path, bool writable) : path_(path), writable_(writable) {}
+
+    bool Map() {
+        // mmap() rejects empty mappings; an empty file has nothing to map.
+        if (size_ == 0) {
+            return true;
+        }
+        void* data = mmap(nullptr, size_, writable_ ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd_, 0);
+        if (data == MAP_FAILED) {
+            std::cerr << "Failed to map " << path_ << ": " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        data_ = static_cast<uint8_t*>(data);
+        return true;
+    }
+
+    const std::string path_;
+    const bool writable_;
+    int fd_ = -1;
+    uint64_t size_ = 0;
+    uint8_t* data_ = nullptr;
+};
@@ -0,0 +1 @@
+#include "message_batcher.h"
\ No newline at end of file
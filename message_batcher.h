@@ -0,0 +1,167 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <span>
+
+#include <api/data_channel_interface.h>
+#include <api/ref_count.h>
+#include <api/scoped_refptr.h>
+#include <api/task_queue/task_queue_base.h>
+#include <api/units/time_delta.h>
+#include <rtc_base/copy_on_write_buffer.h>
+
+#include "data_channel_message_handler.h"
+
+// Frame layout shared by MessageBatcher and MessageUnbatcher: a sequence of
+// [4-byte big-endian length][payload] records in one binary message.
+constexpr size_t kBatchLengthPrefixBytes = 4;
+
+struct BatchOptions {
+    // A frame is sent as soon as it reaches this many bytes...
+    size_t max_frame_bytes = 16 * 1024;
+    // ...or this long after its first message was queued.
+    webrtc::TimeDelta flush_delay = webrtc::TimeDelta::Millis(1);
+};
+
+// Coalesces small messages into length-prefixed frames so a burst of tiny
+// sends costs one SCTP message, one DTLS record and one thread hop instead of
+// one of each per message.
+//
+// Send() may be called from any thread. Frames are sent on |network_thread|,
+// where the data channel proxy calls straight through; they are posted under
+// the lock, so frames go out in the order their messages were queued.
+class MessageBatcher : public webrtc::RefCountInterface {
+public:
+    static webrtc::scoped_refptr<MessageBatcher> Create(
+        webrtc::scoped_refptr<webrtc::DataChannelInterface> channel,
+        webrtc::TaskQueueBase* network_thread,
+        BatchOptions options = {}) {
+        return webrtc::make_ref_counted<MessageBatcher>(channel, network_thread, options);
+    }
+
+    void Send(std::span<const uint8_t> message) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // Messages that do not fit next to the pending ones start a new frame.
+        if (pending_.size() > 0 &&
+            pending_.size() + kBatchLengthPrefixBytes + message.size() > options_.max_frame_bytes) {
+            PostFrameLocked();
+        }
+
+        const uint32_t length = static_cast<uint32_t>(message.size());
+        const uint8_t prefix[kBatchLengthPrefixBytes] = {
+            static_cast<uint8_t>(length >> 24), static_cast<uint8_t>(length >> 16),
+            static_cast<uint8_t>(length >> 8), static_cast<uint8_t>(length)};
+        const bool first_in_frame = pending_.size() == 0;
+        pending_.AppendData(prefix, sizeof(prefix));
+        pending_.AppendData(message.data(), message.size());
+        messages_queued_.fetch_add(1, std::memory_order_relaxed);
+
+        if (pending_.size() >= options_.max_frame_bytes) {
+            PostFrameLocked();
+        } else if (first_in_frame) {
+            ArmFlushTimerLocked();
+        }
+    }
+
+    // Sends whatever is pending without waiting for the timer.
+    void Flush() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (pending_.size() > 0) {
+            PostFrameLocked();
+        }
+    }
+
+    uint64_t messages_queued() const { return messages_queued_.load(std::memory_order_relaxed); }
+    uint64_t frames_sent() const { return frames_sent_.load(std::memory_order_relaxed); }
+    uint64_t send_failures() const { return send_failures_.load(std::memory_order_relaxed); }
+
+protected:
+    MessageBatcher(webrtc::scoped_refptr<webrtc::DataChannelInterface> channel,
+                   webrtc::TaskQueueBase* network_thread,
+                   BatchOptions options)
+        : channel_(channel), network_thread_(network_thread), options_(options) {
+        pending_.EnsureCapacity(options_.max_frame_bytes);
+    }
+    ~MessageBatcher() override = default;
+
+private:
+    void PostFrameLocked() {
+        webrtc::CopyOnWriteBuffer frame = std::move(pending_);
+        pending_.EnsureCapacity(options_.max_frame_bytes);
+        // Invalidates the timer armed for the frame just taken.
+        ++frame_generation_;
+
+        webrtc::scoped_refptr<MessageBatcher> self(this);
+        network_thread_->PostTask([self, frame = std::move(frame)] { self->SendFrame(frame); });
+    }
+
+    void ArmFlushTimerLocked() {
+        webrtc::scoped_refptr<MessageBatcher> self(this);
+        network_thread_->PostDelayedHighPrecisionTask(
+            [self, generation = frame_generation_] {
+                std::lock_guard<std::mutex> lock(self->mutex_);
+                if (self->frame_generation_ == generation && self->pending_.size() > 0) {
+                    self->PostFrameLocked();
+                }
+            },
+            options_.flush_delay);
+    }
+
+    // Runs on the network thread.
+    void SendFrame(const webrtc::CopyOnWriteBuffer& frame) {
+        if (channel_->state() != webrtc::DataChannelInterface::kOpen ||
+            !channel_->Send(webrtc::DataBuffer(frame, true))) {
+            send_failures_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        frames_sent_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    webrtc::scoped_refptr<webrtc::DataChannelInterface> channel_;
+    webrtc::TaskQueueBase* network_thread_;
+    const BatchOptions options_;
+
+    std::mutex mutex_;
+    webrtc::CopyOnWriteBuffer pending_;
+    uint64_t frame_generation_ = 0;
+
+    std::atomic<uint64_t> messages_queued_{0};
+    std::atomic<uint64_t> frames_sent_{0};
+    std::atomic<uint64_t> send_failures_{0};
+};
+
+// Splits frames produced by MessageBatcher and hands each message to |inner|
+// as a span into the received frame, so unpacking copies nothing. The
+// |buffer| passed along is the whole frame.
+class MessageUnbatcher : public DataChannelMessageHandler {
+public:
+    explicit MessageUnbatcher(DataChannelMessageHandler* inner) : inner_(inner) {}
+
+    void OnMessage(std::span<const uint8_t> frame, bool binary, const webrtc::CopyOnWriteBuffer& buffer) override {
+        size_t offset = 0;
+        while (offset < frame.size()) {
+            if (frame.size() - offset < kBatchLengthPrefixBytes) {
+                malformed_frames_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            const uint8_t* prefix = frame.data() + offset;
+            const size_t length = (static_cast<size_t>(prefix[0]) << 24) | (static_cast<size_t>(prefix[1]) << 16) |
+                                  (static_cast<size_t>(prefix[2]) << 8) | static_cast<size_t>(prefix[3]);
+            offset += kBatchLengthPrefixBytes;
+            if (length > frame.size() - offset) {
+                malformed_frames_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            inner_->OnMessage(frame.subspan(offset, length), binary, buffer);
+            offset += length;
+        }
+    }
+
+    uint64_t malformed_frames() const { return malformed_frames_.load(std::memory_order_relaxed); }
+
+private:
+    DataChannelMessageHandler* inner_;
+    std::atomic<uint64_t> malformed_frames_{0};
+};
@@ -0,0 +1 @@
+#include "network_emulation.h"
\ No newline at end of file
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <api/peer_connection_interface.h>
+#include <api/task_queue/default_task_queue_factory.h>
+#include <api/test/create_network_emulation_manager.h>
+#include <api/test/network_emulation_manager.h>
+#include <api/test/simulated_network.h>
+#include <api/units/data_rate.h>
+#include <api/units/time_delta.h>
+
+#include "factory_pool.h"
+
+// One direction of an emulated link.
+struct LinkProfile {
+    std::string name;
+    webrtc::TimeDelta delay = webrtc::TimeDelta::Zero();
+    webrtc::TimeDelta jitter = webrtc::TimeDelta::Zero();
+    int loss_percent = 0;
+    // Infinity() for an uncapped link.
+    webrtc::DataRate capacity = webrtc::DataRate::Infinity();
+
+    webrtc::BuiltInNetworkBehaviorConfig ToConfig() const {
+        webrtc::BuiltInNetworkBehaviorConfig config;
+        config.queue_delay_ms = static_cast<int>(delay.ms());
+        config.delay_standard_deviation_ms = static_cast<int>(jitter.ms());
+        config.loss_percent = loss_percent;
+        config.link_capacity = capacity;
+        config.allow_reordering = false;
+        return config;
+    }
+};
+
+inline std::vector<LinkProfile> DefaultLinkProfiles() {
+    return {
+        {"lan", webrtc::TimeDelta::Millis(1), webrtc::TimeDelta::Zero(), 0, webrtc::DataRate::Infinity()},
+        {"broadband", webrtc::TimeDelta::Millis(20), webrtc::TimeDelta::Millis(2), 0,
+         webrtc::DataRate::KilobitsPerSec(50000)},
+        {"mobile", webrtc::TimeDelta::Millis(60), webrtc::TimeDelta::Millis(10), 1,
+         webrtc::DataRate::KilobitsPerSec(5000)},
+        {"lossy", webrtc::TimeDelta::Millis(40), webrtc::TimeDelta::Millis(5), 5,
+         webrtc::DataRate::KilobitsPerSec(10000)},
+        {"satellite", webrtc::TimeDelta::Millis(300), webrtc::TimeDelta::Millis(20), 1,
+         webrtc::DataRate::KilobitsPerSec(20000)},
+    };
+}
+
+// Two factory shards joined by an emulated link instead of the host network.
+// Each peer gets an emulated endpoint, and every packet between them passes
+// through a SimulatedNetwork node per direction that applies the profile's
+// delay, jitter, loss and capacity. Nothing touches a real socket, so a run
+// works offline, and the loss pattern is the same from run to run (seeded).
+//
+// The per-direction SimulatedNetworkInterface handles are kept so scenarios
+// can change the link while connections are up, e.g. to flap it.
+class EmulatedNetwork {
+public:
+    static std::unique_ptr<EmulatedNetwork> Create(const LinkProfile& profile) {
+        std::unique_ptr<EmulatedNetwork> network(new EmulatedNetwork());
+        network->manager_ = webrtc::CreateNetworkEmulationManager();
+        webrtc::NetworkEmulationManager* manager = network->manager_.get();
+
+        webrtc::NetworkEmulationManager::SimulatedNetworkNode forward =
+            manager->NodeBuilder().config(profile.ToConfig()).Build();
+        webrtc::NetworkEmulationManager::SimulatedNetworkNode reverse =
+            manager->NodeBuilder().config(profile.ToConfig()).Build();
+        network->forward_ = forward.simulation;
+        network->reverse_ = reverse.simulation;
+
+        webrtc::EmulatedEndpoint* endpoint1 = manager->CreateEndpoint(webrtc::EmulatedEndpointConfig());
+        webrtc::EmulatedEndpoint* endpoint2 = manager->CreateEndpoint(webrtc::EmulatedEndpointConfig());
+        manager->CreateRoute(endpoint1, {forward.node}, endpoint2);
+        manager->CreateRoute(endpoint2, {reverse.node}, endpoint1);
+
+        network->shard1_ = CreateShard(0, manager->CreateEmulatedNetworkManagerInterface({endpoint1}));
+        network->shard2_ = CreateShard(1, manager->CreateEmulatedNetworkManagerInterface({endpoint2}));
+        if (!network->shard1_ || !network->shard2_) {
+            return nullptr;
+        }
+        return network;
+    }
+
+    ~EmulatedNetwork() {
+        // The factories run on the emulation's network threads.
+        shard1_ = nullptr;
+        shard2_ = nullptr;
+    }
+
+    FactoryShard* shard1() const { return shard1_.get(); }
+    FactoryShard* shard2() const { return shard2_.get(); }
+
+    // Peer 1 -> peer 2 and peer 2 -> peer 1.
+    webrtc::SimulatedNetworkInterface* forward() const { return forward_; }
+    webrtc::SimulatedNetworkInterface* reverse() const { return reverse_; }
+
+    // Applies |profile| to both directions; takes effect for packets sent
+    // from now on.
+    void SetProfile(const LinkProfile& profile) {
+        forward_->SetConfig(profile.ToConfig());
+        reverse_->SetConfig(profile.ToConfig());
+    }
+
+private:
+    EmulatedNetwork() = default;
+
+    // A data-only factory (no media engine) on the emulated network.
+    static std::unique_ptr<FactoryShard> CreateShard(int index, webrtc::EmulatedNetworkManagerInterface* network) {
+        return FactoryShard::CreateOnNetworkThread(
+            index, network->network_thread(),
+            [network](webrtc::Thread* network_thread, webrtc::Thread* worker_thread, webrtc::Thread* signaling_thread) {
+                webrtc::PeerConnectionFactoryDependencies deps;
+                deps.network_thread = network_thread;
+                deps.worker_thread = worker_thread;
+                deps.signaling_thread = signaling_thread;
+                deps.socket_factory = network->socket_factory();
+                deps.network_manager = network->ReleaseNetworkManager();
+                deps.task_queue_factory = webrtc::CreateDefaultTaskQueueFactory();
+                return webrtc::CreateModularPeerConnectionFactory(std::move(deps));
+            });
+    }
+
+    std::unique_ptr<webrtc::NetworkEmulationManager> manager_;
+    webrtc::SimulatedNetworkInterface* forward_ = nullptr;
+    webrtc::SimulatedNetworkInterface* reverse_ = nullptr;
+    std::unique_ptr<FactoryShard> shard1_;
+    std::unique_ptr<FactoryShard> shard2_;
+};
@@ -0,0 +1 @@
+#include "paced_sender.h"
\ No newline at end of file
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#include <api/data_channel_interface.h>
+#include <api/scoped_refptr.h>
+#include <api/task_queue/task_queue_base.h>
+#include <api/units/time_delta.h>
+#include <rtc_base/copy_on_write_buffer.h>
+#include <rtc_base/thread.h>
+#include <rtc_base/time_utils.h>
+
+#include "data_channel_observer.h"
+#include "latency_recording_handler.h"
+
+// Sends timestamped messages at a fixed rate from the channel opener's
+// network thread. Ticks that find buffered_amount() at |high_watermark| skip
+// the messages they owe instead of queueing more, so a reliable channel on
+// a slow link shows up as a lower send rate rather than unbounded latency.
+//
+// Each tick posts the next one as a delayed task, which no flush of the
+// network thread drains. Stop() before destroying the sender: pending ticks
+// then only read the shared stop flag.
+class PacedSender {
+public:
+    PacedSender(size_t message_size, int rate, uint64_t high_watermark)
+        : message_(message_size, message_size), rate_(rate), high_watermark_(high_watermark) {
+        std::memset(message_.MutableData(), 0x5A, message_size);
+    }
+
+    void Attach(DataChannelObserver* observer) {
+        observer->SetOpenHandler([this, observer] { Start(observer->data_channel()); });
+    }
+
+    // Starts sending on a channel that is already open, e.g. one another
+    // sender drives too. Call on the channel's network thread.
+    void Start(webrtc::scoped_refptr<webrtc::DataChannelInterface> channel) {
+        channel_ = channel;
+        start_us_ = webrtc::TimeMicros();
+        network_thread_ = webrtc::Thread::Current();
+        Tick();
+    }
+
+    // Returns once no tick is running; any still pending will not touch the
+    // sender. Call from any thread but the network thread.
+    void Stop() {
+        *stopped_ = true;
+        if (webrtc::Thread* network_thread = network_thread_.load()) {
+            network_thread->BlockingCall([] {});
+        }
+    }
+
+    uint64_t messages_sent() const { return sent_.load(std::memory_order_relaxed); }
+    uint64_t messages_skipped() const { return skipped_.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr webrtc::TimeDelta kTick = webrtc::TimeDelta::Millis(1);
+
+    // Runs on the network thread.
+    void Tick() {
+        if (*stopped_ || channel_->state() != webrtc::DataChannelInterface::kOpen) {
+            return;
+        }
+        const uint64_t due = static_cast<uint64_t>((webrtc::TimeMicros() - start_us_) * rate_ / 1000000);
+        while (owed_ < due) {
+            if (channel_->buffered_amount() >= high_watermark_) {
+                skipped_.fetch_add(due - owed_, std::memory_order_relaxed);
+                owed_ = due;
+                break;
+            }
+            // Each message needs its own timestamp, so it gets its own buffer.
+            webrtc::CopyOnWriteBuffer message(message_.cdata(), message_.size());
+            const int64_t now_us = webrtc::TimeMicros();
+            std::memcpy(message.MutableData(), &now_us, kTimestampBytes);
+            if (channel_->Send(webrtc::DataBuffer(message, true))) {
+                sent_.fetch_add(1, std::memory_order_relaxed);
+            }
+            ++owed_;
+        }
+        webrtc::TaskQueueBase::Current()->PostDelayedHighPrecisionTask(
+            [this, stopped = stopped_] {
+                if (!*stopped) {
+                    Tick();
+                }
+            },
+            kTick);
+    }
+
+    webrtc::CopyOnWriteBuffer message_;
+    const int rate_;
+    const uint64_t high_watermark_;
+    webrtc::scoped_refptr<webrtc::DataChannelInterface> channel_;
+    int64_t start_us_ = 0;
+    // Network thread only.
+    uint64_t owed_ = 0;
+    // Set before the first tick, so a Stop() that misses it is seen there.
+    std::atomic<webrtc::Thread*> network_thread_{nullptr};
+    // Shared with pending ticks, which may run after the sender is gone.
+    const std::shared_ptr<std::atomic<bool>> stopped_ = std::make_shared<std::atomic<bool>>(false);
+    std::atomic<uint64_t> sent_{0};
+    std::atomic<uint64_t> skipped_{0};
+};
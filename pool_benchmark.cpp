@@ -0,0 +1 @@
+#include "pool_benchmark.h"
\ No newline at end of file
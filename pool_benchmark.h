@@ -0,0 +1,154 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <string>
+#include <thread>
+
+#include <api/data_channel_interface.h>
+#include <api/peer_connection_interface.h>
+#include <api/units/time_delta.h>
+#include <rtc_base/copy_on_write_buffer.h>
+#include <rtc_base/event.h>
+#include <rtc_base/time_utils.h>
+
+#include "async_log.h"
+#include "connection_pool.h"
+#include "data_channel_message_handler.h"
+#include "factory_pool.h"
+#include "latency_stats.h"
+#include "loopback_pair.h"
+
+// Records when a session's first message arrives.
+class FirstMessageProbe : public DataChannelMessageHandler {
+public:
+    void OnMessage(std::span<const uint8_t>, bool, const webrtc::CopyOnWriteBuffer&) override {
+        int64_t expected = 0;
+        if (arrived_us_.compare_exchange_strong(expected, webrtc::TimeMicros())) {
+            arrived_.Set();
+        }
+    }
+
+    void Reset() {
+        arrived_us_ = 0;
+        arrived_.Reset();
+    }
+
+    // webrtc::TimeMicros() of the first message, or 0 on timeout.
+    int64_t Wait(webrtc::TimeDelta timeout) { return arrived_.Wait(timeout) ? arrived_us_.load() : 0; }
+
+private:
+    std::atomic<int64_t> arrived_us_{0};
+    webrtc::Event arrived_;
+};
+
+struct PoolOptions {
+    int sessions = 50;
+    int pool_size = 4;
+    // Gap between sessions; shorter than a handshake drains the pool.
+    webrtc::TimeDelta interval = webrtc::TimeDelta::Millis(100);
+    webrtc::TimeDelta warm_timeout = webrtc::TimeDelta::Seconds(30);
+    webrtc::TimeDelta message_timeout = webrtc::TimeDelta::Seconds(5);
+};
+
+// Starts sessions one after another and measures time to first message:
+// from the start of a session until the peer receives its first message.
+// Cold sessions connect a new pair each time; pooled ones check a warm pair
+// out of a ConnectionPool and return it afterwards.
+class PoolBenchmark {
+public:
+    PoolBenchmark(PeerConnectionFactoryPool* factories,
+                  webrtc::PeerConnectionInterface::RTCConfiguration config,
+                  PoolOptions options)
+        : factories_(factories), config_(config), options_(options) {
+        config_.servers.clear();
+    }
+
+    int Run() {
+        std::cout << "Pool mode: " << options_.sessions << " sessions, " << options_.interval.ms()
+                  << " ms apart, pool of " << options_.pool_size << std::endl;
+        std::cout << std::setw(10) << "sessions" << std::setw(10) << "p50 ms" << std::setw(10) << "p99 ms"
+                  << std::setw(10) << "max ms" << std::setw(10) << "failures" << std::setw(10) << "hit %"
+                  << std::endl;
+
+        const bool cold_ok = RunOne(false);
+        const bool pooled_ok = RunOne(true);
+        return cold_ok && pooled_ok ? 0 : -1;
+    }
+
+private:
+    bool RunOne(bool pooled) {
+        // Declared before the pool so no pair's observer outlives it.
+        FirstMessageProbe probe;
+        LatencyStats time_to_first_message;
+        int failures = 0;
+
+        // Per-peer logging is kept to warnings while pairs are set up and running.
+        ScopedLogLevel quiet(LogLevel::kWarning);
+
+        ConnectionPool::Options pool_options;
+        pool_options.size = options_.pool_size;
+        std::unique_ptr<ConnectionPool> pool;
+        if (pooled) {
+            pool = ConnectionPool::Create(factories_, config_, pool_options);
+            if (!pool->WaitWarm(options_.warm_timeout)) {
+                std::cerr << "Connection pool did not fill within " << options_.warm_timeout.ms() << " ms"
+                          << std::endl;
+                return false;
+            }
+        }
+
+        for (int i = 0; i < options_.sessions; ++i) {
+            const int64_t start_us = webrtc::TimeMicros();
+            std::unique_ptr<LoopbackPair> pair;
+            if (pool) {
+                pair = pool->Checkout();
+            } else {
+                auto result = ConnectionPool::Connect(factories_, config_, pool_options);
+                if (result.ok()) {
+                    pair = result.MoveValue();
+                }
+            }
+            if (!pair) {
+                ++failures;
+                continue;
+            }
+
+            probe.Reset();
+            pair->observer2()->GetDataObserver()->SetMessageHandler(&probe);
+            pair->data_channel()->Send(webrtc::DataBuffer("session " + std::to_string(i)));
+            const int64_t arrived_us = probe.Wait(options_.message_timeout);
+            if (arrived_us) {
+                time_to_first_message.Add((arrived_us - start_us) / 1000.0);
+            } else {
+                ++failures;
+            }
+
+            if (pool) {
+                pool->Return(std::move(pair));
+            }
+            pair = nullptr;
+            std::this_thread::sleep_for(std::chrono::microseconds(options_.interval.us()));
+        }
+
+        const uint64_t checkouts = pool ? pool->hits() + pool->misses() : 0;
+        std::cout << std::fixed << std::setw(10) << (pooled ? "pooled" : "cold") << std::setprecision(2)
+                  << std::setw(10) << time_to_first_message.Percentile(50) << std::setw(10)
+                  << time_to_first_message.Percentile(99) << std::setw(10) << time_to_first_message.Max()
+                  << std::setw(10) << failures << std::setprecision(1) << std::setw(10)
+                  << (checkouts ? 100.0 * pool->hits() / checkouts : 0.0) << std::defaultfloat << std::endl;
+        if (pool) {
+            pool->PrintStats(std::cout);
+        }
+        return failures == 0;
+    }
+
+    PeerConnectionFactoryPool* factories_;
+    webrtc::PeerConnectionInterface::RTCConfiguration config_;
+    PoolOptions options_;
+};
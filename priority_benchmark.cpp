@@ -0,0 +1 @@
+#include "priority_benchmark.h"
\ No newline at end of file
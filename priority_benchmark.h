@@ -0,0 +1,194 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <api/data_channel_interface.h>
+#include <api/peer_connection_interface.h>
+#include <api/priority.h>
+#include <api/units/time_delta.h>
+#include <rtc_base/copy_on_write_buffer.h>
+
+#include "async_log.h"
+#include "benchmark_pair.h"
+#include "bulk_transfer.h"
+#include "data_channel_message_handler.h"
+#include "factory_pool.h"
+#include "latency_recording_handler.h"
+#include "loopback_pair.h"
+#include "paced_sender.h"
+#include "task.h"
+
+// Splits one channel carrying both streams: messages of |control_size| bytes
+// go to |control|, everything else to |bulk|.
+class SizeDemuxHandler : public DataChannelMessageHandler {
+public:
+    SizeDemuxHandler(size_t control_size, DataChannelMessageHandler* control, DataChannelMessageHandler* bulk)
+        : control_size_(control_size), control_(control), bulk_(bulk) {}
+
+    void OnMessage(std::span<const uint8_t> payload, bool binary, const webrtc::CopyOnWriteBuffer& buffer) override {
+        (payload.size() == control_size_ ? control_ : bulk_)->OnMessage(payload, binary, buffer);
+    }
+
+private:
+    const size_t control_size_;
+    DataChannelMessageHandler* control_;
+    DataChannelMessageHandler* bulk_;
+};
+
+// How control and bulk traffic share the connection.
+struct PriorityVariant {
+    std::string name;
+    // Control messages go out on the bulk channel instead of their own.
+    bool shared = false;
+    webrtc::Priority control_priority = webrtc::Priority::kLow;
+    webrtc::Priority bulk_priority = webrtc::Priority::kLow;
+};
+
+inline std::vector<PriorityVariant> DefaultPriorityVariants() {
+    return {
+        {"shared", true, webrtc::Priority::kLow, webrtc::Priority::kLow},
+        {"separate", false, webrtc::Priority::kLow, webrtc::Priority::kLow},
+        {"priority", false, webrtc::Priority::kHigh, webrtc::Priority::kVeryLow},
+    };
+}
+
+struct PriorityOptions {
+    std::vector<PriorityVariant> variants = DefaultPriorityVariants();
+    int bulk_message_size = 65536;
+    int control_message_size = 64;
+    // Control messages per second.
+    int control_rate = 200;
+    webrtc::TimeDelta warmup = webrtc::TimeDelta::Millis(500);
+    webrtc::TimeDelta duration = webrtc::TimeDelta::Seconds(3);
+    uint64_t high_watermark = 4 * 1024 * 1024;
+    uint64_t low_watermark = 1024 * 1024;
+    // Above |high_watermark| so control messages on a shared channel are
+    // queued behind the bulk backlog rather than skipped.
+    uint64_t control_high_watermark = 8 * 1024 * 1024;
+};
+
+// Runs a paced control stream next to a saturating bulk stream on one
+// connection and reports control latency and bulk goodput. Both channels are
+// pre-negotiated (fixed stream ids, no DCEP round trip); the variants compare
+// control on the bulk channel, on its own channel, and on its own channel
+// with a higher SCTP stream priority than bulk.
+class PriorityBenchmark {
+public:
+    // Stream ids of the two negotiated channels.
+    static constexpr int kBulkChannelId = 0;
+    static constexpr int kControlChannelId = 1;
+
+    PriorityBenchmark(PeerConnectionFactoryPool* pool,
+                      webrtc::PeerConnectionInterface::RTCConfiguration config,
+                      PriorityOptions options)
+        : pool_(pool), config_(config), options_(options) {
+        config_.servers.clear();
+        options_.control_message_size = std::max<int>(options_.control_message_size, kTimestampBytes);
+        // The shared variant tells the streams apart by size.
+        options_.bulk_message_size = std::max(options_.bulk_message_size, options_.control_message_size + 1);
+    }
+
+    int Run() {
+        std::cout << "Priority mode: " << options_.control_message_size << " byte control messages at "
+                  << options_.control_rate << " msgs/s next to " << options_.bulk_message_size
+                  << " byte bulk messages, " << options_.duration.ms() << " ms per variant" << std::endl;
+        std::cout << std::setw(10) << "variant" << std::setw(10) << "p50 ms" << std::setw(10) << "p99 ms"
+                  << std::setw(10) << "max ms" << std::setw(10) << "ctrl/s" << std::setw(12) << "bulk MB/s"
+                  << std::endl;
+
+        int result = 0;
+        for (const PriorityVariant& variant : options_.variants) {
+            if (!RunOne(variant)) {
+                result = -1;
+            }
+        }
+        return result;
+    }
+
+private:
+    bool RunOne(const PriorityVariant& variant) {
+        webrtc::DataChannelInit bulk_config;
+        bulk_config.ordered = true;
+        bulk_config.negotiated = true;
+        bulk_config.id = kBulkChannelId;
+        bulk_config.priority = webrtc::PriorityValue(variant.bulk_priority);
+
+        BulkSender bulk(options_.bulk_message_size, options_.high_watermark, options_.low_watermark);
+        PacedSender control(options_.control_message_size, options_.control_rate, options_.control_high_watermark);
+        BulkReceiver bulk_receiver;
+        LatencyRecordingHandler recorder;
+        SizeDemuxHandler demux(options_.control_message_size, &recorder, &bulk_receiver);
+
+        ScopedLogLevel quiet(LogLevel::kWarning);
+        std::unique_ptr<BenchmarkPair> fixture =
+            BenchmarkPair::Create(pool_->Acquire(), pool_->Acquire(), config_, "Priority", bulk_config, "bulk");
+        if (!fixture) {
+            return false;
+        }
+        LoopbackPair* pair = fixture->pair();
+
+        DataChannelObserver* bulk_observer = pair->observer1()->GetDataObserver();
+        bulk.Attach(bulk_observer);
+        if (variant.shared) {
+            // Both streams start together on the one channel.
+            bulk_observer->SetOpenHandler([&bulk, &control, bulk_observer] {
+                bulk.Start(bulk_observer->data_channel());
+                control.Start(bulk_observer->data_channel());
+            });
+            pair->observer2()->GetDataObserver()->SetMessageHandler(&demux);
+        } else {
+            webrtc::DataChannelInit control_config;
+            control_config.ordered = true;
+            control_config.id = kControlChannelId;
+            control_config.priority = webrtc::PriorityValue(variant.control_priority);
+            webrtc::RTCError error = pair->AddNegotiatedChannel("control", control_config);
+            if (!error.ok()) {
+                std::cerr << "Failed to add control channel: " << error.message() << std::endl;
+                return false;
+            }
+            control.Attach(pair->observer1()->GetDataObserver("control"));
+            bulk_receiver.Attach(pair->observer2()->GetDataObserver());
+            pair->observer2()->GetDataObserver("control")->SetMessageHandler(&recorder);
+        }
+
+        if (!fixture->Connect()) {
+            return false;
+        }
+
+        std::this_thread::sleep_for(std::chrono::microseconds(options_.warmup.us()));
+        const uint64_t control_start = recorder.messages();
+        const uint64_t bytes_start = bulk_receiver.bytes();
+        recorder.StartMeasuring();
+        const auto window_start = std::chrono::steady_clock::now();
+        std::this_thread::sleep_for(std::chrono::microseconds(options_.duration.us()));
+        recorder.StopMeasuring();
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - window_start).count();
+        const uint64_t control_messages = recorder.messages() - control_start;
+        const uint64_t bytes = bulk_receiver.bytes() - bytes_start;
+
+        bulk.Stop();
+        control.Stop();
+        fixture->Close();
+
+        LatencyStats& latency = recorder.latency();
+        std::cout << std::fixed << std::setw(10) << variant.name << std::setprecision(2) << std::setw(10)
+                  << latency.Percentile(50) << std::setw(10) << latency.Percentile(99) << std::setw(10)
+                  << latency.Max() << std::setprecision(0) << std::setw(10) << control_messages / seconds
+                  << std::setprecision(1) << std::setw(12) << bytes / seconds / 1e6 << std::defaultfloat
+                  << std::endl;
+        return control_messages > 0 && bytes > 0;
+    }
+
+    PeerConnectionFactoryPool* pool_;
+    webrtc::PeerConnectionInterface::RTCConfiguration config_;
+    PriorityOptions options_;
+};
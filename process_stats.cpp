@@ -0,0 +1 @@
+#include "process_stats.h"
\ No newline at end of file
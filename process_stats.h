@@ -0,0 +1,90 @@
+#pragma once
+
+#include <dirent.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Linux /proc and getrusage readers used by the benchmark modes.
+class ProcessStats {
+public:
+    struct ThreadCpu {
+        int tid = 0;
+        std::string name;
+        double cpu_seconds = 0;
+    };
+
+    static int64_t ResidentSetBytes() {
+        std::ifstream statm("/proc/self/statm");
+        int64_t total_pages = 0;
+        int64_t resident_pages = 0;
+        statm >> total_pages >> resident_pages;
+        return resident_pages * sysconf(_SC_PAGESIZE);
+    }
+
+    static int64_t PeakResidentSetBytes() {
+        struct rusage usage {};
+        getrusage(RUSAGE_SELF, &usage);
+        return static_cast<int64_t>(usage.ru_maxrss) * 1024;
+    }
+
+    // User + system CPU time of the whole process.
+    static double CpuSeconds() {
+        struct rusage usage {};
+        getrusage(RUSAGE_SELF, &usage);
+        return ToSeconds(usage.ru_utime) + ToSeconds(usage.ru_stime);
+    }
+
+    // User + system CPU time of every thread, labelled with its OS thread
+    // name (webrtc::Thread::SetName sets it before Start()).
+    static std::vector<ThreadCpu> ThreadCpuTimes() {
+        std::vector<ThreadCpu> threads;
+        DIR* dir = opendir("/proc/self/task");
+        if (!dir) {
+            return threads;
+        }
+        const double ticks_per_second = static_cast<double>(sysconf(_SC_CLK_TCK));
+        while (dirent* entry = readdir(dir)) {
+            if (entry->d_name[0] == '.') {
+                continue;
+            }
+            const std::string task = std::string("/proc/self/task/") + entry->d_name;
+
+            ThreadCpu thread;
+            thread.tid = std::atoi(entry->d_name);
+            std::ifstream comm(task + "/comm");
+            std::getline(comm, thread.name);
+
+            // utime and stime are fields 14 and 15; skip past the "(comm)"
+            // field first since thread names may contain spaces.
+            std::ifstream stat_file(task + "/stat");
+            std::string stat((std::istreambuf_iterator<char>(stat_file)), std::istreambuf_iterator<char>());
+            const size_t comm_end = stat.rfind(')');
+            if (comm_end == std::string::npos) {
+                continue;
+            }
+            std::istringstream fields(stat.substr(comm_end + 2));
+            std::string skip;
+            for (int field = 3; field < 14; ++field) {
+                fields >> skip;
+            }
+            uint64_t utime = 0;
+            uint64_t stime = 0;
+            fields >> utime >> stime;
+            thread.cpu_seconds = (utime + stime) / ticks_per_second;
+            threads.push_back(thread);
+        }
+        closedir(dir);
+        return threads;
+    }
+
+private:
+    static double ToSeconds(const timeval& tv) { return tv.tv_sec + tv.tv_usec / 1e6; }
+};
@@ -0,0 +1 @@
+#include "receive_benchmark.h"
\ No newline at end of file
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include <api/data_channel_interface.h>
+#include <api/peer_connection_interface.h>
+#include <api/units/time_delta.h>
+#include <rtc_base/copy_on_write_buffer.h>
+
+#include "allocation_counter.h"
+#include "async_log.h"
+#include "benchmark_pair.h"
+#include "bulk_transfer.h"
+#include "data_channel_message_handler.h"
+#include "factory_pool.h"
+#include "loopback_pair.h"
+#include "task.h"
+
+// The receive path as it used to be: the payload is copied into a
+// std::string and formatted into a stream.
+class CopyingMessageHandler : public DataChannelMessageHandler {
+public:
+    void OnMessage(std::span<const uint8_t> payload, bool, const webrtc::CopyOnWriteBuffer&) override {
+        std::string message(reinterpret_cast<const char*>(payload.data()), payload.size());
+        sink_ << "Received: " << message << '\n';
+    }
+
+private:
+    // Accepts and drops every character, so the formatting runs in full but
+    // nothing is written anywhere. (A stream without a streambuf would be
+    // in a failed state and skip the formatting altogether.)
+    class DiscardingBuffer : public std::streambuf {
+    protected:
+        int_type overflow(int_type c) override { return traits_type::not_eof(c); }
+        std::streamsize xsputn(const char_type*, std::streamsize count) override { return count; }
+    };
+
+    DiscardingBuffer discard_;
+    std::ostream sink_{&discard_};
+};
+
+// Consumes the payload in place.
+class SpanMessageHandler : public DataChannelMessageHandler {
+public:
+    void OnMessage(std::span<const uint8_t> payload, bool, const webrtc::CopyOnWriteBuffer&) override {
+        for (uint8_t byte : payload) {
+            checksum_ += byte;
+        }
+    }
+
+    uint64_t checksum() const { return checksum_; }
+
+private:
+    uint64_t checksum_ = 0;
+};
+
+// Wraps a handler and counts heap allocations on the receiving network
+// thread: inside the handler, and across the whole delivery path between
+// consecutive messages.
+class AllocationMeasuringHandler : public DataChannelMessageHandler {
+public:
+    explicit AllocationMeasuringHandler(DataChannelMessageHandler* inner) : inner_(inner) {}
+
+    void OnMessage(std::span<const uint8_t> payload, bool binary, const webrtc::CopyOnWriteBuffer& buffer) override {
+        const uint64_t before = AllocationCounter::ThisThread();
+        if (measuring_.load(std::memory_order_relaxed) && last_return_ != 0) {
+            path_allocations_.fetch_add(before - last_return_, std::memory_order_relaxed);
+        }
+        inner_->OnMessage(payload, binary, buffer);
+        const uint64_t after = AllocationCounter::ThisThread();
+        if (measuring_.load(std::memory_order_relaxed)) {
+            handler_allocations_.fetch_add(after - before, std::memory_order_relaxed);
+            messages_.fetch_add(1, std::memory_order_relaxed);
+        }
+        last_return_ = after;
+    }
+
+    void StartMeasuring() { measuring_ = true; }
+    void StopMeasuring() { measuring_ = false; }
+
+    uint64_t messages() const { return messages_.load(std::memory_order_relaxed); }
+    uint64_t handler_allocations() const { return handler_allocations_.load(std::memory_order_relaxed); }
+    uint64_t path_allocations() const { return path_allocations_.load(std::memory_order_relaxed); }
+
+private:
+    DataChannelMessageHandler* inner_;
+    std::atomic<bool> measuring_{false};
+    // Only touched on the network thread.
+    uint64_t last_return_ = 0;
+    std::atomic<uint64_t> messages_{0};
+    std::atomic<uint64_t> handler_allocations_{0};
+    std::atomic<uint64_t> path_allocations_{0};
+};
+
+struct ReceiveOptions {
+    int message_size = 1024;
+    webrtc::TimeDelta warmup = webrtc::TimeDelta::Millis(500);
+    webrtc::TimeDelta duration = webrtc::TimeDelta::Seconds(3);
+    uint64_t high_watermark = 4 * 1024 * 1024;
+    uint64_t low_watermark = 1024 * 1024;
+};
+
+// Compares the copying receive path against the span-based one under a bulk
+// sender: message rate and heap allocations per message.
+class ReceiveBenchmark {
+public:
+    // Builds its own two-shard pool from |pool_options|, so the sender and
+    // the receiver get a network thread each and the path allocations
+    // counted on the receiver's do not include the sender's.
+    ReceiveBenchmark(PeerConnectionFactoryPool::Options pool_options,
+                     webrtc::PeerConnectionInterface::RTCConfiguration config,
+                     ReceiveOptions options)
+        : pool_options_(pool_options), config_(config), options_(options) {
+        config_.servers.clear();
+        pool_options_.shards = 2;
+        pool_options_.placement = ShardPlacement::kRoundRobin;
+    }
+
+    int Run() {
+        pool_ = PeerConnectionFactoryPool::Create(pool_options_);
+        if (!pool_) {
+            return -1;
+        }
+
+        std::cout << "Receive mode: " << options_.message_size << " byte messages, " << options_.duration.ms()
+                  << " ms per handler" << std::endl;
+        if (!AllocationCounter::kEnabled) {
+            std::cout << "(allocation counts need a build with -DWEBRTC_EXAMPLE_ALLOCATION_COUNTER=ON)" << std::endl;
+        }
+        std::cout << std::setw(10) << "handler" << std::setw(12) << "msgs/s" << std::setw(16) << "handler allocs"
+                  << std::setw(14) << "path allocs" << std::endl;
+
+        CopyingMessageHandler copying;
+        SpanMessageHandler span;
+        const bool copy_ok = RunOne("copy", &copying);
+        const bool span_ok = RunOne("span", &span);
+        pool_ = nullptr;
+        return copy_ok && span_ok ? 0 : -1;
+    }
+
+private:
+    bool RunOne(const char* name, DataChannelMessageHandler* handler) {
+        webrtc::DataChannelInit dc_config;
+        dc_config.ordered = true;
+
+        BulkSender sender(options_.message_size, options_.high_watermark, options_.low_watermark);
+        AllocationMeasuringHandler measuring(handler);
+
+        FactoryShard::Lease sender_lease = pool_->Acquire();
+        FactoryShard::Lease receiver_lease = pool_->Acquire();
+        if (sender_lease.shard() == receiver_lease.shard()) {
+            std::cerr << "Receive mode needs the sender and the receiver on different shards" << std::endl;
+            return false;
+        }
+
+        ScopedLogLevel quiet(LogLevel::kWarning);
+        std::unique_ptr<BenchmarkPair> fixture = BenchmarkPair::Create(
+            std::move(sender_lease), std::move(receiver_lease), config_, "Receive", dc_config, "receive");
+        if (!fixture) {
+            return false;
+        }
+        LoopbackPair* pair = fixture->pair();
+        sender.Attach(pair->observer1()->GetDataObserver());
+        pair->observer2()->GetDataObserver()->SetMessageHandler(&measuring);
+
+        if (!fixture->Connect()) {
+            return false;
+        }
+
+        std::this_thread::sleep_for(std::chrono::microseconds(options_.warmup.us()));
+        measuring.StartMeasuring();
+        const auto window_start = std::chrono::steady_clock::now();
+        std::this_thread::sleep_for(std::chrono::microseconds(options_.duration.us()));
+        measuring.StopMeasuring();
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - window_start).count();
+
+        sender.Stop();
+        fixture->Close();
+
+        const uint64_t messages = measuring.messages();
+        const double per_message = messages ? 1.0 / messages : 0.0;
+        std::cout << std::fixed << std::setw(10) << name << std::setw(12) << std::setprecision(0)
+                  << messages / seconds << std::setw(16) << std::setprecision(2)
+                  << measuring.handler_allocations() * per_message << std::setw(14)
+                  << measuring.path_allocations() * per_message << std::defaultfloat << std::endl;
+        return messages > 0;
+    }
+
+    PeerConnectionFactoryPool::Options pool_options_;
+    webrtc::PeerConnectionInterface::RTCConfiguration config_;
+    ReceiveOptions options_;
+    std::unique_ptr<PeerConnectionFactoryPool> pool_;
+};
@@ -0,0 +1 @@
+#include "reconnect_benchmark.h"
\ No newline at end of file
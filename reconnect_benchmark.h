@@ -0,0 +1,308 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <string>
+#include <thread>
+
+#include <api/data_channel_interface.h>
+#include <api/peer_connection_interface.h>
+#include <api/task_queue/task_queue_base.h>
+#include <api/units/time_delta.h>
+#include <rtc_base/thread.h>
+#include <rtc_base/time_utils.h>
+
+#include "async_log.h"
+#include "benchmark_pair.h"
+#include "data_channel_message_handler.h"
+#include "data_channel_observer.h"
+#include "latency_recording_handler.h"
+#include "latency_stats.h"
+#include "loopback_pair.h"
+#include "network_emulation.h"
+#include "reconnect_controller.h"
+#include "task.h"
+
+struct ReconnectBenchmarkOptions {
+    LinkProfile link = DefaultLinkProfiles()[1];
+    int flaps = 5;
+    // How long the link drops all packets each time. Must be longer than
+    // |receiving_timeout| for the drop to be noticed at all.
+    webrtc::TimeDelta outage = webrtc::TimeDelta::Seconds(3);
+    // Time on a working link before each flap.
+    webrtc::TimeDelta settle = webrtc::TimeDelta::Seconds(2);
+    // Longest wait for traffic to flow again after the link is back.
+    webrtc::TimeDelta recovery_timeout = webrtc::TimeDelta::Seconds(30);
+    int message_size = 256;
+    // Messages per second.
+    int rate = 200;
+    // Time without packets before ICE reports the connection disconnected;
+    // the same for both strategies.
+    webrtc::TimeDelta receiving_timeout = webrtc::TimeDelta::Seconds(1);
+    ReconnectOptions reconnect;
+};
+
+// Flaps an emulated link (every packet lost for |outage|) under a steady
+// stream of timestamped messages, and compares two ways back: an ICE restart
+// through a ReconnectController that keeps the pair and holds sends, and
+// closing the pair once the drop is noticed and connecting a new one.
+// Recovery is the time from the link coming back to the first message
+// delivered after it; lost messages are those sent but never delivered.
+class ReconnectBenchmark {
+public:
+    ReconnectBenchmark(webrtc::PeerConnectionInterface::RTCConfiguration config, ReconnectBenchmarkOptions options)
+        : config_(config), options_(options) {
+        // Emulated endpoints only have host candidates.
+        config_.servers.clear();
+        config_.ice_connection_receiving_timeout = static_cast<int>(options_.receiving_timeout.ms());
+        options_.message_size = std::max<int>(options_.message_size, kTimestampBytes);
+        options_.rate = std::max(options_.rate, 1);
+    }
+
+    int Run() {
+        std::cout << "Reconnect mode: " << options_.flaps << " flaps of " << options_.outage.ms() << " ms on "
+                  << options_.link.name << ", " << options_.message_size << " byte messages at " << options_.rate
+                  << "/s, disconnect after " << options_.receiving_timeout.ms() << " ms" << std::endl;
+        std::cout << std::setw(10) << "strategy" << std::setw(11) << "recovered" << std::setw(10) << "p50 ms"
+                  << std::setw(10) << "max ms" << std::setw(8) << "held" << std::setw(8) << "lost" << std::setw(10)
+                  << "attempts" << std::endl;
+
+        bool ok = RunOne(true);
+        ok = RunOne(false) && ok;
+        return ok ? 0 : -1;
+    }
+
+private:
+    // Sends timestamped messages through DataChannelObserver::Send(), where
+    // a ReconnectController can hold them, from the sending network thread.
+    class Sender {
+    public:
+        Sender(size_t message_size, int rate)
+            : message_size_(message_size), interval_(webrtc::TimeDelta::Micros(1000000 / rate)) {}
+
+        // Starts sending once the channel |observer| watches opens, and
+        // replaces whichever channel was sent on before.
+        void Attach(DataChannelObserver* observer) {
+            observer->SetOpenHandler([this, observer] {
+                observer_ = observer;
+                if (!ticking_) {
+                    ticking_ = true;
+                    network_thread_ = webrtc::Thread::Current();
+                    Tick();
+                }
+            });
+        }
+
+        // Call on the network thread before the attached channel goes away.
+        void Detach() { observer_ = nullptr; }
+
+        // Returns once no tick is running. The next tick is a delayed task,
+        // which closing the pair does not drain; it only reads the shared
+        // stop flag once this has returned.
+        void Stop() {
+            *stopped_ = true;
+            if (webrtc::Thread* network_thread = network_thread_.load()) {
+                network_thread->BlockingCall([] {});
+            }
+        }
+
+        uint64_t messages_sent() const { return sent_.load(std::memory_order_relaxed); }
+
+    private:
+        // Runs on the network thread.
+        void Tick() {
+            if (*stopped_) {
+                return;
+            }
+            if (observer_ && observer_->Send(message_size_, true, [this](uint8_t* out) {
+                    const int64_t now_us = webrtc::TimeMicros();
+                    std::memcpy(out, &now_us, kTimestampBytes);
+                    std::memset(out + kTimestampBytes, 0x5A, message_size_ - kTimestampBytes);
+                })) {
+                sent_.fetch_add(1, std::memory_order_relaxed);
+            }
+            webrtc::TaskQueueBase::Current()->PostDelayedHighPrecisionTask(
+                [this, stopped = stopped_] {
+                    if (!*stopped) {
+                        Tick();
+                    }
+                },
+                interval_);
+        }
+
+        const size_t message_size_;
+        const webrtc::TimeDelta interval_;
+        // Network thread only.
+        DataChannelObserver* observer_ = nullptr;
+        bool ticking_ = false;
+        // Set before the first tick, so a Stop() that misses it is seen there.
+        std::atomic<webrtc::Thread*> network_thread_{nullptr};
+        // Shared with pending ticks, which may run after the sender is gone.
+        const std::shared_ptr<std::atomic<bool>> stopped_ = std::make_shared<std::atomic<bool>>(false);
+        std::atomic<uint64_t> sent_{0};
+    };
+
+    // Counts deliveries and notes the first one at or after Arm()'s time.
+    class Receiver : public DataChannelMessageHandler {
+    public:
+        void OnMessage(std::span<const uint8_t>, bool, const webrtc::CopyOnWriteBuffer&) override {
+            messages_.fetch_add(1, std::memory_order_relaxed);
+            const int64_t now_us = webrtc::TimeMicros();
+            int64_t expected = 0;
+            if (now_us >= armed_us_.load(std::memory_order_relaxed)) {
+                first_us_.compare_exchange_strong(expected, now_us);
+            }
+        }
+
+        void Arm(int64_t since_us) {
+            armed_us_ = INT64_MAX;
+            first_us_ = 0;
+            armed_us_ = since_us;
+        }
+
+        // 0 until a message arrives after Arm().
+        int64_t first_us() const { return first_us_.load(); }
+        uint64_t messages() const { return messages_.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<int64_t> armed_us_{INT64_MAX};
+        std::atomic<int64_t> first_us_{0};
+        std::atomic<uint64_t> messages_{0};
+    };
+
+    // Runs every flap with one strategy and prints its row.
+    bool RunOne(bool restart) {
+        std::unique_ptr<EmulatedNetwork> network = EmulatedNetwork::Create(options_.link);
+        if (!network) {
+            std::cerr << "Failed to create emulated network for " << options_.link.name << std::endl;
+            return false;
+        }
+        LinkProfile down = options_.link;
+        down.name = "down";
+        down.loss_percent = 100;
+        webrtc::Thread* sender_thread = network->shard1()->network_thread();
+
+        Sender sender(options_.message_size, options_.rate);
+        Receiver receiver;
+        webrtc::scoped_refptr<ReconnectController> controller;
+        int attempts = 0;
+
+        ScopedLogLevel quiet(LogLevel::kWarning);
+        std::unique_ptr<BenchmarkPair> fixture;
+        LoopbackPair* pair = nullptr;
+
+        // Slow links and a rebuild started while the link is down need longer
+        // than the loopback defaults to connect.
+        HandshakeTimeouts timeouts;
+        timeouts.connection = options_.outage + options_.recovery_timeout;
+        auto create_pair = [&]() -> bool {
+            webrtc::DataChannelInit dc_config;
+            dc_config.ordered = true;
+            fixture = BenchmarkPair::Create(network->shard1()->Acquire(), network->shard2()->Acquire(), config_,
+                                            "Reconnect", dc_config, "reconnect");
+            if (!fixture) {
+                return false;
+            }
+            pair = fixture->pair();
+            sender.Attach(pair->observer1()->GetDataObserver());
+            pair->observer2()->GetDataObserver()->SetMessageHandler(&receiver);
+            return true;
+        };
+        auto close_pair = [&] {
+            if (controller) {
+                controller->Close();
+            }
+            sender_thread->BlockingCall([&sender] { sender.Detach(); });
+            fixture->Close();
+        };
+
+        if (!create_pair()) {
+            return false;
+        }
+        if (restart) {
+            ReconnectOptions reconnect = options_.reconnect;
+            reconnect.timeouts.timer = nullptr;
+            controller = ReconnectController::Create(pair->offerer(), pair->answerer(), reconnect);
+            controller->HoldSendsOn(pair->observer1()->GetDataObserver(), sender_thread);
+        }
+        if (!fixture->Connect(timeouts)) {
+            sender.Stop();
+            close_pair();
+            return false;
+        }
+
+        LatencyStats recovery;
+        for (int flap = 0; flap < options_.flaps; ++flap) {
+            std::this_thread::sleep_for(std::chrono::microseconds(options_.settle.us()));
+            network->SetProfile(down);
+            const auto up_at = std::chrono::steady_clock::now() + std::chrono::microseconds(options_.outage.us());
+
+            if (restart) {
+                std::this_thread::sleep_until(up_at);
+            } else {
+                // Rebuild as soon as the drop is noticed, as an application
+                // without a reconnect path would.
+                while (pair->observer1()->IsPeerConnected() && std::chrono::steady_clock::now() < up_at) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                }
+                if (!pair->observer1()->IsPeerConnected()) {
+                    ++attempts;
+                    close_pair();
+                    if (!create_pair()) {
+                        sender.Stop();
+                        return false;
+                    }
+                    StartDetached(pair->Connect(timeouts), [](webrtc::RTCError error) {
+                        if (!error.ok()) {
+                            ASYNC_LOG(kWarning, {}, "Rebuilt pair failed to connect", nullptr, error.message());
+                        }
+                    });
+                }
+                std::this_thread::sleep_until(up_at);
+            }
+
+            network->SetProfile(options_.link);
+            const int64_t up_us = webrtc::TimeMicros();
+            receiver.Arm(up_us);
+            const auto give_up = std::chrono::steady_clock::now() +
+                                 std::chrono::microseconds(options_.recovery_timeout.us());
+            while (receiver.first_us() == 0 && std::chrono::steady_clock::now() < give_up) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            if (receiver.first_us() != 0) {
+                recovery.Add((receiver.first_us() - up_us) / 1000.0);
+            }
+        }
+
+        // Let anything still queued or retransmitted arrive before counting
+        // what was lost.
+        sender.Stop();
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        const uint64_t sent = sender.messages_sent();
+        const uint64_t received = receiver.messages();
+        uint64_t held = 0;
+        if (controller) {
+            const ReconnectController::Counters counters = controller->counters();
+            held = counters.held_sends;
+            attempts = static_cast<int>(counters.restarts);
+        }
+        close_pair();
+
+        std::cout << std::fixed << std::setw(10) << (restart ? "restart" : "rebuild") << std::setw(6)
+                  << recovery.count() << "/" << std::setw(4) << options_.flaps << std::setprecision(1)
+                  << std::setw(10) << recovery.Percentile(50) << std::setw(10) << recovery.Max() << std::setw(8)
+                  << held << std::setw(8) << (sent > received ? sent - received : 0) << std::setw(10) << attempts
+                  << std::defaultfloat << std::endl;
+        return recovery.count() > 0;
+    }
+
+    webrtc::PeerConnectionInterface::RTCConfiguration config_;
+    ReconnectBenchmarkOptions options_;
+};
@@ -0,0 +1 @@
+#include "reconnect_controller.h"
\ No newline at end of file
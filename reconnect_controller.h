@@ -0,0 +1,258 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <api/peer_connection_interface.h>
+#include <api/ref_count.h>
+#include <api/rtc_error.h>
+#include <api/scoped_refptr.h>
+#include <api/task_queue/task_queue_base.h>
+#include <api/units/time_delta.h>
+#include <rtc_base/time_utils.h>
+
+#include "async_handshake.h"
+#include "async_log.h"
+#include "completion_signal.h"
+#include "data_channel_observer.h"
+#include "local_signaling.h"
+#include "simple_peer_connection_observer.h"
+#include "task.h"
+
+struct ReconnectOptions {
+    // How long each ICE restart gets to bring the connection back before the
+    // next one is started.
+    webrtc::TimeDelta retry_interval = webrtc::TimeDelta::Seconds(5);
+    // Per held channel; Send() fails once this much is queued.
+    size_t max_held_bytes = 4 * 1024 * 1024;
+    // SDP step limits for each restart. |timer| defaults to the offerer's
+    // signaling thread.
+    HandshakeTimeouts timeouts;
+};
+
+// Keeps a locally signaled pair connected across network drops without
+// rebuilding it. Once both peers have connected, a kDisconnected or kFailed
+// from either one starts holding sends on the registered channels and has
+// the offerer restart ICE (LocalSignaling::RestartIce()), again every
+// |retry_interval| until both peers are kConnected. Then the held sends go
+// out in order. The PeerConnections, the DTLS transport, the SCTP
+// association and every data channel survive, so the application above
+// sees a pause rather than a new session.
+//
+// Create it before Connect(); it takes over both observers' connection
+// state handlers. Close() it before closing the pair, then flush the
+// channels' network threads.
+class ReconnectController : public webrtc::RefCountInterface {
+public:
+    struct Counters {
+        uint64_t drops = 0;
+        // ICE restarts started; more than one per drop when the first ones
+        // ran while the network was still down.
+        uint64_t restarts = 0;
+        uint64_t recoveries = 0;
+        // Messages queued while down and sent on recovery.
+        uint64_t held_sends = 0;
+        // When the last recovery completed, and how long after the drop was
+        // noticed.
+        int64_t last_recovered_us = 0;
+        webrtc::TimeDelta last_outage = webrtc::TimeDelta::Zero();
+    };
+
+    static webrtc::scoped_refptr<ReconnectController> Create(PeerEndpoint offerer,
+                                                             PeerEndpoint answerer,
+                                                             ReconnectOptions options = {}) {
+        if (!options.timeouts.timer) {
+            options.timeouts.timer = offerer.signaling_thread;
+        }
+        auto controller = webrtc::make_ref_counted<ReconnectController>(offerer, answerer, options);
+        for (SimplePeerConnectionObserver* observer : {offerer.observer, answerer.observer}) {
+            observer->SetConnectionStateHandler(
+                [controller](webrtc::PeerConnectionInterface::PeerConnectionState state) {
+                    controller->OnConnectionChange(state);
+                });
+        }
+        return controller;
+    }
+
+    // Sends through |observer| (DataChannelObserver::Send()) are held while
+    // the connection is down. |network_thread| is the channel's.
+    void HoldSendsOn(DataChannelObserver* observer, webrtc::TaskQueueBase* network_thread) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        channels_.push_back({observer, network_thread});
+    }
+
+    // Stops restarting, releases held sends and drops the PeerConnections.
+    // A restart already running finishes its current SDP step first.
+    void Close() {
+        std::shared_ptr<CompletionSignal> recovered;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (closed_) {
+                return;
+            }
+            closed_ = true;
+            if (down_) {
+                down_ = false;
+                ReleaseChannels();
+            }
+            recovered = std::move(recovered_);
+            offerer_.pc = nullptr;
+            answerer_.pc = nullptr;
+        }
+        if (recovered) {
+            recovered->Resolve(webrtc::RTCError(webrtc::RTCErrorType::INVALID_STATE, "Reconnect controller closed"));
+        }
+    }
+
+    bool IsDown() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return down_;
+    }
+
+    Counters counters() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Counters counters = counters_;
+        counters.restarts = restarts_.load(std::memory_order_relaxed);
+        counters.held_sends = held_sends_->load(std::memory_order_relaxed);
+        return counters;
+    }
+
+protected:
+    ReconnectController(PeerEndpoint offerer, PeerEndpoint answerer, ReconnectOptions options)
+        : name_(offerer.observer->name()), offerer_(offerer), answerer_(answerer), options_(options) {}
+    ~ReconnectController() override = default;
+
+private:
+    struct HeldChannel {
+        DataChannelObserver* observer;
+        webrtc::TaskQueueBase* network_thread;
+    };
+
+    // Runs on either peer's signaling thread.
+    void OnConnectionChange(webrtc::PeerConnectionInterface::PeerConnectionState state) {
+        using State = webrtc::PeerConnectionInterface::PeerConnectionState;
+        std::shared_ptr<CompletionSignal> start;
+        std::shared_ptr<CompletionSignal> recovered;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (closed_) {
+                return;
+            }
+            if (state == State::kDisconnected || state == State::kFailed) {
+                // A failure before the first connect is Connect()'s to report.
+                if (!connected_once_ || down_) {
+                    return;
+                }
+                down_ = true;
+                down_since_us_ = webrtc::TimeMicros();
+                ++counters_.drops;
+                recovered_ = std::make_shared<CompletionSignal>();
+                start = recovered_;
+                for (const HeldChannel& channel : channels_) {
+                    channel.network_thread->PostTask(
+                        [observer = channel.observer, max = options_.max_held_bytes] { observer->HoldSends(max); });
+                }
+            } else if (state == State::kConnected) {
+                if (!offerer_.observer->IsPeerConnected() || !answerer_.observer->IsPeerConnected()) {
+                    return;
+                }
+                if (!down_) {
+                    connected_once_ = true;
+                    return;
+                }
+                down_ = false;
+                const int64_t now_us = webrtc::TimeMicros();
+                ++counters_.recoveries;
+                counters_.last_recovered_us = now_us;
+                counters_.last_outage = webrtc::TimeDelta::Micros(now_us - down_since_us_);
+                recovered = std::move(recovered_);
+                ReleaseChannels();
+            }
+        }
+        if (start) {
+            ASYNC_LOG(kWarning, name_, "Connection lost, restarting ICE");
+            // Posted rather than started here: this is a PeerConnection
+            // observer callback, and the restart calls into both peers.
+            webrtc::scoped_refptr<ReconnectController> self(this);
+            offerer_.signaling_thread->PostTask([self, start] {
+                StartDetached(self->Recover(start), [self](webrtc::RTCError error) {
+                    if (!error.ok()) {
+                        ASYNC_LOG(kWarning, self->name_, "Reconnect abandoned", nullptr, error.message());
+                    }
+                });
+            });
+        }
+        if (recovered) {
+            ASYNC_LOG(kInfo, name_, "Connection recovered");
+            recovered->Resolve(webrtc::RTCError::OK());
+        }
+    }
+
+    // Restarts ICE until |recovered| resolves, either because both peers
+    // are connected again or because the controller was closed.
+    Task<webrtc::RTCError> Recover(std::shared_ptr<CompletionSignal> recovered) {
+        while (true) {
+            PeerEndpoint offerer;
+            PeerEndpoint answerer;
+            bool closed;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                closed = closed_;
+                offerer = offerer_;
+                answerer = answerer_;
+            }
+            if (closed) {
+                break;
+            }
+            if (recovered->IsResolved()) {
+                co_return webrtc::RTCError::OK();
+            }
+            restarts_.fetch_add(1, std::memory_order_relaxed);
+            webrtc::RTCError error = co_await LocalSignaling::RestartIce(offerer, answerer, options_.timeouts);
+            if (!error.ok()) {
+                ASYNC_LOG(kWarning, name_, "ICE restart failed", nullptr, error.message());
+            }
+            // A failed restart may still be followed by ICE recovering on its
+            // own, so both wait the full interval before trying again.
+            error = co_await async_handshake::Signal("Reconnect", *recovered, options_.timeouts.timer,
+                                                     options_.retry_interval);
+            if (error.ok()) {
+                co_return error;
+            }
+        }
+        co_return webrtc::RTCError(webrtc::RTCErrorType::INVALID_STATE, "Reconnect controller closed");
+    }
+
+    // Called with |mutex_| held.
+    void ReleaseChannels() {
+        for (const HeldChannel& channel : channels_) {
+            channel.network_thread->PostTask([observer = channel.observer, held_sends = held_sends_] {
+                held_sends->fetch_add(observer->ReleaseSends(), std::memory_order_relaxed);
+            });
+        }
+    }
+
+    // The offerer's, kept for logging after the pair is gone.
+    const std::string name_;
+    PeerEndpoint offerer_;
+    PeerEndpoint answerer_;
+    const ReconnectOptions options_;
+
+    mutable std::mutex mutex_;
+    std::vector<HeldChannel> channels_;
+    bool closed_ = false;
+    bool connected_once_ = false;
+    bool down_ = false;
+    int64_t down_since_us_ = 0;
+    // Resolved when the current drop is over; null while connected.
+    std::shared_ptr<CompletionSignal> recovered_;
+    Counters counters_;
+    std::atomic<uint64_t> restarts_{0};
+    // Shared with release tasks that may run after Close().
+    std::shared_ptr<std::atomic<uint64_t>> held_sends_ = std::make_shared<std::atomic<uint64_t>>(0);
+};
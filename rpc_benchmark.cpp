@@ -0,0 +1 @@
+#include "rpc_benchmark.h"
\ No newline at end of file
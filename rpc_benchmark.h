@@ -0,0 +1,197 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <api/data_channel_interface.h>
+#include <api/peer_connection_interface.h>
+#include <api/units/time_delta.h>
+#include <rtc_base/event.h>
+#include <rtc_base/thread.h>
+#include <rtc_base/time_utils.h>
+
+#include "async_log.h"
+#include "benchmark_pair.h"
+#include "factory_pool.h"
+#include "latency_stats.h"
+#include "loopback_pair.h"
+#include "rpc_channel.h"
+#include "task.h"
+
+struct RpcBenchmarkOptions {
+    // Offered calls per second; one row each, on the same connection.
+    std::vector<int> rates = {1000, 5000, 20000, 50000, 100000};
+    int request_size = 64;
+    webrtc::TimeDelta deadline = webrtc::TimeDelta::Millis(100);
+    webrtc::TimeDelta warmup = webrtc::TimeDelta::Millis(500);
+    webrtc::TimeDelta duration = webrtc::TimeDelta::Seconds(2);
+    bool ordered = true;
+};
+
+// Drives an echo RpcServer through an RpcClient at fixed offered rates (an
+// open loop: calls are issued on schedule whether or not earlier ones have
+// completed) and reports call latency at p50/p99/p999, completed calls/s and
+// timeouts per rate. The highest rate at which every call completed within
+// its deadline is reported as the sustainable rate. Latency and deadlines
+// run from when each call was due, not when the loop got to issue it, so a
+// stall in the issuing loop shows up in the percentiles and timeouts instead
+// of hiding the calls it delayed.
+class RpcBenchmark {
+public:
+    RpcBenchmark(PeerConnectionFactoryPool* pool,
+                 webrtc::PeerConnectionInterface::RTCConfiguration config,
+                 RpcBenchmarkOptions options)
+        : pool_(pool), config_(config), options_(options) {
+        config_.servers.clear();
+    }
+
+    int Run() {
+        if (options_.rates.empty()) {
+            std::cerr << "No request rates given" << std::endl;
+            return -1;
+        }
+        std::cout << "RPC mode: " << options_.request_size << " byte echo calls, "
+                  << (options_.ordered ? "ordered" : "unordered") << ", deadline " << options_.deadline.ms()
+                  << " ms, " << options_.duration.ms() << " ms per rate" << std::endl;
+
+        webrtc::DataChannelInit dc_config;
+        dc_config.ordered = options_.ordered;
+
+        RpcServer server(RpcServer::Echo());
+        webrtc::Event opened;
+        std::unique_ptr<webrtc::Thread> completion_thread = webrtc::Thread::Create();
+        completion_thread->SetName("rpc-completion", nullptr);
+        completion_thread->Start();
+
+        ScopedLogLevel quiet(LogLevel::kWarning);
+        std::unique_ptr<BenchmarkPair> fixture =
+            BenchmarkPair::Create(pool_->Acquire(), pool_->Acquire(), config_, "RPC", dc_config, "rpc");
+        if (!fixture) {
+            return -1;
+        }
+        LoopbackPair* pair = fixture->pair();
+        webrtc::scoped_refptr<RpcClient> client =
+            RpcClient::Create(pair->data_channel(), fixture->network_thread1(), completion_thread.get());
+        pair->observer1()->GetDataObserver()->SetOpenHandler([&opened] { opened.Set(); });
+        pair->observer1()->GetDataObserver()->SetMessageHandler(client.get());
+        server.Attach(pair->observer2()->GetDataObserver());
+
+        if (!fixture->Connect(HandshakeTimeouts(), &opened)) {
+            client->Close();
+            fixture->Close();
+            completion_thread->Stop();
+            return -1;
+        }
+
+        const std::vector<uint8_t> request(options_.request_size, 0x5A);
+        RunRate(client.get(), completion_thread.get(), request, options_.rates.front(), options_.warmup);
+
+        std::cout << std::setw(10) << "offered" << std::setw(12) << "ops/s" << std::setw(10) << "p50 ms"
+                  << std::setw(10) << "p99 ms" << std::setw(10) << "p999 ms" << std::setw(10) << "max ms"
+                  << std::setw(10) << "timeouts" << std::setw(10) << "failed" << std::endl;
+        int sustainable = 0;
+        double sustainable_ops = 0;
+        bool ok = true;
+        for (int rate : options_.rates) {
+            Window window = RunRate(client.get(), completion_thread.get(), request, rate, options_.duration);
+            const double ops = window.succeeded / window.seconds;
+            std::cout << std::fixed << std::setw(10) << rate << std::setw(12) << std::setprecision(0) << ops
+                      << std::setprecision(3) << std::setw(10) << window.latency.Percentile(50) << std::setw(10)
+                      << window.latency.Percentile(99) << std::setw(10) << window.latency.Percentile(99.9)
+                      << std::setw(10) << window.latency.Max() << std::setw(10) << window.timed_out << std::setw(10)
+                      << window.failed << std::defaultfloat << std::endl;
+            ok = window.succeeded > 0 && ok;
+            if (window.timed_out == 0 && window.failed == 0 && window.succeeded == window.issued &&
+                window.issued >= 0.99 * rate * window.seconds) {
+                sustainable = rate;
+                sustainable_ops = ops;
+            }
+        }
+        if (sustainable > 0) {
+            std::cout << "Highest sustainable offered rate: " << sustainable << " calls/s (" << std::fixed
+                      << std::setprecision(0) << sustainable_ops << " completed/s)" << std::defaultfloat
+                      << std::endl;
+        } else {
+            std::cout << "No offered rate was sustained without timeouts" << std::endl;
+        }
+
+        // Calls failed by Close() and responses still queued on the pair's
+        // threads complete on the completion thread, so it stops last.
+        client->Close();
+        fixture->Close();
+        completion_thread->Stop();
+        return ok ? 0 : -1;
+    }
+
+private:
+    // Filled on the completion thread; read once it has been flushed.
+    struct Window {
+        LatencyStats latency;
+        uint64_t issued = 0;
+        uint64_t succeeded = 0;
+        uint64_t failed = 0;
+        uint64_t timed_out = 0;
+        double seconds = 0;
+    };
+
+    Window RunRate(RpcClient* client,
+                   webrtc::Thread* completion_thread,
+                   const std::vector<uint8_t>& request,
+                   int rate,
+                   webrtc::TimeDelta duration) {
+        // Shared with the callbacks, so a call still in flight after the
+        // drain below cannot write to a window that is gone.
+        auto shared = std::make_shared<Window>();
+        Window& window = *shared;
+        window.latency.Reserve(static_cast<size_t>(static_cast<double>(rate) * duration.seconds<double>()));
+        const uint64_t timed_out_before = client->counters().timed_out;
+        rate = std::max(rate, 1);
+        const auto start = std::chrono::steady_clock::now();
+        const int64_t window_start_us = webrtc::TimeMicros();
+        const auto end = start + std::chrono::microseconds(duration.us());
+        for (auto now = start; now < end; now = std::chrono::steady_clock::now()) {
+            const uint64_t due = static_cast<uint64_t>(std::chrono::duration<double>(now - start).count() * rate);
+            for (; window.issued < due; ++window.issued) {
+                const int64_t scheduled_us =
+                    window_start_us + static_cast<int64_t>(window.issued * 1000000 / static_cast<uint64_t>(rate));
+                // A call issued behind schedule has already spent part of
+                // its deadline.
+                const webrtc::TimeDelta lateness = webrtc::TimeDelta::Micros(webrtc::TimeMicros() - scheduled_us);
+                client->Call(request, options_.deadline - lateness,
+                             [shared, scheduled_us](webrtc::RTCErrorOr<webrtc::CopyOnWriteBuffer> response) {
+                                 if (response.ok()) {
+                                     shared->latency.Add((webrtc::TimeMicros() - scheduled_us) / 1000.0);
+                                     ++shared->succeeded;
+                                 } else {
+                                     ++shared->failed;
+                                 }
+                             });
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+        window.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        // Let every call issued in the window finish or time out, then flush
+        // the callbacks already queued.
+        const auto drain_end = std::chrono::steady_clock::now() + std::chrono::microseconds(options_.deadline.us()) +
+                               std::chrono::milliseconds(100);
+        while (client->in_flight() > 0 && std::chrono::steady_clock::now() < drain_end) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        Window result = completion_thread->BlockingCall([shared] { return *shared; });
+        result.timed_out = client->counters().timed_out - timed_out_before;
+        // Timeouts reach the callback as failures too.
+        result.failed -= std::min(result.failed, result.timed_out);
+        return result;
+    }
+
+    PeerConnectionFactoryPool* pool_;
+    webrtc::PeerConnectionInterface::RTCConfiguration config_;
+    RpcBenchmarkOptions options_;
+};
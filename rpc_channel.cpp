@@ -0,0 +1 @@
+#include "rpc_channel.h"
\ No newline at end of file
@@ -0,0 +1,337 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <api/data_channel_interface.h>
+#include <api/ref_count.h>
+#include <api/rtc_error.h>
+#include <api/scoped_refptr.h>
+#include <api/task_queue/task_queue_base.h>
+#include <api/units/time_delta.h>
+#include <rtc_base/copy_on_write_buffer.h>
+#include <rtc_base/time_utils.h>
+
+#include "data_channel_message_handler.h"
+#include "data_channel_observer.h"
+
+// Request/response framing over one binary data channel. Every message is
+//
+//   u8 type | u64 call id | body
+//
+// with the id big-endian. A kResponse or kError carries the id of the
+// request it answers; the body of a kError is its message text.
+namespace rpc_wire {
+
+enum class MessageType : uint8_t {
+    kRequest = 1,
+    kResponse = 2,
+    kError = 3,
+};
+
+constexpr size_t kHeaderBytes = 1 + 8;
+
+inline void PutHeader(uint8_t* out, MessageType type, uint64_t call_id) {
+    out[0] = static_cast<uint8_t>(type);
+    for (int i = 0; i < 8; ++i) {
+        out[1 + i] = static_cast<uint8_t>(call_id >> (56 - 8 * i));
+    }
+}
+
+inline uint64_t GetCallId(const uint8_t* header) {
+    uint64_t call_id = 0;
+    for (int i = 0; i < 8; ++i) {
+        call_id = call_id << 8 | header[1 + i];
+    }
+    return call_id;
+}
+
+// A message with room for |body_capacity| more bytes after the header.
+inline webrtc::CopyOnWriteBuffer Frame(MessageType type, uint64_t call_id, size_t body_capacity) {
+    webrtc::CopyOnWriteBuffer frame(kHeaderBytes, kHeaderBytes + body_capacity);
+    PutHeader(frame.MutableData(), type, call_id);
+    return frame;
+}
+
+}  // namespace rpc_wire
+
+struct RpcClientOptions {
+    // How often expired calls are looked for; a call fails at most this
+    // long after its deadline.
+    webrtc::TimeDelta deadline_resolution = webrtc::TimeDelta::Millis(1);
+};
+
+// The calling side of an RPC channel. Any number of calls may be in flight
+// on the channel; responses are matched to calls by id, so they may come
+// back in any order (and the channel may be unordered).
+//
+// Call() may be used from any thread. Requests are sent on
+// |network_thread|, where the data channel proxy calls straight through,
+// and responses and deadlines are handled there too, but callbacks run on
+// |completion_queue| so slow callbacks never hold up the channel. Make the
+// client the message handler of the channel's observer, and Close() it
+// before the channel goes away.
+class RpcClient : public webrtc::RefCountInterface, public DataChannelMessageHandler {
+public:
+    // Called once per call with the response body (a slice of the received
+    // message, not a copy) or the reason the call failed.
+    using Callback = std::function<void(webrtc::RTCErrorOr<webrtc::CopyOnWriteBuffer> response)>;
+
+    struct Counters {
+        uint64_t calls = 0;
+        uint64_t succeeded = 0;
+        // Send failures, server errors and calls cut short by Close().
+        uint64_t failed = 0;
+        uint64_t timed_out = 0;
+        // Responses to calls that had already timed out or failed.
+        uint64_t late_responses = 0;
+    };
+
+    static webrtc::scoped_refptr<RpcClient> Create(webrtc::scoped_refptr<webrtc::DataChannelInterface> channel,
+                                                   webrtc::TaskQueueBase* network_thread,
+                                                   webrtc::TaskQueueBase* completion_queue,
+                                                   RpcClientOptions options = {}) {
+        auto client = webrtc::make_ref_counted<RpcClient>(channel, network_thread, completion_queue, options);
+        client->network_thread_->PostTask([client] { client->SweepDeadlines(); });
+        return client;
+    }
+
+    // Sends |request| and calls |done| on the completion queue with the
+    // response, or with an error if the request could not be sent, the
+    // server answered with an error, or |deadline| passed first. Returns
+    // the call id.
+    uint64_t Call(std::span<const uint8_t> request, webrtc::TimeDelta deadline, Callback done) {
+        const uint64_t call_id = next_call_id_.fetch_add(1, std::memory_order_relaxed);
+        webrtc::CopyOnWriteBuffer frame = rpc_wire::Frame(rpc_wire::MessageType::kRequest, call_id, request.size());
+        frame.AppendData(request.data(), request.size());
+        calls_.fetch_add(1, std::memory_order_relaxed);
+        bool closed;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed = closed_;
+            if (!closed) {
+                pending_.emplace(call_id, std::move(done));
+                deadlines_.push({webrtc::TimeMicros() + deadline.us(), call_id});
+            }
+        }
+        if (closed) {
+            failed_.fetch_add(1, std::memory_order_relaxed);
+            Dispatch(std::move(done), webrtc::RTCError(webrtc::RTCErrorType::INVALID_STATE, "RPC client closed"));
+            return call_id;
+        }
+
+        webrtc::scoped_refptr<RpcClient> self(this);
+        network_thread_->PostTask([self, call_id, frame = std::move(frame)] {
+            if (self->channel_->state() != webrtc::DataChannelInterface::kOpen ||
+                !self->channel_->Send(webrtc::DataBuffer(frame, true))) {
+                self->Fail(call_id, webrtc::RTCError(webrtc::RTCErrorType::NETWORK_ERROR, "RPC request send failed"));
+            }
+        });
+        return call_id;
+    }
+
+    // Fails every call still in flight and stops the deadline timer.
+    // Responses that arrive afterwards are counted as late.
+    void Close() {
+        std::unordered_map<uint64_t, Callback> pending;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+            pending.swap(pending_);
+            deadlines_ = {};
+        }
+        for (auto& [call_id, done] : pending) {
+            failed_.fetch_add(1, std::memory_order_relaxed);
+            Dispatch(std::move(done), webrtc::RTCError(webrtc::RTCErrorType::INVALID_STATE, "RPC client closed"));
+        }
+    }
+
+    size_t in_flight() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return pending_.size();
+    }
+
+    Counters counters() const {
+        Counters counters;
+        counters.calls = calls_.load(std::memory_order_relaxed);
+        counters.succeeded = succeeded_.load(std::memory_order_relaxed);
+        counters.failed = failed_.load(std::memory_order_relaxed);
+        counters.timed_out = timed_out_.load(std::memory_order_relaxed);
+        counters.late_responses = late_responses_.load(std::memory_order_relaxed);
+        return counters;
+    }
+
+    // DataChannelMessageHandler implementation. Runs on the network thread.
+    void OnMessage(std::span<const uint8_t> payload, bool, const webrtc::CopyOnWriteBuffer& buffer) override {
+        if (payload.size() < rpc_wire::kHeaderBytes) {
+            return;
+        }
+        const auto type = static_cast<rpc_wire::MessageType>(payload[0]);
+        const uint64_t call_id = rpc_wire::GetCallId(payload.data());
+        std::span<const uint8_t> body = payload.subspan(rpc_wire::kHeaderBytes);
+        if (type == rpc_wire::MessageType::kResponse) {
+            Callback done = Take(call_id);
+            if (!done) {
+                late_responses_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            succeeded_.fetch_add(1, std::memory_order_relaxed);
+            Dispatch(std::move(done), buffer.Slice(body.data() - buffer.cdata(), body.size()));
+        } else if (type == rpc_wire::MessageType::kError) {
+            Fail(call_id, webrtc::RTCError(webrtc::RTCErrorType::INTERNAL_ERROR,
+                                           std::string(reinterpret_cast<const char*>(body.data()), body.size())));
+        }
+    }
+
+protected:
+    RpcClient(webrtc::scoped_refptr<webrtc::DataChannelInterface> channel,
+              webrtc::TaskQueueBase* network_thread,
+              webrtc::TaskQueueBase* completion_queue,
+              RpcClientOptions options)
+        : channel_(channel), network_thread_(network_thread), completion_queue_(completion_queue), options_(options) {}
+    ~RpcClient() override = default;
+
+private:
+    // Removes the call and returns its callback; empty if it already
+    // completed.
+    Callback Take(uint64_t call_id) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = pending_.find(call_id);
+        if (it == pending_.end()) {
+            return nullptr;
+        }
+        Callback done = std::move(it->second);
+        pending_.erase(it);
+        return done;
+    }
+
+    void Fail(uint64_t call_id, webrtc::RTCError error) {
+        if (Callback done = Take(call_id)) {
+            failed_.fetch_add(1, std::memory_order_relaxed);
+            Dispatch(std::move(done), std::move(error));
+        }
+    }
+
+    void Dispatch(Callback done, webrtc::RTCErrorOr<webrtc::CopyOnWriteBuffer> result) {
+        completion_queue_->PostTask(
+            [done = std::move(done), result = std::move(result)]() mutable { done(std::move(result)); });
+    }
+
+    // Runs on the network thread every |deadline_resolution| until Close().
+    void SweepDeadlines() {
+        std::vector<Callback> expired;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (closed_) {
+                return;
+            }
+            const int64_t now_us = webrtc::TimeMicros();
+            // Entries of calls that already completed are skipped here.
+            while (!deadlines_.empty() && deadlines_.top().first <= now_us) {
+                auto it = pending_.find(deadlines_.top().second);
+                deadlines_.pop();
+                if (it != pending_.end()) {
+                    expired.push_back(std::move(it->second));
+                    pending_.erase(it);
+                }
+            }
+        }
+        for (Callback& done : expired) {
+            timed_out_.fetch_add(1, std::memory_order_relaxed);
+            Dispatch(std::move(done), webrtc::RTCError(webrtc::RTCErrorType::INTERNAL_ERROR, "RPC call timed out"));
+        }
+        webrtc::scoped_refptr<RpcClient> self(this);
+        network_thread_->PostDelayedHighPrecisionTask([self] { self->SweepDeadlines(); },
+                                                      options_.deadline_resolution);
+    }
+
+    // Earliest deadline on top.
+    using Deadline = std::pair<int64_t, uint64_t>;
+
+    webrtc::scoped_refptr<webrtc::DataChannelInterface> channel_;
+    webrtc::TaskQueueBase* network_thread_;
+    webrtc::TaskQueueBase* completion_queue_;
+    const RpcClientOptions options_;
+
+    mutable std::mutex mutex_;
+    bool closed_ = false;
+    std::unordered_map<uint64_t, Callback> pending_;
+    std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline>> deadlines_;
+
+    std::atomic<uint64_t> next_call_id_{1};
+    std::atomic<uint64_t> calls_{0};
+    std::atomic<uint64_t> succeeded_{0};
+    std::atomic<uint64_t> failed_{0};
+    std::atomic<uint64_t> timed_out_{0};
+    std::atomic<uint64_t> late_responses_{0};
+};
+
+// The serving side of an RPC channel. Requests are handled on the network
+// thread in arrival order and answered straight from there.
+class RpcServer : public DataChannelMessageHandler {
+public:
+    // Appends the response body for |request| to |response|, which already
+    // holds the header. Runs on the network thread and must not block;
+    // return an error to answer with a kError instead.
+    using Handler = std::function<webrtc::RTCError(std::span<const uint8_t> request,
+                                                   webrtc::CopyOnWriteBuffer& response)>;
+
+    explicit RpcServer(Handler handler) : handler_(std::move(handler)) {}
+
+    // Answers every request with its own body.
+    static Handler Echo() {
+        return [](std::span<const uint8_t> request, webrtc::CopyOnWriteBuffer& response) {
+            response.AppendData(request.data(), request.size());
+            return webrtc::RTCError::OK();
+        };
+    }
+
+    // Serves requests arriving on the channel |observer| watches.
+    void Attach(DataChannelObserver* observer) {
+        observer_ = observer;
+        observer->SetMessageHandler(this);
+    }
+
+    uint64_t requests() const { return requests_.load(std::memory_order_relaxed); }
+    uint64_t send_failures() const { return send_failures_.load(std::memory_order_relaxed); }
+
+    void OnMessage(std::span<const uint8_t> payload, bool, const webrtc::CopyOnWriteBuffer&) override {
+        if (payload.size() < rpc_wire::kHeaderBytes ||
+            static_cast<rpc_wire::MessageType>(payload[0]) != rpc_wire::MessageType::kRequest) {
+            return;
+        }
+        requests_.fetch_add(1, std::memory_order_relaxed);
+        const uint64_t call_id = rpc_wire::GetCallId(payload.data());
+        std::span<const uint8_t> request = payload.subspan(rpc_wire::kHeaderBytes);
+
+        // Sized for an echo-like response so most handlers append in place.
+        webrtc::CopyOnWriteBuffer response =
+            rpc_wire::Frame(rpc_wire::MessageType::kResponse, call_id, request.size());
+        webrtc::RTCError error = handler_(request, response);
+        if (!error.ok()) {
+            const std::string_view message = error.message();
+            response = rpc_wire::Frame(rpc_wire::MessageType::kError, call_id, message.size());
+            response.AppendData(message.data(), message.size());
+        }
+        webrtc::scoped_refptr<webrtc::DataChannelInterface> channel = observer_->data_channel();
+        if (!channel || !channel->Send(webrtc::DataBuffer(response, true))) {
+            send_failures_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+private:
+    Handler handler_;
+    DataChannelObserver* observer_ = nullptr;
+    std::atomic<uint64_t> requests_{0};
+    std::atomic<uint64_t> send_failures_{0};
+};
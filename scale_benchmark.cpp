@@ -0,0 +1 @@
+#include "scale_benchmark.h"
\ No newline at end of file
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <api/peer_connection_interface.h>
+
+#include "async_log.h"
+#include "factory_pool.h"
+#include "handshake_limiter.h"
+#include "latency_stats.h"
+#include "local_signaling.h"
+#include "loopback_pair.h"
+#include "process_stats.h"
+#include "stats_collector.h"
+#include "task.h"
+
+struct ScaleOptions {
+    int pairs = 100;
+    // Handshakes allowed in flight at once.
+    int concurrency = 16;
+    // Keep the configured STUN server; off by default so gathering stays on
+    // host candidates and the run measures this process, not the network.
+    bool use_stun = false;
+    // Optional: track every connected pair for |hold| after setup, to see
+    // what periodic stats collection costs at this scale.
+    StatsCollector* stats = nullptr;
+    webrtc::TimeDelta hold = webrtc::TimeDelta::Zero();
+};
+
+// Creates ScaleOptions::pairs loopback pairs spread over the factory pool,
+// runs their handshakes concurrently and reports setup rate, setup latency
+// and memory per connection.
+class ScaleBenchmark {
+public:
+    ScaleBenchmark(PeerConnectionFactoryPool* pool,
+                   webrtc::PeerConnectionInterface::RTCConfiguration config,
+                   ScaleOptions options)
+        : pool_(pool), config_(config), options_(options) {
+        if (!options_.use_stun) {
+            config_.servers.clear();
+        }
+    }
+
+    int Run() {
+        HandshakeLimiter limiter(options_.concurrency, options_.pairs);
+        std::cout << "Scale mode: " << options_.pairs << " pairs, concurrency "
+                  << HandshakeLimiter::Clamp(options_.concurrency) << ", " << pool_->size() << " factory shard(s)"
+                  << std::endl;
+
+        HandshakeTimeouts timeouts;
+
+        webrtc::DataChannelInit dc_config;
+        dc_config.ordered = true;
+
+        std::vector<std::unique_ptr<LoopbackPair>> pairs;
+        pairs.reserve(options_.pairs);
+
+        const std::vector<ProcessStats::ThreadCpu> cpu_before = ProcessStats::ThreadCpuTimes();
+        const int64_t rss_before = ProcessStats::ResidentSetBytes();
+        const auto run_start = std::chrono::steady_clock::now();
+
+        // Per-peer logging would dominate the run, so keep it to warnings.
+        ScopedLogLevel quiet(LogLevel::kWarning);
+
+        for (int i = 0; i < options_.pairs; ++i) {
+            const HandshakeLimiter::Clock::time_point setup_start = limiter.Acquire();
+
+            auto pair_result = LoopbackPair::Create(
+                pool_->Acquire(), pool_->Acquire(), config_, "Pair" + std::to_string(i) + ".Peer", dc_config);
+            if (!pair_result.ok()) {
+                std::cerr << "Failed to create pair " << i << ": " << pair_result.error().message() << std::endl;
+                limiter.Release(setup_start, false);
+                continue;
+            }
+            pairs.push_back(pair_result.MoveValue());
+
+            StartDetached(pairs.back()->Connect(timeouts), [&limiter, setup_start](webrtc::RTCError error) {
+                limiter.Release(setup_start, error.ok());
+            });
+        }
+        limiter.WaitForAll();
+
+        const double wall_seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - run_start).count();
+        const int64_t rss_after = ProcessStats::ResidentSetBytes();
+        const std::vector<ProcessStats::ThreadCpu> cpu_after = ProcessStats::ThreadCpuTimes();
+
+        Report(limiter, wall_seconds, rss_after - rss_before, cpu_before, cpu_after);
+        pool_->PrintLoad(std::cout);
+
+        if (options_.stats && options_.hold > webrtc::TimeDelta::Zero()) {
+            HoldWithStats(pairs);
+        }
+
+        for (auto& pair : pairs) {
+            pair->Close();
+        }
+        return limiter.failed() == 0 ? 0 : -1;
+    }
+
+private:
+    void HoldWithStats(const std::vector<std::unique_ptr<LoopbackPair>>& pairs) {
+        for (const auto& pair : pairs) {
+            options_.stats->Track(pair->observer1()->name(), pair->offerer().pc);
+            options_.stats->Track(pair->observer2()->name(), pair->answerer().pc);
+        }
+        const std::vector<ProcessStats::ThreadCpu> cpu_before = ProcessStats::ThreadCpuTimes();
+        std::this_thread::sleep_for(std::chrono::microseconds(options_.hold.us()));
+        const std::vector<ProcessStats::ThreadCpu> cpu_after = ProcessStats::ThreadCpuTimes();
+
+        double stats_cpu = 0;
+        for (const auto& after : cpu_after) {
+            if (after.name != "stats") {
+                continue;
+            }
+            stats_cpu += after.cpu_seconds;
+            for (const auto& before : cpu_before) {
+                if (before.tid == after.tid) {
+                    stats_cpu -= before.cpu_seconds;
+                    break;
+                }
+            }
+        }
+        std::cout << std::fixed << std::setprecision(2) << "- Stats thread CPU over " << options_.hold.ms()
+                  << " ms hold: " << stats_cpu << " s (" << 100.0 * stats_cpu / (options_.hold.ms() / 1000.0)
+                  << "%)" << std::defaultfloat << std::endl;
+        options_.stats->PrintSummary(std::cout);
+
+        for (const auto& pair : pairs) {
+            options_.stats->Untrack(pair->observer1()->name());
+            options_.stats->Untrack(pair->observer2()->name());
+        }
+    }
+
+    void Report(HandshakeLimiter& limiter,
+                double wall_seconds,
+                int64_t rss_delta,
+                const std::vector<ProcessStats::ThreadCpu>& cpu_before,
+                const std::vector<ProcessStats::ThreadCpu>& cpu_after) {
+        LatencyStats& setup_ms = limiter.setup_ms();
+        const size_t connected = setup_ms.count();
+        std::cout << std::fixed << std::setprecision(2);
+        std::cout << "\nScale summary:" << std::endl;
+        std::cout << "- Pairs connected: " << connected << "/" << options_.pairs << " (" << limiter.failed()
+                  << " failed)" << std::endl;
+        std::cout << "- Wall time: " << wall_seconds << " s" << std::endl;
+        std::cout << "- Connections/s: " << connected / wall_seconds << " pairs/s" << std::endl;
+        std::cout << "- Setup time: p50 " << setup_ms.Percentile(50) << " ms, p99 " << setup_ms.Percentile(99)
+                  << " ms, max " << setup_ms.Max() << " ms" << std::endl;
+        if (connected > 0) {
+            std::cout << "- RSS per PeerConnection: " << rss_delta / 1024.0 / (2 * connected) << " KiB ("
+                      << rss_delta / (1024.0 * 1024.0) << " MiB total)" << std::endl;
+        }
+
+        // A thread near 100% of wall time is the bottleneck.
+        std::cout << "- Thread CPU during run:" << std::endl;
+        for (const auto& after : cpu_after) {
+            double before_seconds = 0;
+            for (const auto& before : cpu_before) {
+                if (before.tid == after.tid) {
+                    before_seconds = before.cpu_seconds;
+                    break;
+                }
+            }
+            const double used = after.cpu_seconds - before_seconds;
+            if (used > 0) {
+                std::cout << "    " << std::setw(16) << std::left << after.name << std::right << used << " s ("
+                          << 100.0 * used / wall_seconds << "% of wall)" << std::endl;
+            }
+        }
+        std::cout << std::defaultfloat;
+    }
+
+    PeerConnectionFactoryPool* pool_;
+    webrtc::PeerConnectionInterface::RTCConfiguration config_;
+    ScaleOptions options_;
+};
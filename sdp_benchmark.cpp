@@ -0,0 +1 @@
+#include "sdp_benchmark.h"
\ No newline at end of file
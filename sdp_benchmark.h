@@ -0,0 +1,131 @@
+#pragma once
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <api/data_channel_interface.h>
+#include <api/peer_connection_interface.h>
+
+#include "async_log.h"
+#include "factory_pool.h"
+#include "latency_stats.h"
+#include "local_signaling.h"
+#include "loopback_pair.h"
+#include "process_stats.h"
+#include "sdp_template_cache.h"
+#include "task.h"
+
+struct SdpBenchmarkOptions {
+    int pairs = 200;
+};
+
+// Runs the same number of loopback handshakes with each way of handing SDP
+// to the peers: serialize and re-parse (the old path), Clone(), and the
+// template cache. Reports CPU time of the signaling threads and of the whole
+// process per handshake. All variants share one DTLS certificate, so the
+// only difference is the SDP handling.
+class SdpBenchmark {
+public:
+    SdpBenchmark(PeerConnectionFactoryPool* pool,
+                 webrtc::PeerConnectionInterface::RTCConfiguration config,
+                 SdpBenchmarkOptions options)
+        : pool_(pool), config_(config), options_(options) {
+        config_.servers.clear();
+    }
+
+    int Run() {
+        std::unique_ptr<SdpTemplateCache> templates = SdpTemplateCache::Create();
+        if (!templates) {
+            std::cerr << "Failed to generate the SDP template certificate" << std::endl;
+            return -1;
+        }
+        templates->Apply(config_);
+
+        std::cout << "SDP mode: " << options_.pairs << " handshakes per variant" << std::endl;
+        std::cout << std::setw(10) << "sdp" << std::setw(14) << "signaling ms" << std::setw(12) << "process ms"
+                  << std::setw(10) << "p50 ms" << std::setw(10) << "failures" << std::endl;
+
+        SdpOptions reparse;
+        reparse.reparse = true;
+        SdpOptions clone;
+        SdpOptions cached;
+        cached.templates = templates.get();
+        cached.template_key = "sdp-benchmark";
+
+        const bool reparse_ok = RunOne("reparse", reparse);
+        const bool clone_ok = RunOne("clone", clone);
+        const bool cached_ok = RunOne("template", cached);
+        std::cout << "Template cache: " << templates->hits() << " hits, " << templates->misses() << " misses"
+                  << std::endl;
+        return reparse_ok && clone_ok && cached_ok ? 0 : -1;
+    }
+
+private:
+    bool RunOne(const char* name, const SdpOptions& sdp) {
+        webrtc::DataChannelInit dc_config;
+        dc_config.ordered = true;
+
+        std::vector<std::unique_ptr<LoopbackPair>> pairs;
+        pairs.reserve(options_.pairs);
+        LatencyStats handshake_ms;
+        int failures = 0;
+
+        // Per-peer logging is kept to warnings while the pairs are set up.
+        ScopedLogLevel quiet(LogLevel::kWarning);
+
+        const double signaling_before = SignalingCpuSeconds();
+        const double process_before = ProcessStats::CpuSeconds();
+
+        // One handshake at a time, so the signaling threads only do this.
+        for (int i = 0; i < options_.pairs; ++i) {
+            const auto start = std::chrono::steady_clock::now();
+            auto pair_result = LoopbackPair::Create(pool_->Acquire(), pool_->Acquire(), config_,
+                                                    "Sdp" + std::to_string(i) + ".Peer", dc_config);
+            if (!pair_result.ok()) {
+                ++failures;
+                continue;
+            }
+            pairs.push_back(pair_result.MoveValue());
+            if (!SyncWait(pairs.back()->Connect(HandshakeTimeouts(), sdp)).ok()) {
+                ++failures;
+                continue;
+            }
+            handshake_ms.Add(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+                                 .count());
+        }
+
+        const double signaling = SignalingCpuSeconds() - signaling_before;
+        const double process = ProcessStats::CpuSeconds() - process_before;
+
+        for (auto& pair : pairs) {
+            pair->Close();
+        }
+
+        const double per_pair = 1000.0 / options_.pairs;
+        std::cout << std::fixed << std::setprecision(3) << std::setw(10) << name << std::setw(14)
+                  << signaling * per_pair << std::setw(12) << process * per_pair << std::setprecision(2)
+                  << std::setw(10) << handshake_ms.Percentile(50) << std::setw(10) << failures << std::defaultfloat
+                  << std::endl;
+        return failures == 0;
+    }
+
+    // Summed over every shard's signaling thread. /proc reports clock ticks,
+    // so use enough pairs for the totals to be well above 10 ms.
+    static double SignalingCpuSeconds() {
+        double seconds = 0;
+        for (const ProcessStats::ThreadCpu& thread : ProcessStats::ThreadCpuTimes()) {
+            if (thread.name.starts_with("signaling")) {
+                seconds += thread.cpu_seconds;
+            }
+        }
+        return seconds;
+    }
+
+    PeerConnectionFactoryPool* pool_;
+    webrtc::PeerConnectionInterface::RTCConfiguration config_;
+    SdpBenchmarkOptions options_;
+};
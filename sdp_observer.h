@@ -1,62 +1,99 @@
 #pragma once
 
-#include <iostream>
+#include <atomic>
+#include <functional>
 #include <api/peer_connection_interface.h>
 
+#include "async_log.h"
+
 class CreateSDPObserver : public webrtc::CreateSessionDescriptionObserver {
 public:
+    using CompletionHandler =
+        std::function<void(webrtc::RTCErrorOr<std::unique_ptr<webrtc::SessionDescriptionInterface>>)>;
+
     static webrtc::scoped_refptr<CreateSDPObserver> Create() {
         return webrtc::make_ref_counted<CreateSDPObserver>();
     }
 
+    // The handler takes ownership of the created description instead of it
+    // being stored for TakeCreatedSDP().
+    static webrtc::scoped_refptr<CreateSDPObserver> Create(CompletionHandler on_complete) {
+        return webrtc::make_ref_counted<CreateSDPObserver>(std::move(on_complete));
+    }
+
     void OnSuccess(webrtc::SessionDescriptionInterface* desc) override {
-        std::cout << "SDP creation successful: " << desc->type() << std::endl;
-        created_sdp_.reset(desc);
+        ASYNC_LOG(kInfo, {}, "SDP creation successful", webrtc::SdpTypeToString(desc->GetType()));
+        std::unique_ptr<webrtc::SessionDescriptionInterface> created(desc);
+        if (on_complete_) {
+            success_ = true;
+            on_complete_(std::move(created));
+            return;
+        }
+        created_sdp_ = std::move(created);
         success_ = true;
     }
 
     void OnFailure(webrtc::RTCError error) override {
-        std::cout << "SDP creation failed: " << error.message() << std::endl;
+        ASYNC_LOG(kError, {}, "SDP creation failed", nullptr, error.message());
         success_ = false;
+        if (on_complete_) {
+            on_complete_(std::move(error));
+        }
     }
 
     std::unique_ptr<webrtc::SessionDescriptionInterface> TakeCreatedSDP() {
         return std::move(created_sdp_);
     }
 
-    bool IsSuccessful() const { return success_; }
+    bool IsSuccessful() const { return success_.load(); }
 
 protected:
     CreateSDPObserver() = default;
+    explicit CreateSDPObserver(CompletionHandler on_complete) : on_complete_(std::move(on_complete)) {}
     ~CreateSDPObserver() override = default;
 
 private:
+    CompletionHandler on_complete_;
     std::unique_ptr<webrtc::SessionDescriptionInterface> created_sdp_;
-    bool success_ = false;
+    std::atomic<bool> success_{false};
 };
 
 class SetSDPObserver : public webrtc::SetSessionDescriptionObserver {
 public:
+    using CompletionHandler = std::function<void(webrtc::RTCError)>;
+
     static webrtc::scoped_refptr<SetSDPObserver> Create() {
         return webrtc::make_ref_counted<SetSDPObserver>();
     }
 
+    static webrtc::scoped_refptr<SetSDPObserver> Create(CompletionHandler on_complete) {
+        return webrtc::make_ref_counted<SetSDPObserver>(std::move(on_complete));
+    }
+
     void OnSuccess() override {
-        std::cout << "SDP set successfully" << std::endl;
+        ASYNC_LOG(kInfo, {}, "SDP set successfully");
         success_ = true;
+        if (on_complete_) {
+            on_complete_(webrtc::RTCError::OK());
+        }
     }
 
     void OnFailure(webrtc::RTCError error) override {
-        std::cout << "SDP set failed: " << error.message() << std::endl;
+        ASYNC_LOG(kError, {}, "SDP set failed", nullptr, error.message());
         success_ = false;
+        if (on_complete_) {
+            on_complete_(std::move(error));
+        }
     }
 
-    bool IsSuccessful() const { return success_; }
+    bool IsSuccessful() const { return success_.load(); }
 
 protected:
     SetSDPObserver() = default;
+    explicit SetSDPObserver(CompletionHandler on_complete) : on_complete_(std::move(on_complete)) {}
     ~SetSDPObserver() override = default;
 
 private:
-    bool success_ = false;
+    CompletionHandler on_complete_;
+    std::atomic<bool> success_{false};
 };
@@ -0,0 +1 @@
+#include "sdp_template_cache.h"
\ No newline at end of file
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include <api/jsep.h>
+#include <api/peer_connection_interface.h>
+#include <api/scoped_refptr.h>
+#include <p2p/base/transport_description.h>
+#include <p2p/base/transport_info.h>
+#include <pc/session_description.h>
+#include <rtc_base/crypto_random.h>
+#include <rtc_base/rtc_certificate.h>
+#include <rtc_base/rtc_certificate_generator.h>
+#include <rtc_base/ssl_fingerprint.h>
+#include <rtc_base/ssl_identity.h>
+
+// Offer and answer templates for handshakes between identically configured
+// PeerConnections (same data channels, no media), keyed by a caller-chosen
+// configuration name. The first handshake for a key creates and stores its
+// offer and answer as usual. Later ones skip CreateOffer/CreateAnswer and
+// apply a copy of the template object with fresh ICE credentials, a new
+// session id and the cache certificate's DTLS fingerprint patched in; no SDP
+// text is generated or parsed.
+//
+// Every PeerConnection that uses the cache must be created with its
+// certificate (see Apply()) so the patched fingerprint matches. That shares
+// one DTLS key pair across all of them, which suits loopback and test
+// traffic but not connections to independent remote parties.
+class SdpTemplateCache {
+public:
+    static std::unique_ptr<SdpTemplateCache> Create() {
+        webrtc::scoped_refptr<webrtc::RTCCertificate> certificate =
+            webrtc::RTCCertificateGenerator::GenerateCertificate(webrtc::KeyParams::ECDSA(), std::nullopt);
+        if (!certificate) {
+            return nullptr;
+        }
+        std::unique_ptr<webrtc::SSLFingerprint> fingerprint =
+            webrtc::SSLFingerprint::CreateFromCertificate(*certificate);
+        if (!fingerprint) {
+            return nullptr;
+        }
+        return std::unique_ptr<SdpTemplateCache>(new SdpTemplateCache(certificate, std::move(fingerprint)));
+    }
+
+    // Makes PeerConnections created with |config| use the cache certificate.
+    void Apply(webrtc::PeerConnectionInterface::RTCConfiguration& config) const {
+        config.certificates = {certificate_};
+    }
+
+    // A patched copy of the |type| template for |key|, or nullptr if there is
+    // none yet.
+    std::unique_ptr<webrtc::SessionDescriptionInterface> Instantiate(const std::string& key, webrtc::SdpType type) {
+        std::unique_ptr<webrtc::SessionDescription> description;
+        std::string session_version;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = templates_.find({key, type});
+            if (it == templates_.end()) {
+                ++misses_;
+                return nullptr;
+            }
+            ++hits_;
+            description = it->second->description()->Clone();
+            session_version = it->second->session_version();
+        }
+
+        // All transports are bundled, so they share one set of credentials.
+        const std::string ufrag = webrtc::CreateRandomString(kIceUfragLength);
+        const std::string pwd = webrtc::CreateRandomString(kIcePwdLength);
+        for (webrtc::TransportInfo& info : description->transport_infos()) {
+            info.description.ice_ufrag = ufrag;
+            info.description.ice_pwd = pwd;
+            info.description.identity_fingerprint = std::make_unique<webrtc::SSLFingerprint>(*fingerprint_);
+        }
+        const std::string session_id = std::to_string(webrtc::CreateRandomId64() & INT64_MAX);
+        return webrtc::CreateSessionDescription(type, session_id, session_version, std::move(description));
+    }
+
+    // Keeps a copy of |description| as the template for |key| and its type,
+    // unless one is stored already.
+    void Store(const std::string& key, const webrtc::SessionDescriptionInterface& description) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::unique_ptr<webrtc::SessionDescriptionInterface>& stored = templates_[{key, description.GetType()}];
+        if (!stored) {
+            stored = description.Clone();
+        }
+    }
+
+    uint64_t hits() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return hits_;
+    }
+    uint64_t misses() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return misses_;
+    }
+
+private:
+    // The lengths WebRTC itself generates (RFC 8839 minimums are 4 and 22).
+    static constexpr size_t kIceUfragLength = 4;
+    static constexpr size_t kIcePwdLength = 24;
+
+    SdpTemplateCache(webrtc::scoped_refptr<webrtc::RTCCertificate> certificate,
+                     std::unique_ptr<webrtc::SSLFingerprint> fingerprint)
+        : certificate_(certificate), fingerprint_(std::move(fingerprint)) {}
+
+    const webrtc::scoped_refptr<webrtc::RTCCertificate> certificate_;
+    const std::unique_ptr<webrtc::SSLFingerprint> fingerprint_;
+
+    std::mutex mutex_;
+    std::map<std::pair<std::string, webrtc::SdpType>, std::unique_ptr<webrtc::SessionDescriptionInterface>> templates_;
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+};
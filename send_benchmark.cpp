@@ -0,0 +1 @@
+#include "send_benchmark.h"
\ No newline at end of file
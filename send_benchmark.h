@@ -0,0 +1,204 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <api/data_channel_interface.h>
+#include <api/peer_connection_interface.h>
+#include <api/scoped_refptr.h>
+#include <api/task_queue/task_queue_base.h>
+#include <api/units/time_delta.h>
+#include <rtc_base/time_utils.h>
+
+#include "allocation_counter.h"
+#include "async_log.h"
+#include "benchmark_pair.h"
+#include "bulk_transfer.h"
+#include "data_channel_observer.h"
+#include "factory_pool.h"
+#include "loopback_pair.h"
+#include "send_buffer_pool.h"
+#include "task.h"
+
+// BulkSender's flow control, but every message is serialized afresh through
+// DataChannelObserver::Send() the way an application would: an 8-byte
+// sequence number followed by filler. Heap allocations and time on the
+// sending network thread are counted around each Send() call, so they cover
+// buffer setup, serialization and WebRTC's synchronous send path.
+class SerializingSender {
+public:
+    SerializingSender(size_t message_size, uint64_t high_watermark, uint64_t low_watermark)
+        : message_size_(std::max<size_t>(message_size, sizeof(uint64_t))),
+          high_watermark_(high_watermark),
+          low_watermark_(low_watermark) {}
+
+    void Attach(DataChannelObserver* observer) {
+        observer_ = observer;
+        observer->SetOpenHandler([this] { Pump(); });
+        observer->SetBufferedAmountHandler([this](uint64_t) {
+            if (observer_->data_channel()->buffered_amount() <= low_watermark_) {
+                Pump();
+            }
+        });
+    }
+
+    void Stop() { stopped_ = true; }
+    void StartMeasuring() { measuring_ = true; }
+    void StopMeasuring() { measuring_ = false; }
+
+    uint64_t messages() const { return messages_.load(std::memory_order_relaxed); }
+    uint64_t allocations() const { return allocations_.load(std::memory_order_relaxed); }
+    uint64_t send_ns() const { return send_ns_.load(std::memory_order_relaxed); }
+    uint64_t send_failures() const { return send_failures_.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr int kMaxSendsPerPass = 256;
+
+    void Pump() {
+        webrtc::DataChannelInterface* channel = observer_->data_channel().get();
+        for (int i = 0; i < kMaxSendsPerPass; ++i) {
+            if (stopped_ || channel->state() != webrtc::DataChannelInterface::kOpen ||
+                channel->buffered_amount() >= high_watermark_) {
+                return;
+            }
+            const uint64_t sequence = sequence_++;
+            const uint64_t allocations_before = AllocationCounter::ThisThread();
+            const int64_t start_ns = webrtc::TimeNanos();
+            const bool sent = observer_->Send(message_size_, true, [this, sequence](uint8_t* out) {
+                std::memcpy(out, &sequence, sizeof(sequence));
+                std::memset(out + sizeof(sequence), 0xA5, message_size_ - sizeof(sequence));
+            });
+            const int64_t elapsed_ns = webrtc::TimeNanos() - start_ns;
+            const uint64_t allocations = AllocationCounter::ThisThread() - allocations_before;
+            if (!sent) {
+                send_failures_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            if (measuring_.load(std::memory_order_relaxed)) {
+                messages_.fetch_add(1, std::memory_order_relaxed);
+                allocations_.fetch_add(allocations, std::memory_order_relaxed);
+                send_ns_.fetch_add(elapsed_ns, std::memory_order_relaxed);
+            }
+        }
+        webrtc::TaskQueueBase::Current()->PostTask([this] { Pump(); });
+    }
+
+    const size_t message_size_;
+    const uint64_t high_watermark_;
+    const uint64_t low_watermark_;
+    DataChannelObserver* observer_ = nullptr;
+    // Only touched on the network thread.
+    uint64_t sequence_ = 0;
+    std::atomic<bool> stopped_{false};
+    std::atomic<bool> measuring_{false};
+    std::atomic<uint64_t> messages_{0};
+    std::atomic<uint64_t> allocations_{0};
+    std::atomic<uint64_t> send_ns_{0};
+    std::atomic<uint64_t> send_failures_{0};
+};
+
+struct SendOptions {
+    std::vector<int> message_sizes = {64, 1024, 16384};
+    webrtc::TimeDelta warmup = webrtc::TimeDelta::Millis(500);
+    webrtc::TimeDelta duration = webrtc::TimeDelta::Seconds(3);
+    uint64_t high_watermark = 4 * 1024 * 1024;
+    uint64_t low_watermark = 1024 * 1024;
+};
+
+// Compares sends that allocate a fresh buffer per message against sends from
+// a SendBufferPool, per message size: message rate, heap allocations and
+// nanoseconds per Send() on the sending network thread, and how often the
+// pool could hand its storage straight back.
+class SendBenchmark {
+public:
+    SendBenchmark(PeerConnectionFactoryPool* pool,
+                  webrtc::PeerConnectionInterface::RTCConfiguration config,
+                  SendOptions options)
+        : pool_(pool), config_(config), options_(options) {
+        config_.servers.clear();
+    }
+
+    int Run() {
+        std::cout << "Send mode: " << options_.duration.ms() << " ms per size and buffer source" << std::endl;
+        if (!AllocationCounter::kEnabled) {
+            std::cout << "(allocation counts need a build with -DWEBRTC_EXAMPLE_ALLOCATION_COUNTER=ON)" << std::endl;
+        }
+        std::cout << std::setw(10) << "size" << std::setw(8) << "buffer" << std::setw(12) << "msgs/s"
+                  << std::setw(14) << "allocs/msg" << std::setw(12) << "ns/msg" << std::setw(10) << "reused"
+                  << std::setw(10) << "cloned" << std::endl;
+
+        bool ok = true;
+        for (int size : options_.message_sizes) {
+            ok = RunOne(size, nullptr) && ok;
+            ok = RunOne(size, SendBufferPool::Create()) && ok;
+        }
+        return ok ? 0 : -1;
+    }
+
+private:
+    bool RunOne(int message_size, webrtc::scoped_refptr<SendBufferPool> buffers) {
+        webrtc::DataChannelInit dc_config;
+        dc_config.ordered = true;
+
+        SerializingSender sender(message_size, options_.high_watermark, options_.low_watermark);
+        BulkReceiver receiver;
+
+        ScopedLogLevel quiet(LogLevel::kWarning);
+        std::unique_ptr<BenchmarkPair> fixture =
+            BenchmarkPair::Create(pool_->Acquire(), pool_->Acquire(), config_, "Send", dc_config, "send");
+        if (!fixture) {
+            return false;
+        }
+        LoopbackPair* pair = fixture->pair();
+        DataChannelObserver* observer = pair->observer1()->GetDataObserver();
+        observer->SetSendBufferPool(buffers);
+        sender.Attach(observer);
+        receiver.Attach(pair->observer2()->GetDataObserver());
+
+        if (!fixture->Connect()) {
+            return false;
+        }
+
+        std::this_thread::sleep_for(std::chrono::microseconds(options_.warmup.us()));
+        const SendBufferPool::Counters pool_before = buffers ? buffers->counters() : SendBufferPool::Counters();
+        sender.StartMeasuring();
+        const auto window_start = std::chrono::steady_clock::now();
+        std::this_thread::sleep_for(std::chrono::microseconds(options_.duration.us()));
+        sender.StopMeasuring();
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - window_start).count();
+        const SendBufferPool::Counters pool_after = buffers ? buffers->counters() : SendBufferPool::Counters();
+
+        sender.Stop();
+        fixture->Close();
+
+        const uint64_t messages = sender.messages();
+        const double per_message = messages ? 1.0 / messages : 0.0;
+        const uint64_t acquired = pool_after.acquired - pool_before.acquired;
+        const double per_acquire = acquired ? 100.0 / acquired : 0.0;
+        std::cout << std::fixed << std::setw(10) << message_size << std::setw(8) << (buffers ? "pool" : "heap")
+                  << std::setw(12) << std::setprecision(0) << messages / seconds << std::setw(14)
+                  << std::setprecision(2) << sender.allocations() * per_message << std::setw(12)
+                  << std::setprecision(0) << sender.send_ns() * per_message;
+        if (buffers) {
+            std::cout << std::setprecision(1) << std::setw(9) << (pool_after.reused - pool_before.reused) * per_acquire
+                      << "%" << std::setw(9) << (pool_after.cloned - pool_before.cloned) * per_acquire << "%";
+        } else {
+            std::cout << std::setw(10) << "-" << std::setw(10) << "-";
+        }
+        std::cout << std::defaultfloat << std::endl;
+        return messages > 0;
+    }
+
+    PeerConnectionFactoryPool* pool_;
+    webrtc::PeerConnectionInterface::RTCConfiguration config_;
+    SendOptions options_;
+};
@@ -0,0 +1 @@
+#include "send_buffer_pool.h"
\ No newline at end of file
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include <api/ref_count.h>
+#include <api/scoped_refptr.h>
+#include <rtc_base/copy_on_write_buffer.h>
+
+// Reusable send buffers in power-of-four size classes from 64 B to 256 KiB.
+//
+// CopyOnWriteBuffer storage is reference counted and cannot be handed a
+// custom allocator, so reuse rides on that count instead: Recycle() keeps a
+// reference to a sent buffer, and Acquire() hands it out again. If WebRTC
+// has let go of the storage by then (dcsctp copies a message into its own
+// send queue, so usually it has), writing into it is free; if the channel
+// still holds it in its send queue, copy-on-write clones it and the clone
+// replaces it in the pool.
+//
+// Thread-safe; each size class has its own lock, so channels on different
+// network threads only contend when they use the same class.
+class SendBufferPool : public webrtc::RefCountInterface {
+public:
+    struct Counters {
+        uint64_t acquired = 0;
+        // Served from a pooled buffer whose storage WebRTC had released.
+        uint64_t reused = 0;
+        // Served from a pooled buffer WebRTC still referenced, so the
+        // storage was cloned.
+        uint64_t cloned = 0;
+        // Served from a new buffer: the class was empty or the size is above
+        // the largest class.
+        uint64_t allocated = 0;
+        uint64_t oversize = 0;
+        // Recycled buffers dropped because their class was full.
+        uint64_t discarded = 0;
+    };
+
+    // Keeps up to |max_cached_per_class| idle buffers in each class.
+    static webrtc::scoped_refptr<SendBufferPool> Create(size_t max_cached_per_class = 64) {
+        return webrtc::make_ref_counted<SendBufferPool>(max_cached_per_class);
+    }
+
+    // Returns a buffer of exactly |size| writable bytes. Its contents are
+    // whatever the previous user left there.
+    webrtc::CopyOnWriteBuffer Acquire(size_t size) {
+        acquired_.fetch_add(1, std::memory_order_relaxed);
+        const int index = ClassFor(size);
+        if (index < 0) {
+            oversize_.fetch_add(1, std::memory_order_relaxed);
+            allocated_.fetch_add(1, std::memory_order_relaxed);
+            return webrtc::CopyOnWriteBuffer(size);
+        }
+
+        webrtc::CopyOnWriteBuffer buffer;
+        SizeClass& size_class = classes_[index];
+        {
+            std::lock_guard<std::mutex> lock(size_class.mutex);
+            if (!size_class.idle.empty()) {
+                buffer = std::move(size_class.idle.back());
+                size_class.idle.pop_back();
+            }
+        }
+        if (buffer.capacity() == 0) {
+            allocated_.fetch_add(1, std::memory_order_relaxed);
+            return webrtc::CopyOnWriteBuffer(size, kClassBytes[index]);
+        }
+        // Writable access unshares the storage; a different pointer means it
+        // had to be cloned.
+        const uint8_t* storage = buffer.cdata();
+        buffer.SetSize(size);
+        if (buffer.MutableData() == storage) {
+            reused_.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            cloned_.fetch_add(1, std::memory_order_relaxed);
+        }
+        return buffer;
+    }
+
+    // Gives |buffer| back once it has been passed to Send(). Buffers that
+    // did not come from Acquire() are accepted if their capacity matches a
+    // class.
+    void Recycle(webrtc::CopyOnWriteBuffer&& buffer) {
+        const int index = ClassOfCapacity(buffer.capacity());
+        if (index < 0) {
+            return;
+        }
+        SizeClass& size_class = classes_[index];
+        std::lock_guard<std::mutex> lock(size_class.mutex);
+        if (size_class.idle.size() < max_cached_per_class_) {
+            size_class.idle.push_back(std::move(buffer));
+        } else {
+            discarded_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    Counters counters() const {
+        Counters counters;
+        counters.acquired = acquired_.load(std::memory_order_relaxed);
+        counters.reused = reused_.load(std::memory_order_relaxed);
+        counters.cloned = cloned_.load(std::memory_order_relaxed);
+        counters.allocated = allocated_.load(std::memory_order_relaxed);
+        counters.oversize = oversize_.load(std::memory_order_relaxed);
+        counters.discarded = discarded_.load(std::memory_order_relaxed);
+        return counters;
+    }
+
+protected:
+    explicit SendBufferPool(size_t max_cached_per_class) : max_cached_per_class_(max_cached_per_class) {
+        // Reserved up front so Recycle() never grows a vector.
+        for (SizeClass& size_class : classes_) {
+            size_class.idle.reserve(max_cached_per_class_);
+        }
+    }
+
+private:
+    static constexpr std::array<size_t, 7> kClassBytes = {64, 256, 1024, 4096, 16384, 65536, 262144};
+
+    struct SizeClass {
+        std::mutex mutex;
+        std::vector<webrtc::CopyOnWriteBuffer> idle;
+    };
+
+    // Smallest class that holds |size|, or -1 if none does.
+    static int ClassFor(size_t size) {
+        for (size_t i = 0; i < kClassBytes.size(); ++i) {
+            if (size <= kClassBytes[i]) {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+
+    static int ClassOfCapacity(size_t capacity) {
+        for (size_t i = 0; i < kClassBytes.size(); ++i) {
+            if (capacity == kClassBytes[i]) {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+
+    const size_t max_cached_per_class_;
+    std::array<SizeClass, kClassBytes.size()> classes_;
+    std::atomic<uint64_t> acquired_{0};
+    std::atomic<uint64_t> reused_{0};
+    std::atomic<uint64_t> cloned_{0};
+    std::atomic<uint64_t> allocated_{0};
+    std::atomic<uint64_t> oversize_{0};
+    std::atomic<uint64_t> discarded_{0};
+};
@@ -0,0 +1 @@
+#include "signaling_wire.h"
\ No newline at end of file
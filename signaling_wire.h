@@ -0,0 +1,181 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Binary framing for out-of-process signaling. Every frame is
+//
+//   u32 length | u8 type | u32 from | u32 to | body
+//
+// with integers big-endian and |length| counting everything after itself.
+// Bodies:
+//   kRegister, kBye    empty
+//   kOffer, kAnswer    SDP text
+//   kCandidate         u16 mline index | u8 mid length | mid | candidate line
+//
+// The relay only reads the fixed header, so it can forward frames as they
+// arrived without decoding the body.
+namespace signaling_wire {
+
+enum class MessageType : uint8_t {
+    kRegister = 1,
+    kOffer = 2,
+    kAnswer = 3,
+    kCandidate = 4,
+    kBye = 5,
+};
+
+constexpr size_t kLengthBytes = 4;
+constexpr size_t kHeaderBytes = kLengthBytes + 1 + 4 + 4;
+constexpr size_t kMaxFrameBytes = 1024 * 1024;
+
+struct Message {
+    MessageType type = MessageType::kRegister;
+    uint32_t from = 0;
+    uint32_t to = 0;
+    // kCandidate only.
+    int mline_index = 0;
+    std::string mid;
+    // SDP text for kOffer/kAnswer, the candidate line for kCandidate.
+    std::string body;
+};
+
+inline void PutU16(std::string& out, uint16_t value) {
+    out.push_back(static_cast<char>(value >> 8));
+    out.push_back(static_cast<char>(value));
+}
+
+inline void PutU32(std::string& out, uint32_t value) {
+    out.push_back(static_cast<char>(value >> 24));
+    out.push_back(static_cast<char>(value >> 16));
+    out.push_back(static_cast<char>(value >> 8));
+    out.push_back(static_cast<char>(value));
+}
+
+inline uint16_t GetU16(const char* data) {
+    const auto* bytes = reinterpret_cast<const uint8_t*>(data);
+    return static_cast<uint16_t>(bytes[0] << 8 | bytes[1]);
+}
+
+inline uint32_t GetU32(const char* data) {
+    const auto* bytes = reinterpret_cast<const uint8_t*>(data);
+    return uint32_t{bytes[0]} << 24 | uint32_t{bytes[1]} << 16 | uint32_t{bytes[2]} << 8 | uint32_t{bytes[3]};
+}
+
+// Appends |message| to |out| as one frame. Returns false (and appends
+// nothing) if it would exceed kMaxFrameBytes or the mid is too long.
+inline bool AppendFrame(const Message& message, std::string& out) {
+    size_t body_size = message.body.size();
+    if (message.type == MessageType::kCandidate) {
+        if (message.mid.size() > UINT8_MAX || message.mline_index < 0 || message.mline_index > UINT16_MAX) {
+            return false;
+        }
+        body_size += 2 + 1 + message.mid.size();
+    }
+    const size_t frame_size = kHeaderBytes + body_size;
+    if (frame_size > kMaxFrameBytes) {
+        return false;
+    }
+    out.reserve(out.size() + frame_size);
+    PutU32(out, static_cast<uint32_t>(frame_size - kLengthBytes));
+    out.push_back(static_cast<char>(message.type));
+    PutU32(out, message.from);
+    PutU32(out, message.to);
+    if (message.type == MessageType::kCandidate) {
+        PutU16(out, static_cast<uint16_t>(message.mline_index));
+        out.push_back(static_cast<char>(message.mid.size()));
+        out.append(message.mid);
+    }
+    out.append(message.body);
+    return true;
+}
+
+// Header fields of a complete frame, as returned by FrameReader::Next().
+struct Route {
+    MessageType type;
+    uint32_t from;
+    uint32_t to;
+};
+
+inline Route ReadRoute(std::string_view frame) {
+    return {static_cast<MessageType>(frame[kLengthBytes]), GetU32(frame.data() + kLengthBytes + 1),
+            GetU32(frame.data() + kLengthBytes + 5)};
+}
+
+// Decodes a complete frame. Returns false if the body is malformed.
+inline bool DecodeFrame(std::string_view frame, Message& message) {
+    const Route route = ReadRoute(frame);
+    message.type = route.type;
+    message.from = route.from;
+    message.to = route.to;
+    std::string_view body = frame.substr(kHeaderBytes);
+    if (route.type == MessageType::kCandidate) {
+        if (body.size() < 3) {
+            return false;
+        }
+        const size_t mid_size = static_cast<uint8_t>(body[2]);
+        if (body.size() < 3 + mid_size) {
+            return false;
+        }
+        message.mline_index = GetU16(body.data());
+        message.mid.assign(body.substr(3, mid_size));
+        body.remove_prefix(3 + mid_size);
+    }
+    message.body.assign(body);
+    return true;
+}
+
+// Reassembles frames from a byte stream.
+class FrameReader {
+public:
+    // Space for up to |size| more bytes, to read into directly. Call
+    // Commit() with the number actually written.
+    char* Prepare(size_t size) {
+        Compact();
+        buffer_.resize(end_ + size);
+        return buffer_.data() + end_;
+    }
+    void Commit(size_t written) { end_ += written; }
+
+    // The next complete frame (length prefix included), or an empty view if
+    // more bytes are needed. Valid until the next Prepare().
+    std::string_view Next() {
+        const size_t available = end_ - begin_;
+        if (available < kLengthBytes) {
+            return {};
+        }
+        const size_t frame_size = kLengthBytes + GetU32(buffer_.data() + begin_);
+        if (frame_size < kHeaderBytes || frame_size > kMaxFrameBytes) {
+            malformed_ = true;
+            return {};
+        }
+        if (available < frame_size) {
+            return {};
+        }
+        std::string_view frame(buffer_.data() + begin_, frame_size);
+        begin_ += frame_size;
+        return frame;
+    }
+
+    // The stream announced an impossible frame length; drop the connection.
+    bool malformed() const { return malformed_; }
+
+private:
+    void Compact() {
+        if (begin_ == 0) {
+            return;
+        }
+        buffer_.erase(0, begin_);
+        end_ -= begin_;
+        begin_ = 0;
+    }
+
+    std::string buffer_;
+    size_t begin_ = 0;
+    size_t end_ = 0;
+    bool malformed_ = false;
+};
+
+}  // namespace signaling_wire
@@ -1,99 +1,215 @@
 #pragma once
 
+#include <array>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include <api/media_stream_interface.h>
 #include <api/peer_connection_interface.h>
+#include <rtc_base/time_utils.h>
 
+#include "async_log.h"
+#include "completion_signal.h"
 #include "data_channel_observer.h"
+#include "handshake_trace.h"
+#include "ice_candidate_relay.h"
 
 class SimplePeerConnectionObserver : public webrtc::PeerConnectionObserver {
 public:
     explicit SimplePeerConnectionObserver(const std::string& name)
-        : name_(name), data_observer_(std::make_unique<DataChannelObserver>(name)) {}
+        : name_(name),
+          trace_track_(HandshakeTrace::Track(name)),
+          default_data_observer_(std::make_unique<DataChannelObserver>(name)) {
+        default_data_observer_->SetTraceTrack(trace_track_);
+    }
 
     // PeerConnectionObserver implementation
     void OnSignalingChange(webrtc::PeerConnectionInterface::SignalingState new_state) override {
-        std::cout << "[" << name_ << "] Signaling state: " << SignalingStateToString(new_state) << std::endl;
+        ASYNC_LOG(kInfo, name_, "Signaling state", SignalingStateToString(new_state));
     }
 
     void OnAddTrack(webrtc::scoped_refptr<webrtc::RtpReceiverInterface> receiver,
                     const std::vector<webrtc::scoped_refptr<webrtc::MediaStreamInterface>>& streams) override {
-        std::cout << "[" << name_ << "] Track added" << std::endl;
+        ASYNC_LOG(kInfo, name_, "Track added");
+    }
+
+    void OnTrack(webrtc::scoped_refptr<webrtc::RtpTransceiverInterface> transceiver) override {
+        webrtc::scoped_refptr<webrtc::MediaStreamTrackInterface> track = transceiver->receiver()->track();
+        if (video_track_handler_ && track->kind() == webrtc::MediaStreamTrackInterface::kVideoKind) {
+            video_track_handler_(
+                webrtc::scoped_refptr<webrtc::VideoTrackInterface>(static_cast<webrtc::VideoTrackInterface*>(track.get())));
+        }
     }
 
     void OnRemoveTrack(webrtc::scoped_refptr<webrtc::RtpReceiverInterface> receiver) override {
-        std::cout << "[" << name_ << "] Track removed" << std::endl;
+        ASYNC_LOG(kInfo, name_, "Track removed");
     }
 
     void OnDataChannel(webrtc::scoped_refptr<webrtc::DataChannelInterface> channel) override {
-        std::cout << "[" << name_ << "] Data channel received: " << channel->label() << std::endl;
-        data_observer_->SetDataChannel(channel);
+        ASYNC_LOG(kInfo, name_, "Data channel received", nullptr, channel->label());
+        FindDataObserver(channel->label())->SetDataChannel(channel);
     }
 
     void OnRenegotiationNeeded() override {
-        std::cout << "[" << name_ << "] Renegotiation needed" << std::endl;
+        ASYNC_LOG(kInfo, name_, "Renegotiation needed");
     }
 
     void OnIceConnectionChange(webrtc::PeerConnectionInterface::IceConnectionState new_state) override {
-        std::cout << "[" << name_ << "] ICE connection state: " << IceConnectionStateToString(new_state) << std::endl;
-        if (new_state == webrtc::PeerConnectionInterface::kIceConnectionConnected) {
+        ASYNC_LOG(kInfo, name_, "ICE connection state", IceConnectionStateToString(new_state));
+        if (new_state == webrtc::PeerConnectionInterface::kIceConnectionChecking) {
+            ice_checking_trace_us_ = TraceNow();
+        } else if (new_state == webrtc::PeerConnectionInterface::kIceConnectionDisconnected ||
+                   new_state == webrtc::PeerConnectionInterface::kIceConnectionFailed) {
+            ice_connected_ = false;
+        } else if (new_state == webrtc::PeerConnectionInterface::kIceConnectionConnected) {
             ice_connected_ = true;
+            ice_connected_trace_us_ = TraceNow();
+            HandshakeTrace::Span(trace_track_, "ICE connect", ice_checking_trace_us_, ice_connected_trace_us_);
         }
     }
 
     void OnIceGatheringChange(webrtc::PeerConnectionInterface::IceGatheringState new_state) override {
-        std::cout << "[" << name_ << "] ICE gathering state: " << IceGatheringStateToString(new_state) << std::endl;
-        if (new_state == webrtc::PeerConnectionInterface::kIceGatheringComplete) {
+        ASYNC_LOG(kInfo, name_, "ICE gathering state", IceGatheringStateToString(new_state));
+        if (new_state == webrtc::PeerConnectionInterface::kIceGatheringGathering) {
+            gathering_trace_us_ = TraceNow();
+        } else if (new_state == webrtc::PeerConnectionInterface::kIceGatheringComplete) {
+            HandshakeTrace::Span(trace_track_, "ICE gathering", gathering_trace_us_, TraceNow());
             ice_gathering_complete_ = true;
+            gathering_complete_.Resolve(webrtc::RTCError::OK());
         }
     }
 
     void OnIceCandidate(const webrtc::IceCandidateInterface* candidate) override {
-        std::string sdp;
-        candidate->ToString(&sdp);
-        std::cout << "[" << name_ << "] ICE candidate: " << candidate->sdp_mid()
-                  << " " << candidate->sdp_mline_index() << std::endl;
-
-        // Store candidate for exchange
-        webrtc::SdpParseError error;
-        std::unique_ptr<webrtc::IceCandidateInterface> ice_candidate(
-            webrtc::CreateIceCandidate(candidate->sdp_mid(),
-                                      candidate->sdp_mline_index(),
-                                      sdp,
-                                      &error)
-        );
-
-        if (ice_candidate) {
-            ice_candidates_.push_back(std::move(ice_candidate));
-        } else {
-            std::cerr << "[" << name_ << "] Failed to create ICE candidate: "
-                      << error.description << std::endl;
+        ASYNC_LOG(kInfo, name_, "ICE candidate", nullptr, CandidateDetail(*candidate).data());
+
+        int64_t expected = 0;
+        if (first_candidate_us_.compare_exchange_strong(expected, webrtc::TimeMicros())) {
+            HandshakeTrace::Instant(trace_track_, "first candidate");
+        }
+
+        // Copy the candidate object (no SDP text round trip) and trickle it
+        // straight to the remote peer
+        webrtc::scoped_refptr<IceCandidateSink> relay;
+        {
+            std::lock_guard<std::mutex> lock(candidate_relay_mutex_);
+            relay = candidate_relay_;
+        }
+        if (relay) {
+            relay->Push(webrtc::CreateIceCandidate(candidate->sdp_mid(), candidate->sdp_mline_index(),
+                                                   candidate->candidate()));
         }
     }
 
     void OnConnectionChange(webrtc::PeerConnectionInterface::PeerConnectionState new_state) override {
-        std::cout << "[" << name_ << "] Connection state: " << ConnectionStateToString(new_state) << std::endl;
+        ASYNC_LOG(kInfo, name_, "Connection state", ConnectionStateToString(new_state));
         if (new_state == webrtc::PeerConnectionInterface::PeerConnectionState::kConnected) {
             peer_connected_ = true;
+            // Only the first connect counts; later ones are recoveries.
+            if (!connected_.IsResolved()) {
+                connected_us_ = webrtc::TimeMicros();
+                // DTLS starts once ICE has a working pair.
+                HandshakeTrace::Span(trace_track_, "DTLS connect", ice_connected_trace_us_, connected_us_);
+            }
+            connected_.Resolve(webrtc::RTCError::OK());
+        } else if (new_state == webrtc::PeerConnectionInterface::PeerConnectionState::kDisconnected) {
+            peer_connected_ = false;
+        } else if (new_state == webrtc::PeerConnectionInterface::PeerConnectionState::kFailed ||
+                   new_state == webrtc::PeerConnectionInterface::PeerConnectionState::kClosed) {
+            peer_connected_ = false;
+            connected_.Resolve(webrtc::RTCError(webrtc::RTCErrorType::NETWORK_ERROR,
+                                                name_ + " connection " + ConnectionStateToString(new_state)));
+        }
+        if (connection_state_handler_) {
+            connection_state_handler_(new_state);
         }
     }
 
-    // Getters for connection state
+    const std::string& name() const { return name_; }
+
+    // This peer's HandshakeTrace track; 0 if tracing was off when it was
+    // created.
+    uint32_t trace_track() const { return trace_track_; }
+
+    // Getters for the current connection state; they go back to false when
+    // the connection drops.
     bool IsIceConnected() const { return ice_connected_.load(); }
     bool IsIceGatheringComplete() const { return ice_gathering_complete_.load(); }
     bool IsPeerConnected() const { return peer_connected_.load(); }
-    bool HasReceivedMessage() const { return data_observer_->HasReceivedMessage(); }
+    bool HasReceivedMessage() const { return default_data_observer_->HasReceivedMessage(); }
+
+    // Signals for awaiting state changes instead of polling the getters above.
+    CompletionSignal& GatheringComplete() { return gathering_complete_; }
+    CompletionSignal& Connected() { return connected_; }
+    CompletionSignal& FirstMessage() { return default_data_observer_->FirstMessage(); }
 
-    // Access to ICE candidates
-    const std::vector<std::unique_ptr<webrtc::IceCandidateInterface>>& GetIceCandidates() const {
-        return ice_candidates_;
+    // Where gathered candidates are trickled; set before SetLocalDescription.
+    // An ICE restart swaps in a new one while the connection is up.
+    void SetIceCandidateRelay(webrtc::scoped_refptr<IceCandidateSink> relay) {
+        std::lock_guard<std::mutex> lock(candidate_relay_mutex_);
+        candidate_relay_ = relay;
     }
 
-    void ClearIceCandidates() { ice_candidates_.clear(); }
+    // Called on the signaling thread after every connection state change,
+    // including drops and recoveries after the first connect; set before
+    // Connect().
+    void SetConnectionStateHandler(
+        std::function<void(webrtc::PeerConnectionInterface::PeerConnectionState)> handler) {
+        connection_state_handler_ = std::move(handler);
+    }
+
+    // Called on the signaling thread with each remote video track, e.g. to
+    // attach a sink; set before SetRemoteDescription.
+    void SetVideoTrackHandler(std::function<void(webrtc::scoped_refptr<webrtc::VideoTrackInterface>)> handler) {
+        video_track_handler_ = std::move(handler);
+    }
+
+    // webrtc::TimeMicros() of the first gathered candidate and of reaching
+    // kConnected, or 0 if that has not happened yet.
+    int64_t FirstCandidateTimeUs() const { return first_candidate_us_.load(); }
+    int64_t ConnectedTimeUs() const { return connected_us_.load(); }
 
-    // Access to data channel observer
-    DataChannelObserver* GetDataObserver() { return data_observer_.get(); }
+    // The observer for the default channel, and for any in-band channel whose
+    // label has no observer of its own.
+    DataChannelObserver* GetDataObserver() { return default_data_observer_.get(); }
+
+    // The observer for the channel labelled |label|, created on first use.
+    // Register it before the channel exists (or opens) so hooks set on it
+    // see every callback; the pointer stays valid for the observer's life.
+    DataChannelObserver* GetDataObserver(const std::string& label) {
+        std::lock_guard<std::mutex> lock(data_observers_mutex_);
+        std::unique_ptr<DataChannelObserver>& observer = data_observers_[label];
+        if (!observer) {
+            observer = std::make_unique<DataChannelObserver>(name_ + "/" + label);
+            observer->SetTraceTrack(trace_track_);
+        }
+        return observer.get();
+    }
 
 private:
-    std::string SignalingStateToString(webrtc::PeerConnectionInterface::SignalingState state) {
+    DataChannelObserver* FindDataObserver(const std::string& label) {
+        std::lock_guard<std::mutex> lock(data_observers_mutex_);
+        auto it = data_observers_.find(label);
+        return it != data_observers_.end() ? it->second.get() : default_data_observer_.get();
+    }
+
+    // Phase start times are only read for traced peers.
+    int64_t TraceNow() const { return trace_track_ != 0 ? webrtc::TimeMicros() : 0; }
+
+    // "<mid> <mline index>", formatted on the stack.
+    static std::array<char, 64> CandidateDetail(const webrtc::IceCandidateInterface& candidate) {
+        std::array<char, 64> detail;
+        std::snprintf(detail.data(), detail.size(), "%s %d", candidate.sdp_mid().c_str(), candidate.sdp_mline_index());
+        return detail;
+    }
+
+    // The state names are string literals, so they can go into log records
+    // as-is.
+    static const char* SignalingStateToString(webrtc::PeerConnectionInterface::SignalingState state) {
         switch (state) {
             case webrtc::PeerConnectionInterface::kStable: return "Stable";
             case webrtc::PeerConnectionInterface::kHaveLocalOffer: return "HaveLocalOffer";
@@ -105,7 +221,7 @@ private:
         }
     }
 
-    std::string IceConnectionStateToString(webrtc::PeerConnectionInterface::IceConnectionState state) {
+    static const char* IceConnectionStateToString(webrtc::PeerConnectionInterface::IceConnectionState state) {
         switch (state) {
             case webrtc::PeerConnectionInterface::kIceConnectionNew: return "New";
             case webrtc::PeerConnectionInterface::kIceConnectionChecking: return "Checking";
@@ -118,7 +234,7 @@ private:
         }
     }
 
-    std::string IceGatheringStateToString(webrtc::PeerConnectionInterface::IceGatheringState state) {
+    static const char* IceGatheringStateToString(webrtc::PeerConnectionInterface::IceGatheringState state) {
         switch (state) {
             case webrtc::PeerConnectionInterface::kIceGatheringNew: return "New";
             case webrtc::PeerConnectionInterface::kIceGatheringGathering: return "Gathering";
@@ -127,7 +243,7 @@ private:
         }
     }
 
-    std::string ConnectionStateToString(webrtc::PeerConnectionInterface::PeerConnectionState state) {
+    static const char* ConnectionStateToString(webrtc::PeerConnectionInterface::PeerConnectionState state) {
         switch (state) {
             case webrtc::PeerConnectionInterface::PeerConnectionState::kNew: return "New";
             case webrtc::PeerConnectionInterface::PeerConnectionState::kConnecting: return "Connecting";
@@ -140,10 +256,27 @@ private:
     }
 
     std::string name_;
-    std::unique_ptr<DataChannelObserver> data_observer_;
-    std::vector<std::unique_ptr<webrtc::IceCandidateInterface>> ice_candidates_;
+    const uint32_t trace_track_;
+    std::unique_ptr<DataChannelObserver> default_data_observer_;
+    // Per-label observers; entries are never removed.
+    std::mutex data_observers_mutex_;
+    std::map<std::string, std::unique_ptr<DataChannelObserver>> data_observers_;
+    std::mutex candidate_relay_mutex_;
+    webrtc::scoped_refptr<IceCandidateSink> candidate_relay_;
+    std::function<void(webrtc::PeerConnectionInterface::PeerConnectionState)> connection_state_handler_;
+    std::function<void(webrtc::scoped_refptr<webrtc::VideoTrackInterface>)> video_track_handler_;
 
     std::atomic<bool> ice_connected_{false};
     std::atomic<bool> ice_gathering_complete_{false};
     std::atomic<bool> peer_connected_{false};
+    std::atomic<int64_t> first_candidate_us_{0};
+    std::atomic<int64_t> connected_us_{0};
+    // Start times of the traced phases; each is written and read on the
+    // signaling thread.
+    int64_t gathering_trace_us_ = 0;
+    int64_t ice_checking_trace_us_ = 0;
+    int64_t ice_connected_trace_us_ = 0;
+
+    CompletionSignal gathering_complete_;
+    CompletionSignal connected_;
 };
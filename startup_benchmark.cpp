@@ -0,0 +1 @@
+#include "startup_benchmark.h"
\ No newline at end of file
@@ -0,0 +1,213 @@
+#pragma once
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <rtc_base/ssl_adapter.h>
+
+#include "factory_pool.h"
+#include "latency_stats.h"
+#include "process_stats.h"
+#include "video_codec_config.h"
+
+extern char** environ;
+
+struct StartupOptions {
+    int runs = 10;
+    // Builds to compare, e.g. one per WEBRTC_EXAMPLE_VIDEO_CODECS setting.
+    // Empty: this binary only.
+    std::vector<std::string> binaries;
+};
+
+// Measures what a build's codec selection costs before the first
+// connection: starts each binary StartupOptions::runs times in probe mode
+// (--mode=startup-probe) and reports its size on disk, the time from spawn
+// until the probe has a PeerConnectionFactory, the factory creation time
+// alone, and RSS with the factory alive.
+class StartupBenchmark {
+public:
+    explicit StartupBenchmark(StartupOptions options) : options_(std::move(options)) {
+        if (options_.binaries.empty()) {
+            options_.binaries.push_back(SelfPath());
+        }
+    }
+
+    int Run() {
+        std::cout << "Startup mode: " << options_.runs << " runs per binary" << std::endl;
+        std::cout << std::setw(22) << "codecs" << std::setw(10) << "size MiB" << std::setw(10) << "ready ms"
+                  << std::setw(12) << "factory ms" << std::setw(10) << "exit ms" << std::setw(10) << "RSS MiB"
+                  << std::setw(10) << "peak MiB" << "  binary" << std::endl;
+        bool ok = true;
+        for (const std::string& binary : options_.binaries) {
+            ok = RunBinary(binary) && ok;
+        }
+        return ok ? 0 : -1;
+    }
+
+    // The probe side, run first thing in main(). Creates one factory shard
+    // the way every mode does, prints one line for the parent and exits.
+    static int RunProbe() {
+        webrtc::InitializeSSL();
+        const auto factory_start = std::chrono::steady_clock::now();
+        std::unique_ptr<PeerConnectionFactoryPool> pool = PeerConnectionFactoryPool::Create({});
+        const auto factory_end = std::chrono::steady_clock::now();
+        if (!pool) {
+            return -1;
+        }
+        const int64_t rss = ProcessStats::ResidentSetBytes();
+        std::printf("%s %s %lld %lld\n", kProbeTag, video_codec_config::Describe().c_str(),
+                    static_cast<long long>(Micros(factory_start, factory_end)), static_cast<long long>(rss));
+        std::fflush(stdout);
+        pool = nullptr;
+        webrtc::CleanupSSL();
+        return 0;
+    }
+
+private:
+    static constexpr const char* kProbeTag = "startup-probe";
+
+    struct ProbeResult {
+        std::string codecs;
+        double ready_ms = 0;
+        double factory_ms = 0;
+        double exit_ms = 0;
+        int64_t rss = 0;
+        int64_t peak_rss = 0;
+    };
+
+    bool RunBinary(const std::string& binary) {
+        struct stat info {};
+        if (stat(binary.c_str(), &info) != 0) {
+            std::cerr << "Cannot stat " << binary << std::endl;
+            return false;
+        }
+
+        std::string codecs;
+        LatencyStats ready_ms;
+        LatencyStats factory_ms;
+        LatencyStats exit_ms;
+        int64_t rss = 0;
+        int64_t peak_rss = 0;
+        for (int i = 0; i < options_.runs; ++i) {
+            ProbeResult result;
+            if (!Probe(binary, result)) {
+                std::cerr << "Probe of " << binary << " failed" << std::endl;
+                return false;
+            }
+            codecs = result.codecs;
+            ready_ms.Add(result.ready_ms);
+            factory_ms.Add(result.factory_ms);
+            exit_ms.Add(result.exit_ms);
+            rss = std::max(rss, result.rss);
+            peak_rss = std::max(peak_rss, result.peak_rss);
+        }
+
+        std::cout << std::fixed << std::setprecision(1) << std::setw(22) << codecs << std::setw(10)
+                  << info.st_size / (1024.0 * 1024.0) << std::setprecision(2) << std::setw(10)
+                  << ready_ms.Percentile(50) << std::setw(12) << factory_ms.Percentile(50) << std::setw(10)
+                  << exit_ms.Percentile(50) << std::setprecision(1) << std::setw(10) << rss / (1024.0 * 1024.0)
+                  << std::setw(10) << peak_rss / (1024.0 * 1024.0) << "  " << binary << std::defaultfloat
+                  << std::endl;
+        return true;
+    }
+
+    // Spawns |binary| in probe mode with its stdout on a pipe; "ready" is
+    // when the probe line arrives, "exit" when the process has been reaped.
+    static bool Probe(const std::string& binary, ProbeResult& result) {
+        int pipe_fds[2];
+        if (pipe2(pipe_fds, O_CLOEXEC) != 0) {
+            return false;
+        }
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_adddup2(&actions, pipe_fds[1], STDOUT_FILENO);
+
+        std::string mode_arg = std::string("--mode=") + kProbeTag;
+        std::string log_arg = "--log-level=none";
+        char* argv[] = {const_cast<char*>(binary.c_str()), mode_arg.data(), log_arg.data(), nullptr};
+
+        const auto spawn_time = std::chrono::steady_clock::now();
+        pid_t pid = 0;
+        const int spawned = posix_spawn(&pid, binary.c_str(), &actions, nullptr, argv, environ);
+        posix_spawn_file_actions_destroy(&actions);
+        close(pipe_fds[1]);
+        if (spawned != 0) {
+            close(pipe_fds[0]);
+            return false;
+        }
+
+        // The probe prints a single line, possibly after log output.
+        std::string output;
+        std::string line;
+        char buffer[4096];
+        bool ready = false;
+        while (!ready) {
+            const ssize_t received = read(pipe_fds[0], buffer, sizeof(buffer));
+            if (received <= 0) {
+                break;
+            }
+            output.append(buffer, received);
+            const size_t tag = output.find(kProbeTag);
+            if (tag != std::string::npos && output.find('\n', tag) != std::string::npos) {
+                result.ready_ms = Millis(spawn_time, std::chrono::steady_clock::now());
+                line = output.substr(tag, output.find('\n', tag) - tag);
+                ready = true;
+            }
+        }
+        // Drain anything printed during teardown so the child never blocks.
+        while (read(pipe_fds[0], buffer, sizeof(buffer)) > 0) {
+        }
+        close(pipe_fds[0]);
+
+        int status = 0;
+        rusage usage{};
+        if (wait4(pid, &status, 0, &usage) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0 || !ready) {
+            return false;
+        }
+        result.exit_ms = Millis(spawn_time, std::chrono::steady_clock::now());
+        result.peak_rss = static_cast<int64_t>(usage.ru_maxrss) * 1024;
+
+        std::istringstream fields(line.substr(std::char_traits<char>::length(kProbeTag)));
+        long long factory_us = 0;
+        long long rss = 0;
+        fields >> result.codecs >> factory_us >> rss;
+        if (!fields) {
+            return false;
+        }
+        result.factory_ms = factory_us / 1000.0;
+        result.rss = rss;
+        return true;
+    }
+
+    static std::string SelfPath() {
+        char path[PATH_MAX];
+        const ssize_t length = readlink("/proc/self/exe", path, sizeof(path) - 1);
+        return length > 0 ? std::string(path, length) : "/proc/self/exe";
+    }
+
+    static int64_t Micros(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(to - from).count();
+    }
+
+    static double Millis(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+        return std::chrono::duration<double, std::milli>(to - from).count();
+    }
+
+    StartupOptions options_;
+};
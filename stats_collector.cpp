@@ -0,0 +1 @@
+#include "stats_collector.h"
\ No newline at end of file
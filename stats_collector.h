@@ -0,0 +1,470 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <api/peer_connection_interface.h>
+#include <api/ref_count.h>
+#include <api/scoped_refptr.h>
+#include <api/stats/rtc_stats_collector_callback.h>
+#include <api/stats/rtc_stats_report.h>
+#include <api/stats/rtcstats_objects.h>
+#include <api/units/time_delta.h>
+#include <rtc_base/event.h>
+#include <rtc_base/thread.h>
+#include <rtc_base/time_utils.h>
+
+#include "async_log.h"
+
+// Per-interval deltas for one data channel.
+struct ChannelStatsSample {
+    int id = -1;
+    uint32_t messages_sent = 0;
+    uint32_t messages_received = 0;
+    uint64_t bytes_sent = 0;
+    uint64_t bytes_received = 0;
+};
+
+// One GetStats() poll of one PeerConnection. RTT and bitrate are the values
+// reported for the selected candidate pair (-1 when not reported yet); the
+// channel counters are deltas since the previous poll. Only the first
+// kMaxChannels channels in the report are kept, so samples stay fixed-size;
+// |channels_omitted| counts the rest.
+struct StatsSample {
+    static constexpr size_t kMaxChannels = 4;
+
+    int64_t time_us = 0;
+    double rtt_ms = -1;
+    double available_outgoing_bitrate_bps = -1;
+    uint8_t channel_count = 0;
+    uint16_t channels_omitted = 0;
+    std::array<ChannelStatsSample, kMaxChannels> channels;
+};
+
+// Fixed-capacity history of samples; the oldest is overwritten when full.
+class StatsRing {
+public:
+    explicit StatsRing(size_t capacity) : samples_(capacity) {}
+
+    void Push(const StatsSample& sample) {
+        samples_[(start_ + count_) % samples_.size()] = sample;
+        if (count_ < samples_.size()) {
+            ++count_;
+        } else {
+            start_ = (start_ + 1) % samples_.size();
+        }
+    }
+
+    size_t size() const { return count_; }
+    // |i| = 0 is the oldest retained sample.
+    const StatsSample& at(size_t i) const { return samples_[(start_ + i) % samples_.size()]; }
+    const StatsSample& newest() const { return at(count_ - 1); }
+
+private:
+    std::vector<StatsSample> samples_;
+    size_t start_ = 0;
+    size_t count_ = 0;
+};
+
+// One GetStats() call that waits for its report, for benchmarks that read
+// counters at the edges of a measurement window. Returns null on timeout.
+// Must not be called on |pc|'s signaling thread.
+inline webrtc::scoped_refptr<const webrtc::RTCStatsReport> GetStatsBlocking(
+    webrtc::scoped_refptr<webrtc::PeerConnectionInterface> pc,
+    webrtc::TimeDelta timeout = webrtc::TimeDelta::Seconds(5)) {
+    class Waiter : public webrtc::RTCStatsCollectorCallback {
+    public:
+        void OnStatsDelivered(const webrtc::scoped_refptr<const webrtc::RTCStatsReport>& report) override {
+            report_ = report;
+            done_.Set();
+        }
+
+        webrtc::scoped_refptr<const webrtc::RTCStatsReport> Wait(webrtc::TimeDelta timeout) {
+            return done_.Wait(timeout) ? report_ : nullptr;
+        }
+
+    private:
+        webrtc::Event done_;
+        webrtc::scoped_refptr<const webrtc::RTCStatsReport> report_;
+    };
+
+    auto waiter = webrtc::make_ref_counted<Waiter>();
+    pc->GetStats(waiter.get());
+    return waiter->Wait(timeout);
+}
+
+enum class StatsFormat { kJsonLines, kPrometheus };
+
+struct StatsOptions {
+    webrtc::TimeDelta interval = webrtc::TimeDelta::Seconds(1);
+    // Samples kept per PeerConnection.
+    size_t history = 60;
+    std::string output_path;
+    // JSON lines are appended as samples arrive; the Prometheus text file is
+    // rewritten with the latest values every interval.
+    StatsFormat format = StatsFormat::kJsonLines;
+};
+
+// Polls GetStats() on every tracked PeerConnection and keeps a short history
+// of transport and data channel metrics.
+//
+// All bookkeeping runs on the collector's own thread. Polls are staggered
+// across the interval so thousands of connections do not all report in the
+// same tick, a connection whose previous report has not arrived yet is
+// skipped, and reports are parsed on the collector thread rather than the
+// signaling thread that delivers them.
+class StatsCollector {
+public:
+    static std::unique_ptr<StatsCollector> Create(StatsOptions options) {
+        std::unique_ptr<StatsCollector> collector(new StatsCollector(options));
+        if (!options.output_path.empty() && options.format == StatsFormat::kJsonLines) {
+            collector->jsonl_.open(options.output_path, std::ios::app);
+            if (!collector->jsonl_) {
+                std::cerr << "Failed to open stats output " << options.output_path << std::endl;
+                return nullptr;
+            }
+        }
+        collector->thread_->SetName("stats", nullptr);
+        collector->thread_->Start();
+        collector->thread_->PostDelayedTask([collector = collector.get()] { collector->Export(); },
+                                            options.interval);
+        return collector;
+    }
+
+    ~StatsCollector() {
+        thread_->BlockingCall([this] {
+            stopping_ = true;
+            connections_.clear();
+            names_.clear();
+        });
+        // Callbacks still outstanding drop their reports from here on; those
+        // already posted find no connection left.
+        inbox_->Close();
+        thread_->Stop();
+        jsonl_.flush();
+    }
+
+    void Track(const std::string& name, webrtc::scoped_refptr<webrtc::PeerConnectionInterface> pc) {
+        thread_->BlockingCall([&] {
+            auto existing = names_.find(name);
+            if (existing != names_.end()) {
+                connections_.erase(existing->second);
+            }
+            const uint64_t id = next_id_++;
+            connections_.emplace(id, Connection(name, pc, options_.history));
+            names_[name] = id;
+            // Golden-ratio phases spread the polls evenly over the interval.
+            phase_ = phase_ + 0.6180339887;
+            phase_ -= static_cast<int>(phase_);
+            SchedulePoll(id, webrtc::TimeDelta::Micros(static_cast<int64_t>(options_.interval.us() * phase_)));
+        });
+    }
+
+    void Untrack(const std::string& name) {
+        thread_->BlockingCall([&] {
+            auto it = names_.find(name);
+            if (it != names_.end()) {
+                connections_.erase(it->second);
+                names_.erase(it);
+            }
+        });
+    }
+
+    // Retained samples for |name|, oldest first.
+    std::vector<StatsSample> History(const std::string& name) {
+        return thread_->BlockingCall([&] {
+            std::vector<StatsSample> history;
+            auto it = names_.find(name);
+            if (it != names_.end()) {
+                const StatsRing& ring = connections_.at(it->second).samples;
+                for (size_t i = 0; i < ring.size(); ++i) {
+                    history.push_back(ring.at(i));
+                }
+            }
+            return history;
+        });
+    }
+
+    // Collection cost, for checking it stays cheap at scale.
+    void PrintSummary(std::ostream& out) {
+        thread_->BlockingCall([&] {
+            out << std::fixed << std::setprecision(1) << "Stats: " << reports_ << " reports, " << skipped_
+                << " polls skipped while a report was in flight, "
+                << (reports_ ? static_cast<double>(parse_us_) / reports_ : 0.0) << " us parse per report"
+                << std::defaultfloat << std::endl;
+            if (truncated_reports_ > 0) {
+                out << "Stats: " << truncated_reports_ << " reports had more than " << StatsSample::kMaxChannels
+                    << " data channels; the rest were not recorded" << std::endl;
+            }
+        });
+    }
+
+private:
+    struct Connection {
+        Connection(const std::string& name,
+                   webrtc::scoped_refptr<webrtc::PeerConnectionInterface> pc,
+                   size_t history)
+            : name(name), pc(pc), samples(history) {}
+
+        std::string name;
+        webrtc::scoped_refptr<webrtc::PeerConnectionInterface> pc;
+        StatsRing samples;
+        bool in_flight = false;
+        // Cumulative counters from the previous report, for deltas and the
+        // Prometheus counters.
+        std::array<ChannelStatsSample, StatsSample::kMaxChannels> totals;
+        uint8_t total_count = 0;
+        // Samples not yet appended to the JSON lines file.
+        size_t unexported = 0;
+    };
+
+    // Where callbacks deliver reports. A GetStats() callback can outlive the
+    // collector, so it holds this instead; Close() makes later deliveries
+    // no-ops.
+    class Inbox : public webrtc::RefCountInterface {
+    public:
+        explicit Inbox(StatsCollector* collector) : collector_(collector) {}
+
+        void Deliver(uint64_t id, const webrtc::scoped_refptr<const webrtc::RTCStatsReport>& report) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (collector_) {
+                collector_->thread_->PostTask(
+                    [collector = collector_, id, report] { collector->OnReport(id, report); });
+            }
+        }
+
+        void Close() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            collector_ = nullptr;
+        }
+
+    private:
+        std::mutex mutex_;
+        StatsCollector* collector_;
+    };
+
+    // Hands the report back to the collector thread.
+    class Callback : public webrtc::RTCStatsCollectorCallback {
+    public:
+        Callback(webrtc::scoped_refptr<Inbox> inbox, uint64_t id) : inbox_(std::move(inbox)), id_(id) {}
+
+        void OnStatsDelivered(const webrtc::scoped_refptr<const webrtc::RTCStatsReport>& report) override {
+            inbox_->Deliver(id_, report);
+        }
+
+    private:
+        webrtc::scoped_refptr<Inbox> inbox_;
+        uint64_t id_;
+    };
+
+    explicit StatsCollector(StatsOptions options)
+        : options_(options),
+          thread_(webrtc::Thread::Create()),
+          inbox_(webrtc::make_ref_counted<Inbox>(this)) {}
+
+    void SchedulePoll(uint64_t id, webrtc::TimeDelta delay) {
+        thread_->PostDelayedTask([this, id] { Poll(id); }, delay);
+    }
+
+    void Poll(uint64_t id) {
+        auto it = connections_.find(id);
+        if (stopping_ || it == connections_.end()) {
+            return;
+        }
+        Connection& connection = it->second;
+        if (connection.in_flight) {
+            ++skipped_;
+        } else {
+            connection.in_flight = true;
+            connection.pc->GetStats(webrtc::make_ref_counted<Callback>(inbox_, id).get());
+        }
+        SchedulePoll(id, options_.interval);
+    }
+
+    void OnReport(uint64_t id, const webrtc::scoped_refptr<const webrtc::RTCStatsReport>& report) {
+        auto it = connections_.find(id);
+        if (it == connections_.end()) {
+            return;
+        }
+        const int64_t start_us = webrtc::TimeMicros();
+        Connection& connection = it->second;
+        connection.in_flight = false;
+
+        StatsSample sample;
+        sample.time_us = start_us;
+        for (const webrtc::RTCTransportStats* transport : report->GetStatsOfType<webrtc::RTCTransportStats>()) {
+            if (!transport->selected_candidate_pair_id) {
+                continue;
+            }
+            const auto* pair = report->GetAs<webrtc::RTCIceCandidatePairStats>(*transport->selected_candidate_pair_id);
+            if (!pair) {
+                continue;
+            }
+            if (pair->current_round_trip_time) {
+                sample.rtt_ms = *pair->current_round_trip_time * 1000.0;
+            }
+            if (pair->available_outgoing_bitrate) {
+                sample.available_outgoing_bitrate_bps = *pair->available_outgoing_bitrate;
+            }
+            break;
+        }
+
+        // Cumulative counters replace the previous set, so closed channels
+        // drop out.
+        std::array<ChannelStatsSample, StatsSample::kMaxChannels> totals;
+        for (const webrtc::RTCDataChannelStats* channel : report->GetStatsOfType<webrtc::RTCDataChannelStats>()) {
+            if (sample.channel_count == StatsSample::kMaxChannels) {
+                ++sample.channels_omitted;
+                continue;
+            }
+            ChannelStatsSample& total = totals[sample.channel_count];
+            total.id = channel->data_channel_identifier.value_or(-1);
+            total.messages_sent = channel->messages_sent.value_or(0);
+            total.messages_received = channel->messages_received.value_or(0);
+            total.bytes_sent = channel->bytes_sent.value_or(0);
+            total.bytes_received = channel->bytes_received.value_or(0);
+
+            ChannelStatsSample previous;
+            for (uint8_t i = 0; i < connection.total_count; ++i) {
+                if (connection.totals[i].id == total.id) {
+                    previous = connection.totals[i];
+                    break;
+                }
+            }
+            ChannelStatsSample& delta = sample.channels[sample.channel_count++];
+            delta.id = total.id;
+            delta.messages_sent = total.messages_sent - previous.messages_sent;
+            delta.messages_received = total.messages_received - previous.messages_received;
+            delta.bytes_sent = total.bytes_sent - previous.bytes_sent;
+            delta.bytes_received = total.bytes_received - previous.bytes_received;
+        }
+        connection.totals = totals;
+        connection.total_count = sample.channel_count;
+
+        if (sample.channels_omitted > 0 && truncated_reports_++ == 0) {
+            ASYNC_LOG(kWarning, connection.name, "Stats report has more data channels than a sample holds", nullptr,
+                      std::to_string(sample.channels_omitted) + " not recorded");
+        }
+
+        connection.samples.Push(sample);
+        connection.unexported = std::min(connection.unexported + 1, connection.samples.size());
+        ++reports_;
+        parse_us_ += webrtc::TimeMicros() - start_us;
+    }
+
+    // Runs every interval on the collector thread.
+    void Export() {
+        if (stopping_) {
+            return;
+        }
+        if (jsonl_.is_open()) {
+            WriteJsonLines();
+        } else if (!options_.output_path.empty()) {
+            WritePrometheus();
+        }
+        thread_->PostDelayedTask([this] { Export(); }, options_.interval);
+    }
+
+    void WriteJsonLines() {
+        for (auto& [id, connection] : connections_) {
+            const StatsRing& ring = connection.samples;
+            for (size_t i = ring.size() - connection.unexported; i < ring.size(); ++i) {
+                const StatsSample& sample = ring.at(i);
+                jsonl_ << "{\"peer\":\"" << connection.name << "\",\"time_us\":" << sample.time_us << ",\"rtt_ms\":";
+                WriteJsonNumber(sample.rtt_ms);
+                jsonl_ << ",\"available_outgoing_bitrate_bps\":";
+                WriteJsonNumber(sample.available_outgoing_bitrate_bps);
+                jsonl_ << ",\"channels\":[";
+                for (uint8_t c = 0; c < sample.channel_count; ++c) {
+                    const ChannelStatsSample& channel = sample.channels[c];
+                    jsonl_ << (c ? "," : "") << "{\"id\":" << channel.id << ",\"bytes_sent\":" << channel.bytes_sent
+                           << ",\"bytes_received\":" << channel.bytes_received
+                           << ",\"messages_sent\":" << channel.messages_sent
+                           << ",\"messages_received\":" << channel.messages_received << "}";
+                }
+                jsonl_ << "],\"channels_omitted\":" << sample.channels_omitted << "}\n";
+            }
+            connection.unexported = 0;
+        }
+        jsonl_.flush();
+    }
+
+    void WriteJsonNumber(double value) {
+        if (value < 0) {
+            jsonl_ << "null";
+        } else {
+            jsonl_ << value;
+        }
+    }
+
+    // Written to a temporary file and renamed, so a scraper never reads a
+    // half-written snapshot.
+    void WritePrometheus() {
+        const std::string temp_path = options_.output_path + ".tmp";
+        std::ofstream out(temp_path, std::ios::trunc);
+        if (!out) {
+            ASYNC_LOG(kWarning, {}, "Failed to write stats", nullptr, temp_path);
+            return;
+        }
+        out << "# TYPE webrtc_candidate_pair_rtt_seconds gauge\n";
+        for (const auto& [id, connection] : connections_) {
+            if (connection.samples.size() > 0 && connection.samples.newest().rtt_ms >= 0) {
+                out << "webrtc_candidate_pair_rtt_seconds{peer=\"" << connection.name << "\"} "
+                    << connection.samples.newest().rtt_ms / 1000.0 << "\n";
+            }
+        }
+        out << "# TYPE webrtc_available_outgoing_bitrate_bps gauge\n";
+        for (const auto& [id, connection] : connections_) {
+            if (connection.samples.size() > 0 && connection.samples.newest().available_outgoing_bitrate_bps >= 0) {
+                out << "webrtc_available_outgoing_bitrate_bps{peer=\"" << connection.name << "\"} "
+                    << connection.samples.newest().available_outgoing_bitrate_bps << "\n";
+            }
+        }
+        WritePrometheusCounter(out, "webrtc_data_channel_bytes_sent_total", &ChannelStatsSample::bytes_sent);
+        WritePrometheusCounter(out, "webrtc_data_channel_bytes_received_total", &ChannelStatsSample::bytes_received);
+        WritePrometheusCounter(out, "webrtc_data_channel_messages_sent_total", &ChannelStatsSample::messages_sent);
+        WritePrometheusCounter(out, "webrtc_data_channel_messages_received_total",
+                               &ChannelStatsSample::messages_received);
+        out.close();
+        std::rename(temp_path.c_str(), options_.output_path.c_str());
+    }
+
+    template <typename Field>
+    void WritePrometheusCounter(std::ostream& out, const char* metric, Field ChannelStatsSample::*field) {
+        out << "# TYPE " << metric << " counter\n";
+        for (const auto& [id, connection] : connections_) {
+            for (uint8_t i = 0; i < connection.total_count; ++i) {
+                const ChannelStatsSample& total = connection.totals[i];
+                out << metric << "{peer=\"" << connection.name << "\",channel=\"" << total.id << "\"} "
+                    << total.*field << "\n";
+            }
+        }
+    }
+
+    const StatsOptions options_;
+    std::unique_ptr<webrtc::Thread> thread_;
+    std::ofstream jsonl_;
+
+    // Collector thread only.
+    std::unordered_map<uint64_t, Connection> connections_;
+    std::unordered_map<std::string, uint64_t> names_;
+    uint64_t next_id_ = 0;
+    double phase_ = 0;
+    bool stopping_ = false;
+    uint64_t reports_ = 0;
+    uint64_t skipped_ = 0;
+    uint64_t truncated_reports_ = 0;
+    int64_t parse_us_ = 0;
+
+    webrtc::scoped_refptr<Inbox> inbox_;
+};
@@ -0,0 +1 @@
+#include "synthetic_video.h"
\ No newline at end of file
@@ -0,0 +1,245 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <optional>
+
+#include <api/scoped_refptr.h>
+#include <api/units/time_delta.h>
+#include <api/video/i420_buffer.h>
+#include <api/video/video_frame.h>
+#include <api/video/video_sink_interface.h>
+#include <common_video/include/video_frame_buffer_pool.h>
+#include <media/base/adapted_video_track_source.h>
+#include <rtc_base/thread.h>
+#include <rtc_base/time_utils.h>
+
+#include "latency_stats.h"
+
+// Frames carry their capture time as a barcode in the top-left corner so the
+// receiving sink can measure capture-to-render latency after a lossy codec:
+// 4 rows of 16 square blocks, the low 32 bits of the capture time in
+// microseconds (MSB first) and then their complement. Blocks are black or
+// white and read back by averaging each block's centre, which survives any
+// sane bitrate.
+namespace video_barcode {
+
+constexpr int kColumns = 16;
+constexpr int kRows = 4;
+constexpr int kMaxBlock = 16;
+// Smaller blocks blur into their neighbours.
+constexpr int kMinBlock = 4;
+constexpr uint8_t kBlack = 16;
+constexpr uint8_t kWhite = 235;
+
+// Block size for a frame, or 0 if the frame is too small to carry a code.
+inline int BlockSize(int width, int height) {
+    const int block = std::min({kMaxBlock, width / kColumns, height / kRows});
+    return block >= kMinBlock ? block : 0;
+}
+
+inline void Write(uint8_t* y, int stride, int block, uint32_t value) {
+    const uint64_t bits = uint64_t{value} << 32 | uint32_t{~value};
+    for (int i = 0; i < kColumns * kRows; ++i) {
+        const uint8_t level = (bits >> (kColumns * kRows - 1 - i)) & 1 ? kWhite : kBlack;
+        uint8_t* origin = y + (i / kColumns) * block * stride + (i % kColumns) * block;
+        for (int row = 0; row < block; ++row) {
+            std::memset(origin + row * stride, level, block);
+        }
+    }
+}
+
+// Returns nullopt if the code is unreadable (the two halves disagree).
+inline std::optional<uint32_t> Read(const uint8_t* y, int stride, int block) {
+    uint64_t bits = 0;
+    const int margin = block / 4;
+    for (int i = 0; i < kColumns * kRows; ++i) {
+        const uint8_t* origin = y + (i / kColumns) * block * stride + (i % kColumns) * block;
+        int sum = 0;
+        int count = 0;
+        for (int row = margin; row < block - margin; ++row) {
+            for (int column = margin; column < block - margin; ++column) {
+                sum += origin[row * stride + column];
+                ++count;
+            }
+        }
+        bits = bits << 1 | (sum > count * (kBlack + kWhite) / 2 ? 1 : 0);
+    }
+    const uint32_t value = static_cast<uint32_t>(bits >> 32);
+    if (static_cast<uint32_t>(bits) != uint32_t{~value}) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+}  // namespace video_barcode
+
+// A video source that renders I420 frames on its own thread at a fixed rate:
+// a moving gradient, so encoders have motion to work on, with a capture-time
+// barcode. Frames are rendered directly at the size the sinks ask for
+// (AdaptFrame), so CPU or bandwidth adaptation needs no scaling pass.
+class SyntheticVideoSource : public webrtc::AdaptedVideoTrackSource {
+public:
+    struct Options {
+        int width = 1280;
+        int height = 720;
+        int fps = 30;
+    };
+
+    static webrtc::scoped_refptr<SyntheticVideoSource> Create(const Options& options) {
+        return webrtc::make_ref_counted<SyntheticVideoSource>(options);
+    }
+
+    void Start() {
+        thread_->PostTask([this] {
+            stopped_ = false;
+            start_us_ = webrtc::TimeMicros();
+            frame_index_ = 0;
+            Tick();
+        });
+    }
+
+    // Returns once no frame is being delivered.
+    void Stop() {
+        thread_->BlockingCall([this] { stopped_ = true; });
+    }
+
+    uint64_t frames_generated() const { return frames_generated_.load(std::memory_order_relaxed); }
+
+    // VideoTrackSourceInterface implementation
+    SourceState state() const override { return kLive; }
+    bool remote() const override { return false; }
+    bool is_screencast() const override { return false; }
+    std::optional<bool> needs_denoising() const override { return false; }
+
+protected:
+    explicit SyntheticVideoSource(const Options& options)
+        : options_(options), thread_(webrtc::Thread::Create()), buffer_pool_(false) {
+        thread_->SetName("video-source", nullptr);
+        thread_->Start();
+    }
+
+    ~SyntheticVideoSource() override {
+        Stop();
+        thread_->Stop();
+    }
+
+private:
+    // Runs on |thread_|.
+    void Tick() {
+        if (stopped_) {
+            return;
+        }
+        const int64_t now_us = webrtc::TimeMicros();
+        int width = 0;
+        int height = 0;
+        int crop_width = 0;
+        int crop_height = 0;
+        int crop_x = 0;
+        int crop_y = 0;
+        if (AdaptFrame(options_.width, options_.height, now_us, &width, &height, &crop_width, &crop_height, &crop_x,
+                       &crop_y)) {
+            webrtc::scoped_refptr<webrtc::I420Buffer> buffer = buffer_pool_.CreateI420Buffer(width, height);
+            if (buffer) {
+                Render(*buffer, now_us);
+                OnFrame(webrtc::VideoFrame::Builder()
+                            .set_video_frame_buffer(buffer)
+                            .set_timestamp_us(now_us)
+                            .set_rotation(webrtc::kVideoRotation_0)
+                            .build());
+                frames_generated_.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        // Scheduled from the start time, so delivery jitter does not add up.
+        ++frame_index_;
+        const int64_t next_us = start_us_ + frame_index_ * 1000000 / options_.fps;
+        thread_->PostDelayedHighPrecisionTask([this] { Tick(); },
+                                              webrtc::TimeDelta::Micros(std::max<int64_t>(0, next_us - now_us)));
+    }
+
+    void Render(webrtc::I420Buffer& buffer, int64_t capture_us) {
+        const int shift = static_cast<int>(frame_index_ * 2);
+        for (int y = 0; y < buffer.height(); ++y) {
+            uint8_t* row = buffer.MutableDataY() + y * buffer.StrideY();
+            for (int x = 0; x < buffer.width(); ++x) {
+                row[x] = static_cast<uint8_t>(x + y + shift);
+            }
+        }
+        const int chroma_height = (buffer.height() + 1) / 2;
+        const int chroma_width = (buffer.width() + 1) / 2;
+        for (int y = 0; y < chroma_height; ++y) {
+            std::memset(buffer.MutableDataU() + y * buffer.StrideU(), static_cast<uint8_t>(128 + y - shift), chroma_width);
+            std::memset(buffer.MutableDataV() + y * buffer.StrideV(), static_cast<uint8_t>(128 - y + shift), chroma_width);
+        }
+        if (const int block = video_barcode::BlockSize(buffer.width(), buffer.height())) {
+            video_barcode::Write(buffer.MutableDataY(), buffer.StrideY(), block, static_cast<uint32_t>(capture_us));
+        }
+    }
+
+    const Options options_;
+    const std::unique_ptr<webrtc::Thread> thread_;
+
+    // |thread_| only.
+    webrtc::VideoFrameBufferPool buffer_pool_;
+    bool stopped_ = true;
+    int64_t start_us_ = 0;
+    int64_t frame_index_ = 0;
+
+    std::atomic<uint64_t> frames_generated_{0};
+};
+
+// Counts decoded frames and reads the capture-time barcode to measure
+// end-to-end latency. Frames arrive on the receive stream's decode thread.
+class SyntheticVideoSink : public webrtc::VideoSinkInterface<webrtc::VideoFrame> {
+public:
+    void OnFrame(const webrtc::VideoFrame& frame) override {
+        const int64_t now_us = webrtc::TimeMicros();
+        std::optional<uint32_t> capture_us;
+        webrtc::scoped_refptr<webrtc::I420BufferInterface> buffer = frame.video_frame_buffer()->ToI420();
+        if (buffer) {
+            if (const int block = video_barcode::BlockSize(buffer->width(), buffer->height())) {
+                capture_us = video_barcode::Read(buffer->DataY(), buffer->StrideY(), block);
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++frames_;
+        if (!capture_us) {
+            ++unreadable_;
+            return;
+        }
+        // Wraps every ~71 minutes; unsigned subtraction handles that.
+        latency_ms_.Add(static_cast<uint32_t>(now_us - *capture_us) / 1000.0);
+    }
+
+    // Starts a new measurement window.
+    void Reset() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        frames_ = 0;
+        unreadable_ = 0;
+        latency_ms_ = LatencyStats();
+    }
+
+    uint64_t frames() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return frames_;
+    }
+    uint64_t unreadable() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return unreadable_;
+    }
+    // Copies the samples of the current window into |out|.
+    void AppendLatency(LatencyStats& out) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        out.Append(latency_ms_);
+    }
+
+private:
+    std::mutex mutex_;
+    uint64_t frames_ = 0;
+    uint64_t unreadable_ = 0;
+    LatencyStats latency_ms_;
+};
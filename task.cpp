@@ -0,0 +1 @@
+#include "task.h"
\ No newline at end of file
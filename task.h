@@ -0,0 +1,103 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+#include <rtc_base/event.h>
+
+// Lazily started coroutine returning a single value. Awaiting a Task starts it
+// and resumes the awaiting coroutine on whichever thread finishes the Task,
+// which for handshake steps is the WebRTC thread that fired the callback.
+template <typename T>
+class Task {
+public:
+    struct promise_type {
+        std::optional<T> value;
+        std::coroutine_handle<> continuation;
+
+        Task get_return_object() {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        auto final_suspend() noexcept {
+            struct FinalAwaiter {
+                bool await_ready() const noexcept { return false; }
+
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+                    if (std::coroutine_handle<> continuation = handle.promise().continuation) {
+                        return continuation;
+                    }
+                    return std::noop_coroutine();
+                }
+
+                void await_resume() const noexcept {}
+            };
+            return FinalAwaiter{};
+        }
+
+        void return_value(T result) { value.emplace(std::move(result)); }
+
+        // Built with -fno-exceptions, so nothing can actually be thrown here.
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    Task(Task&& other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() {
+        if (handle_) {
+            handle_.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept { return false; }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        handle_.promise().continuation = awaiting;
+        return handle_;
+    }
+
+    T await_resume() { return std::move(*handle_.promise().value); }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+
+    std::coroutine_handle<promise_type> handle_;
+};
+
+// Fire-and-forget coroutine used to drive a Task from non-coroutine code.
+struct DetachedTask {
+    struct promise_type {
+        DetachedTask get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+// Starts |task| immediately and hands its result to |on_done| on the thread
+// that completes it.
+template <typename T, typename Callback>
+DetachedTask StartDetached(Task<T> task, Callback on_done) {
+    on_done(co_await std::move(task));
+}
+
+// Blocks the calling thread until |task| completes. Never call this from a
+// WebRTC thread the task itself needs to make progress.
+template <typename T>
+T SyncWait(Task<T> task) {
+    webrtc::Event done;
+    std::optional<T> result;
+    StartDetached(std::move(task), [&result, &done](T value) {
+        result.emplace(std::move(value));
+        done.Set();
+    });
+    done.Wait(webrtc::Event::kForever);
+    return std::move(*result);
+}
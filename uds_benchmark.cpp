@@ -0,0 +1 @@
+#include "uds_benchmark.h"
\ No newline at end of file
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <api/data_channel_interface.h>
+#include <api/peer_connection_interface.h>
+#include <api/rtc_error.h>
+
+#include "async_log.h"
+#include "factory_pool.h"
+#include "handshake_limiter.h"
+#include "latency_stats.h"
+#include "local_signaling.h"
+#include "loopback_pair.h"
+#include "process_stats.h"
+#include "task.h"
+#include "uds_signaling.h"
+#include "uds_signaling_server.h"
+
+struct UdsOptions {
+    int pairs = 100;
+    // Handshakes allowed in flight at once.
+    int concurrency = 8;
+    // Empty: a socket under /tmp named after this process.
+    std::string socket_path;
+};
+
+// Runs the same loopback handshakes once through LocalSignaling and once
+// with each peer signaling through its own UdsSignalingClient and an
+// in-process UdsSignalingServer, so the difference is the socket hops and
+// the SDP text encoding. Reports handshakes per second, setup latency and
+// process CPU per handshake.
+class UdsBenchmark {
+public:
+    UdsBenchmark(PeerConnectionFactoryPool* pool,
+                 webrtc::PeerConnectionInterface::RTCConfiguration config,
+                 UdsOptions options)
+        : pool_(pool), config_(config), options_(options) {
+        config_.servers.clear();
+        if (options_.socket_path.empty()) {
+            options_.socket_path = "/tmp/webrtc-signaling-" + std::to_string(getpid()) + ".sock";
+        }
+    }
+
+    int Run() {
+        std::unique_ptr<UdsSignalingServer> server = UdsSignalingServer::Create(options_.socket_path);
+        if (!server) {
+            return -1;
+        }
+
+        std::cout << "UDS mode: " << options_.pairs << " handshakes per transport, concurrency "
+                  << HandshakeLimiter::Clamp(options_.concurrency) << ", socket " << server->path() << std::endl;
+        std::cout << std::setw(10) << "signaling" << std::setw(14) << "handshakes/s" << std::setw(10) << "p50 ms"
+                  << std::setw(10) << "p99 ms" << std::setw(12) << "process ms" << std::setw(10) << "failures"
+                  << std::endl;
+
+        const bool local_ok = RunOne("local", nullptr);
+        const bool uds_ok = RunOne("uds", server.get());
+        std::cout << "Server: " << server->frames_relayed() << " frames relayed, " << server->frames_dropped()
+                  << " dropped" << std::endl;
+        return local_ok && uds_ok ? 0 : -1;
+    }
+
+private:
+    // Both ends of one pair, plus their clients when signaling over UDS.
+    struct Session {
+        std::unique_ptr<LoopbackPair> pair;
+        webrtc::scoped_refptr<UdsSignalingClient> client1;
+        webrtc::scoped_refptr<UdsSignalingClient> client2;
+    };
+
+    // Counts the halves of a UDS handshake; the pair is done when both are.
+    struct HalfJoin {
+        std::mutex mutex;
+        int remaining = 2;
+        webrtc::RTCError error;
+    };
+
+    bool RunOne(const char* name, UdsSignalingServer* server) {
+        webrtc::DataChannelInit dc_config;
+        dc_config.ordered = true;
+
+        std::vector<Session> sessions;
+        sessions.reserve(options_.pairs);
+        HandshakeLimiter limiter(options_.concurrency, options_.pairs);
+
+        // Per-peer logging is kept to warnings while the pairs are set up.
+        ScopedLogLevel quiet(LogLevel::kWarning);
+
+        const double process_before = ProcessStats::CpuSeconds();
+        const auto run_start = std::chrono::steady_clock::now();
+
+        for (int i = 0; i < options_.pairs; ++i) {
+            const HandshakeLimiter::Clock::time_point setup_start = limiter.Acquire();
+            auto done = [&limiter, setup_start](webrtc::RTCError error) { limiter.Release(setup_start, error.ok()); };
+
+            auto pair_result = LoopbackPair::Create(pool_->Acquire(), pool_->Acquire(), config_,
+                                                    std::string(name) + std::to_string(i) + ".Peer", dc_config);
+            if (!pair_result.ok()) {
+                done(pair_result.MoveError());
+                continue;
+            }
+            sessions.push_back({pair_result.MoveValue(), nullptr, nullptr});
+            Session& session = sessions.back();
+
+            if (!server) {
+                StartDetached(session.pair->Connect(HandshakeTimeouts()), done);
+                continue;
+            }
+            const uint32_t id1 = 2 * i + 1;
+            const uint32_t id2 = 2 * i + 2;
+            session.client1 = UdsSignalingClient::Connect(server->path(), id1);
+            session.client2 = UdsSignalingClient::Connect(server->path(), id2);
+            if (!session.client1 || !session.client2) {
+                done(webrtc::RTCError(webrtc::RTCErrorType::NETWORK_ERROR, "Failed to connect to the server"));
+                continue;
+            }
+            auto join = std::make_shared<HalfJoin>();
+            auto half_done = [join, done](webrtc::RTCError error) {
+                std::unique_lock<std::mutex> lock(join->mutex);
+                if (!error.ok() && join->error.ok()) {
+                    join->error = error;
+                }
+                if (--join->remaining > 0) {
+                    return;
+                }
+                webrtc::RTCError result = join->error;
+                lock.unlock();
+                done(result);
+            };
+            // The answerer starts first and waits for the offer, as a peer in
+            // another process would.
+            StartDetached(UdsSignaling::Connect(session.pair->answerer(), session.client2, id1, false,
+                                                HandshakeTimeouts()),
+                          half_done);
+            StartDetached(UdsSignaling::Connect(session.pair->offerer(), session.client1, id2, true,
+                                                HandshakeTimeouts()),
+                          half_done);
+        }
+        limiter.WaitForAll();
+
+        const double wall_seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - run_start).count();
+        const double process = ProcessStats::CpuSeconds() - process_before;
+
+        // Detach the candidate sinks so no PeerConnection thread writes to a
+        // closing client, then stop the readers so nothing pushes candidates
+        // into a closing PeerConnection.
+        for (Session& session : sessions) {
+            session.pair->observer1()->SetIceCandidateRelay(nullptr);
+            session.pair->observer2()->SetIceCandidateRelay(nullptr);
+            if (session.client1) {
+                session.client1->Close();
+            }
+            if (session.client2) {
+                session.client2->Close();
+            }
+            session.pair->Close();
+        }
+
+        LatencyStats& setup_ms = limiter.setup_ms();
+        std::cout << std::fixed << std::setprecision(2) << std::setw(10) << name << std::setw(14)
+                  << setup_ms.count() / wall_seconds << std::setw(10) << setup_ms.Percentile(50) << std::setw(10)
+                  << setup_ms.Percentile(99) << std::setprecision(3) << std::setw(12)
+                  << process * 1000.0 / options_.pairs << std::setw(10) << limiter.failed() << std::defaultfloat
+                  << std::endl;
+        return limiter.failed() == 0;
+    }
+
+    PeerConnectionFactoryPool* pool_;
+    webrtc::PeerConnectionInterface::RTCConfiguration config_;
+    UdsOptions options_;
+};
@@ -0,0 +1 @@
+#include "uds_signaling.h"
\ No newline at end of file
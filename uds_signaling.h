@@ -0,0 +1,356 @@
+#pragma once
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <api/jsep.h>
+#include <api/peer_connection_interface.h>
+#include <api/ref_count.h>
+#include <api/rtc_error.h>
+#include <api/scoped_refptr.h>
+
+#include "async_handshake.h"
+#include "async_log.h"
+#include "completion_signal.h"
+#include "handshake_trace.h"
+#include "ice_candidate_relay.h"
+#include "local_signaling.h"
+#include "signaling_wire.h"
+#include "simple_peer_connection_observer.h"
+#include "task.h"
+
+// One peer's connection to a UdsSignalingServer, for a single handshake. A
+// reader thread decodes incoming frames: the remote description is parsed
+// there (off the signaling thread) and latched for the handshake, and
+// candidates go to the relay set with SetCandidateRelay(), or are held until
+// it is set.
+//
+// Close() (or the destructor) stops the reader; do not drop the last
+// reference from a callback running on it. Send() fails once it has closed,
+// but detach the observer's candidate sink first anyway.
+class UdsSignalingClient : public webrtc::RefCountInterface {
+public:
+    static webrtc::scoped_refptr<UdsSignalingClient> Connect(const std::string& path, uint32_t id) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (id == 0 || path.size() >= sizeof(address.sun_path)) {
+            return nullptr;
+        }
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+        const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            return nullptr;
+        }
+        if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            ASYNC_LOG(kError, {}, "Failed to connect to signaling server", nullptr, std::strerror(errno));
+            close(fd);
+            return nullptr;
+        }
+        auto client = webrtc::make_ref_counted<UdsSignalingClient>(fd, id);
+        signaling_wire::Message hello;
+        hello.type = signaling_wire::MessageType::kRegister;
+        if (!client->Send(hello)) {
+            return nullptr;
+        }
+        client->reader_ = std::thread([raw = client.get()] { raw->ReadLoop(); });
+        return client;
+    }
+
+    uint32_t id() const { return id_; }
+
+    // Stamps |message| with this peer's id and writes it. Callable from any
+    // thread; frames are small, so a blocking write is fine.
+    bool Send(signaling_wire::Message message) {
+        message.from = id_;
+        std::string frame;
+        if (!signaling_wire::AppendFrame(message, frame)) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        if (fd_ < 0) {
+            return false;
+        }
+        for (size_t offset = 0; offset < frame.size();) {
+            const ssize_t sent = send(fd_, frame.data() + offset, frame.size() - offset, MSG_NOSIGNAL);
+            if (sent < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            offset += sent;
+        }
+        return true;
+    }
+
+    // Resolved when the remote offer or answer has arrived and parsed (or
+    // failed to parse, or the connection dropped first).
+    CompletionSignal& DescriptionArrived() { return description_arrived_; }
+
+    std::unique_ptr<webrtc::SessionDescriptionInterface> TakeDescription() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return std::move(description_);
+    }
+
+    // Hands over any candidates that arrived before the relay existed.
+    void SetCandidateRelay(webrtc::scoped_refptr<IceCandidateRelay> relay) {
+        std::vector<std::unique_ptr<webrtc::IceCandidateInterface>> early;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            candidate_relay_ = relay;
+            early.swap(early_candidates_);
+        }
+        for (auto& candidate : early) {
+            relay->Push(std::move(candidate));
+        }
+    }
+
+    void Close() {
+        if (fd_ >= 0) {
+            shutdown(fd_, SHUT_RDWR);
+        }
+        if (reader_.joinable()) {
+            reader_.join();
+        }
+        {
+            // Send() may be running on a PeerConnection thread.
+            std::lock_guard<std::mutex> lock(write_mutex_);
+            if (fd_ >= 0) {
+                close(fd_);
+                fd_ = -1;
+            }
+        }
+        description_arrived_.Resolve(
+            webrtc::RTCError(webrtc::RTCErrorType::NETWORK_ERROR, "Signaling connection closed"));
+    }
+
+protected:
+    UdsSignalingClient(int fd, uint32_t id) : fd_(fd), id_(id) {}
+    ~UdsSignalingClient() override { Close(); }
+
+private:
+    static constexpr size_t kReadChunk = 16 * 1024;
+
+    void ReadLoop() {
+        signaling_wire::FrameReader reader;
+        while (true) {
+            char* buffer = reader.Prepare(kReadChunk);
+            const ssize_t received = recv(fd_, buffer, kReadChunk, 0);
+            if (received < 0 && errno == EINTR) {
+                reader.Commit(0);
+                continue;
+            }
+            if (received <= 0) {
+                break;
+            }
+            reader.Commit(received);
+            for (std::string_view frame = reader.Next(); !frame.empty(); frame = reader.Next()) {
+                signaling_wire::Message message;
+                if (signaling_wire::DecodeFrame(frame, message)) {
+                    Dispatch(std::move(message));
+                }
+            }
+            if (reader.malformed()) {
+                break;
+            }
+        }
+        description_arrived_.Resolve(
+            webrtc::RTCError(webrtc::RTCErrorType::NETWORK_ERROR, "Signaling connection closed"));
+    }
+
+    void Dispatch(signaling_wire::Message message) {
+        switch (message.type) {
+            case signaling_wire::MessageType::kOffer:
+            case signaling_wire::MessageType::kAnswer: {
+                const webrtc::SdpType type = message.type == signaling_wire::MessageType::kOffer
+                                                 ? webrtc::SdpType::kOffer
+                                                 : webrtc::SdpType::kAnswer;
+                webrtc::SdpParseError error;
+                std::unique_ptr<webrtc::SessionDescriptionInterface> description =
+                    webrtc::CreateSessionDescription(type, message.body, &error);
+                if (!description) {
+                    description_arrived_.Resolve(webrtc::RTCError(
+                        webrtc::RTCErrorType::INVALID_PARAMETER, "Bad remote SDP: " + error.description));
+                    return;
+                }
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    description_ = std::move(description);
+                }
+                description_arrived_.Resolve(webrtc::RTCError::OK());
+                return;
+            }
+            case signaling_wire::MessageType::kCandidate: {
+                webrtc::SdpParseError error;
+                std::unique_ptr<webrtc::IceCandidateInterface> candidate(
+                    webrtc::CreateIceCandidate(message.mid, message.mline_index, message.body, &error));
+                if (!candidate) {
+                    ASYNC_LOG(kWarning, {}, "Bad remote candidate", nullptr, error.description);
+                    return;
+                }
+                webrtc::scoped_refptr<IceCandidateRelay> relay;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (!candidate_relay_) {
+                        early_candidates_.push_back(std::move(candidate));
+                        return;
+                    }
+                    relay = candidate_relay_;
+                }
+                relay->Push(std::move(candidate));
+                return;
+            }
+            default:
+                return;
+        }
+    }
+
+    int fd_;
+    const uint32_t id_;
+    std::mutex write_mutex_;
+    std::thread reader_;
+
+    std::mutex mutex_;
+    std::unique_ptr<webrtc::SessionDescriptionInterface> description_;
+    webrtc::scoped_refptr<IceCandidateRelay> candidate_relay_;
+    std::vector<std::unique_ptr<webrtc::IceCandidateInterface>> early_candidates_;
+    CompletionSignal description_arrived_;
+};
+
+// Sends a peer's gathered candidates to |remote_id| through the server.
+class WireCandidateSink : public IceCandidateSink {
+public:
+    static webrtc::scoped_refptr<WireCandidateSink> Create(webrtc::scoped_refptr<UdsSignalingClient> client,
+                                                           uint32_t remote_id) {
+        return webrtc::make_ref_counted<WireCandidateSink>(client, remote_id);
+    }
+
+    void Push(std::unique_ptr<webrtc::IceCandidateInterface> candidate) override {
+        signaling_wire::Message message;
+        message.type = signaling_wire::MessageType::kCandidate;
+        message.to = remote_id_;
+        message.mid = candidate->sdp_mid();
+        message.mline_index = candidate->sdp_mline_index();
+        candidate->ToString(&message.body);
+        if (!client_->Send(std::move(message))) {
+            ASYNC_LOG(kWarning, {}, "Failed to send candidate");
+        }
+    }
+
+protected:
+    WireCandidateSink(webrtc::scoped_refptr<UdsSignalingClient> client, uint32_t remote_id)
+        : client_(client), remote_id_(remote_id) {}
+    ~WireCandidateSink() override = default;
+
+private:
+    webrtc::scoped_refptr<UdsSignalingClient> client_;
+    const uint32_t remote_id_;
+};
+
+// The LocalSignaling handshake for a peer whose counterpart may live in
+// another process: descriptions and candidates travel through a
+// UdsSignalingServer as SDP text instead of being handed over in memory.
+class UdsSignaling {
+public:
+    // Runs this peer's half of offer/answer with |remote_id| and completes
+    // once it reports kConnected. The answerer waits up to
+    // |timeouts.connection| for the offer, since the offerer may start later.
+    static Task<webrtc::RTCError> Connect(PeerEndpoint self,
+                                          webrtc::scoped_refptr<UdsSignalingClient> client,
+                                          uint32_t remote_id,
+                                          bool offerer,
+                                          HandshakeTimeouts timeouts) {
+        using namespace async_handshake;
+
+        if (!timeouts.timer) {
+            timeouts.timer = self.signaling_thread;
+        }
+        auto remote_candidates = IceCandidateRelay::Create(self.observer->name() + "<-wire", self.pc,
+                                                           self.signaling_thread);
+        client->SetCandidateRelay(remote_candidates);
+        self.observer->SetIceCandidateRelay(WireCandidateSink::Create(client, remote_id));
+
+        const uint32_t track = self.observer->trace_track();
+        TraceSpan handshake(track, "handshake");
+        webrtc::RTCError error;
+        if (!offerer) {
+            TraceSpan wait_offer(track, "wait for offer");
+            error = co_await Signal("Remote offer", client->DescriptionArrived(), timeouts.timer, timeouts.connection);
+            if (!error.ok()) {
+                co_return error;
+            }
+            wait_offer.End();
+            // Descriptions arrive on the client's reader thread; the steps
+            // run on the PeerConnection's signaling thread, as in
+            // LocalSignaling.
+            co_await ResumeOn(self.signaling_thread);
+            TraceSpan set_remote_offer(track, "set remote offer");
+            error = co_await SetRemote(self.pc, client->TakeDescription(), timeouts.timer, timeouts.sdp_step);
+            if (!error.ok()) {
+                co_return error;
+            }
+            set_remote_offer.End();
+            remote_candidates->SetRemoteReady();
+        }
+
+        co_await ResumeOn(self.signaling_thread);
+        TraceSpan create_local(track, offerer ? "create offer" : "create answer");
+        SdpResult local = offerer ? co_await CreateOffer(self.pc, timeouts.timer, timeouts.sdp_step)
+                                  : co_await CreateAnswer(self.pc, timeouts.timer, timeouts.sdp_step);
+        if (!local.ok()) {
+            co_return local.MoveError();
+        }
+        create_local.End();
+        signaling_wire::Message message;
+        message.type = offerer ? signaling_wire::MessageType::kOffer : signaling_wire::MessageType::kAnswer;
+        message.to = remote_id;
+        local.value()->ToString(&message.body);
+
+        TraceSpan set_local(track, offerer ? "set local offer" : "set local answer");
+        error = co_await SetLocal(self.pc, local.MoveValue(), timeouts.timer, timeouts.sdp_step);
+        if (!error.ok()) {
+            co_return error;
+        }
+        set_local.End();
+        if (!client->Send(std::move(message))) {
+            co_return webrtc::RTCError(webrtc::RTCErrorType::NETWORK_ERROR, "Failed to send local description");
+        }
+
+        if (offerer) {
+            TraceSpan wait_answer(track, "wait for answer");
+            error = co_await Signal("Remote answer", client->DescriptionArrived(), timeouts.timer, timeouts.sdp_step);
+            if (!error.ok()) {
+                co_return error;
+            }
+            wait_answer.End();
+            co_await ResumeOn(self.signaling_thread);
+            TraceSpan set_remote_answer(track, "set remote answer");
+            error = co_await SetRemote(self.pc, client->TakeDescription(), timeouts.timer, timeouts.sdp_step);
+            if (!error.ok()) {
+                co_return error;
+            }
+            set_remote_answer.End();
+            remote_candidates->SetRemoteReady();
+        }
+
+        co_return co_await Connected(*self.observer, timeouts.timer, timeouts.connection);
+    }
+
+    // Completes once |observer| has received its first data channel message.
+    static Task<webrtc::RTCError> AwaitFirstMessage(SimplePeerConnectionObserver* observer,
+                                                    HandshakeTimeouts timeouts) {
+        co_return co_await async_handshake::FirstMessage(*observer, timeouts.timer, timeouts.first_message);
+    }
+};
@@ -0,0 +1 @@
+#include "uds_signaling_server.h"
\ No newline at end of file
@@ -0,0 +1,347 @@
+#pragma once
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+#include "signaling_wire.h"
+
+// Relays signaling frames between peers in other processes over a Unix
+// domain socket. Each peer connects, sends kRegister with its id in |from|,
+// and from then on receives every frame addressed to that id. Frames for an
+// id that has not registered yet are held (up to kMaxPendingFrames per id and
+// kMaxPendingBytes in all) and delivered when it does; a sender's held frames
+// are dropped when it disconnects.
+//
+// One thread runs a level-triggered epoll loop over non-blocking sockets, so
+// thousands of idle peers cost a file descriptor and a small struct each.
+// Frames are forwarded as received; only the fixed header is read.
+class UdsSignalingServer {
+public:
+    static std::unique_ptr<UdsSignalingServer> Create(const std::string& path) {
+        std::unique_ptr<UdsSignalingServer> server(new UdsSignalingServer(path));
+        if (!server->Listen()) {
+            return nullptr;
+        }
+        server->thread_ = std::thread([raw = server.get()] { raw->Loop(); });
+        return server;
+    }
+
+    ~UdsSignalingServer() {
+        if (thread_.joinable()) {
+            const uint64_t one = 1;
+            [[maybe_unused]] ssize_t written = write(wake_fd_, &one, sizeof(one));
+            thread_.join();
+        }
+        for (auto& [fd, connection] : connections_) {
+            close(fd);
+        }
+        if (listen_fd_ >= 0) {
+            close(listen_fd_);
+            unlink(path_.c_str());
+        }
+        if (wake_fd_ >= 0) {
+            close(wake_fd_);
+        }
+        if (epoll_fd_ >= 0) {
+            close(epoll_fd_);
+        }
+    }
+
+    const std::string& path() const { return path_; }
+
+    int connections() const { return connection_count_.load(std::memory_order_relaxed); }
+    uint64_t frames_relayed() const { return frames_relayed_.load(std::memory_order_relaxed); }
+    uint64_t frames_dropped() const { return frames_dropped_.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr size_t kMaxPendingFrames = 64;
+    static constexpr size_t kMaxPendingBytes = 4 * 1024 * 1024;
+    // Frames for a peer that stops reading are dropped past this backlog.
+    static constexpr size_t kMaxOutgoingBytes = 4 * 1024 * 1024;
+    static constexpr size_t kReadChunk = 64 * 1024;
+    static constexpr int kMaxEvents = 256;
+
+    struct Connection {
+        int fd = -1;
+        // 0 until the peer registers.
+        uint32_t id = 0;
+        signaling_wire::FrameReader reader;
+        std::string outgoing;
+        size_t outgoing_offset = 0;
+        bool want_write = false;
+    };
+
+    // A frame held for a peer that has not registered yet.
+    struct PendingFrame {
+        uint32_t from;
+        std::string frame;
+    };
+
+    explicit UdsSignalingServer(const std::string& path) : path_(path) {}
+
+    bool Listen() {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (path_.size() >= sizeof(address.sun_path)) {
+            std::cerr << "Signaling socket path too long: " << path_ << std::endl;
+            return false;
+        }
+        std::memcpy(address.sun_path, path_.c_str(), path_.size() + 1);
+        // A stale socket file from an earlier run would make bind() fail.
+        unlink(path_.c_str());
+
+        listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listen_fd_ < 0 || bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            listen(listen_fd_, SOMAXCONN) != 0) {
+            std::cerr << "Failed to listen on " << path_ << ": " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+        wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epoll_fd_ < 0 || wake_fd_ < 0 || !Watch(listen_fd_, EPOLLIN) || !Watch(wake_fd_, EPOLLIN)) {
+            std::cerr << "Failed to set up epoll: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool Watch(int fd, uint32_t events) {
+        epoll_event event{};
+        event.events = events;
+        event.data.fd = fd;
+        return epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) == 0;
+    }
+
+    void Loop() {
+        epoll_event events[kMaxEvents];
+        while (true) {
+            const int count = epoll_wait(epoll_fd_, events, kMaxEvents, -1);
+            if (count < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                std::cerr << "epoll_wait failed: " << std::strerror(errno) << std::endl;
+                return;
+            }
+            for (int i = 0; i < count; ++i) {
+                const int fd = events[i].data.fd;
+                if (fd == wake_fd_) {
+                    return;
+                }
+                if (fd == listen_fd_) {
+                    Accept();
+                    continue;
+                }
+                auto it = connections_.find(fd);
+                if (it == connections_.end()) {
+                    continue;
+                }
+                Connection& connection = *it->second;
+                bool open = true;
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                    open = Read(connection);
+                }
+                if (open && (events[i].events & EPOLLOUT)) {
+                    open = Flush(connection);
+                }
+                if (!open) {
+                    Disconnect(fd);
+                }
+            }
+        }
+    }
+
+    void Accept() {
+        while (true) {
+            const int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                    std::cerr << "accept failed: " << std::strerror(errno) << std::endl;
+                }
+                return;
+            }
+            if (!Watch(fd, EPOLLIN)) {
+                close(fd);
+                continue;
+            }
+            auto connection = std::make_unique<Connection>();
+            connection->fd = fd;
+            connections_[fd] = std::move(connection);
+            connection_count_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // One recv() per wakeup; level-triggered epoll reports the socket again
+    // if more is waiting, so a chatty peer cannot starve the others.
+    // Returns false once the connection should be closed.
+    bool Read(Connection& connection) {
+        char* buffer = connection.reader.Prepare(kReadChunk);
+        const ssize_t received = recv(connection.fd, buffer, kReadChunk, 0);
+        if (received == 0) {
+            return false;
+        }
+        if (received < 0) {
+            connection.reader.Commit(0);
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+        connection.reader.Commit(received);
+        for (std::string_view frame = connection.reader.Next(); !frame.empty(); frame = connection.reader.Next()) {
+            if (!Route(connection, frame)) {
+                return false;
+            }
+        }
+        return !connection.reader.malformed();
+    }
+
+    bool Route(Connection& connection, std::string_view frame) {
+        const signaling_wire::Route route = signaling_wire::ReadRoute(frame);
+        if (route.type == signaling_wire::MessageType::kRegister) {
+            if (connection.id != 0 || route.from == 0 || peers_.count(route.from)) {
+                // Re-registering or taking another peer's id.
+                return false;
+            }
+            connection.id = route.from;
+            peers_[route.from] = &connection;
+            auto pending = pending_.find(route.from);
+            if (pending != pending_.end()) {
+                for (const PendingFrame& held : pending->second) {
+                    Enqueue(connection, held.frame);
+                    pending_bytes_ -= held.frame.size();
+                }
+                pending_.erase(pending);
+            }
+            return true;
+        }
+        // Peers may only speak for themselves.
+        if (connection.id == 0 || route.from != connection.id) {
+            return false;
+        }
+        auto peer = peers_.find(route.to);
+        if (peer != peers_.end()) {
+            Enqueue(*peer->second, frame);
+            return true;
+        }
+        std::deque<PendingFrame>& held = pending_[route.to];
+        if (held.size() >= kMaxPendingFrames || pending_bytes_ + frame.size() > kMaxPendingBytes) {
+            frames_dropped_.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            held.push_back({route.from, std::string(frame)});
+            pending_bytes_ += frame.size();
+        }
+        if (held.empty()) {
+            pending_.erase(route.to);
+        }
+        return true;
+    }
+
+    // Frames from a peer that has gone away would only confuse whoever
+    // registers under their |to| id later.
+    void DropPendingFrom(uint32_t from) {
+        for (auto it = pending_.begin(); it != pending_.end();) {
+            std::deque<PendingFrame>& held = it->second;
+            for (auto frame = held.begin(); frame != held.end();) {
+                if (frame->from == from) {
+                    pending_bytes_ -= frame->frame.size();
+                    frames_dropped_.fetch_add(1, std::memory_order_relaxed);
+                    frame = held.erase(frame);
+                } else {
+                    ++frame;
+                }
+            }
+            it = held.empty() ? pending_.erase(it) : std::next(it);
+        }
+    }
+
+    void Enqueue(Connection& connection, std::string_view frame) {
+        if (connection.outgoing.size() - connection.outgoing_offset + frame.size() > kMaxOutgoingBytes) {
+            frames_dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        connection.outgoing.append(frame);
+        frames_relayed_.fetch_add(1, std::memory_order_relaxed);
+        // Try to write right away; a write error shows up as EPOLLERR/EPOLLHUP
+        // on the next wait.
+        if (!connection.want_write) {
+            Flush(connection);
+        }
+    }
+
+    // Writes as much as the socket takes and watches for EPOLLOUT while
+    // anything is left. Returns false on a write error.
+    bool Flush(Connection& connection) {
+        while (connection.outgoing_offset < connection.outgoing.size()) {
+            const ssize_t sent = send(connection.fd, connection.outgoing.data() + connection.outgoing_offset,
+                                      connection.outgoing.size() - connection.outgoing_offset, MSG_NOSIGNAL);
+            if (sent < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    return false;
+                }
+                break;
+            }
+            connection.outgoing_offset += sent;
+        }
+        if (connection.outgoing_offset == connection.outgoing.size()) {
+            connection.outgoing.clear();
+            connection.outgoing_offset = 0;
+        }
+        const bool want_write = !connection.outgoing.empty();
+        if (want_write != connection.want_write) {
+            epoll_event event{};
+            event.events = want_write ? EPOLLIN | EPOLLOUT : EPOLLIN;
+            event.data.fd = connection.fd;
+            epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, connection.fd, &event);
+            connection.want_write = want_write;
+        }
+        return true;
+    }
+
+    void Disconnect(int fd) {
+        auto it = connections_.find(fd);
+        if (it == connections_.end()) {
+            return;
+        }
+        if (it->second->id != 0) {
+            peers_.erase(it->second->id);
+            DropPendingFrom(it->second->id);
+        }
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+        connections_.erase(it);
+        connection_count_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    const std::string path_;
+    int listen_fd_ = -1;
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1;
+    std::thread thread_;
+
+    // Loop thread only.
+    std::unordered_map<int, std::unique_ptr<Connection>> connections_;
+    std::unordered_map<uint32_t, Connection*> peers_;
+    std::unordered_map<uint32_t, std::deque<PendingFrame>> pending_;
+    size_t pending_bytes_ = 0;
+
+    std::atomic<int> connection_count_{0};
+    std::atomic<uint64_t> frames_relayed_{0};
+    std::atomic<uint64_t> frames_dropped_{0};
+};
@@ -0,0 +1 @@
+#include "video_benchmark.h"
\ No newline at end of file
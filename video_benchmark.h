@@ -0,0 +1,225 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <api/data_channel_interface.h>
+#include <api/media_stream_interface.h>
+#include <api/peer_connection_interface.h>
+#include <api/stats/rtc_stats_report.h>
+#include <api/stats/rtcstats_objects.h>
+#include <api/transport/bitrate_settings.h>
+#include <api/units/time_delta.h>
+
+#include "async_log.h"
+#include "factory_pool.h"
+#include "latency_stats.h"
+#include "loopback_pair.h"
+#include "process_stats.h"
+#include "stats_collector.h"
+#include "synthetic_video.h"
+#include "task.h"
+#include "video_codec_config.h"
+
+struct VideoOptions {
+    // SDP codec names, run in this order; by default every codec in the build.
+    std::vector<std::string> codecs = video_codec_config::Names();
+    SyntheticVideoSource::Options source;
+    // Video tracks sent over the one pair.
+    int streams = 1;
+    // Start the bandwidth estimate here instead of ramping up from the
+    // default, so short runs encode at the target quality.
+    int start_bitrate_kbps = 2000;
+    webrtc::TimeDelta warmup = webrtc::TimeDelta::Seconds(2);
+    webrtc::TimeDelta duration = webrtc::TimeDelta::Seconds(5);
+};
+
+// Sends VideoOptions::streams synthetic video tracks over a loopback pair,
+// once per codec, and reports encode rate and time per frame (from
+// GetStats), decode time, capture-to-render latency and process CPU per
+// stream. All streams are encoded and decoded in this process, so the CPU
+// figure covers both ends plus frame generation.
+class VideoBenchmark {
+public:
+    VideoBenchmark(PeerConnectionFactoryPool* pool,
+                   webrtc::PeerConnectionInterface::RTCConfiguration config,
+                   VideoOptions options)
+        : pool_(pool), config_(config), options_(options) {
+        config_.servers.clear();
+    }
+
+    int Run() {
+        std::cout << "Video mode: " << options_.streams << " stream(s) of " << options_.source.width << "x"
+                  << options_.source.height << "@" << options_.source.fps << " per codec, "
+                  << options_.duration.ms() << " ms each" << std::endl;
+        std::cout << std::setw(6) << "codec" << std::setw(12) << "encoded" << std::setw(10) << "enc fps"
+                  << std::setw(10) << "enc ms" << std::setw(10) << "dec ms" << std::setw(10) << "e2e p50"
+                  << std::setw(10) << "e2e p99" << std::setw(12) << "CPU/stream" << std::setw(14) << "streams/core"
+                  << "  encoder" << std::endl;
+
+        bool ok = true;
+        for (const std::string& codec : options_.codecs) {
+            ok = RunOne(codec) && ok;
+        }
+        return ok ? 0 : -1;
+    }
+
+private:
+    // Video counters summed over the streams of one GetStats() report.
+    struct VideoTotals {
+        uint64_t frames_encoded = 0;
+        double encode_seconds = 0;
+        uint64_t frames_decoded = 0;
+        double decode_seconds = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::string encoder;
+    };
+
+    bool RunOne(const std::string& codec) {
+        webrtc::DataChannelInit dc_config;
+        dc_config.ordered = true;
+
+        // Declared before the pair so the tracks never deliver to a dead sink.
+        std::vector<std::unique_ptr<SyntheticVideoSink>> sinks;
+        for (int i = 0; i < options_.streams; ++i) {
+            sinks.push_back(std::make_unique<SyntheticVideoSink>());
+        }
+        std::mutex tracks_mutex;
+        std::vector<webrtc::scoped_refptr<webrtc::VideoTrackInterface>> remote_tracks;
+        std::vector<webrtc::scoped_refptr<SyntheticVideoSource>> sources;
+
+        // Per-peer logging is kept to warnings while the pair is set up and running.
+        ScopedLogLevel quiet(LogLevel::kWarning);
+
+        auto pair_result =
+            LoopbackPair::Create(pool_->Acquire(), pool_->Acquire(), config_, "Video." + codec + ".Peer", dc_config);
+        if (!pair_result.ok()) {
+            std::cerr << "Failed to create loopback pair: " << pair_result.error().message() << std::endl;
+            return false;
+        }
+        std::unique_ptr<LoopbackPair> pair = pair_result.MoveValue();
+
+        pair->observer2()->SetVideoTrackHandler(
+            [&](webrtc::scoped_refptr<webrtc::VideoTrackInterface> track) {
+                std::lock_guard<std::mutex> lock(tracks_mutex);
+                if (remote_tracks.size() < sinks.size()) {
+                    track->AddOrUpdateSink(sinks[remote_tracks.size()].get(), webrtc::VideoSinkWants());
+                    remote_tracks.push_back(track);
+                }
+            });
+
+        for (int i = 0; i < options_.streams; ++i) {
+            sources.push_back(SyntheticVideoSource::Create(options_.source));
+            auto transceiver = pair->AddVideoTrack("video" + std::to_string(i), sources.back(), codec);
+            if (!transceiver.ok()) {
+                std::cout << std::setw(6) << codec << "  skipped: " << transceiver.error().message() << std::endl;
+                pair->Close();
+                return transceiver.error().type() == webrtc::RTCErrorType::UNSUPPORTED_OPERATION;
+            }
+        }
+
+        webrtc::BitrateSettings bitrate;
+        bitrate.start_bitrate_bps = options_.start_bitrate_kbps * 1000;
+        webrtc::RTCError error = pair->offerer().pc->SetBitrate(bitrate);
+        if (!error.ok()) {
+            std::cerr << "Failed to set the start bitrate: " << error.message() << std::endl;
+        }
+
+        error = SyncWait(pair->Connect(HandshakeTimeouts()));
+        if (!error.ok()) {
+            std::cerr << codec << " pair failed to connect: " << error.message() << std::endl;
+            return false;
+        }
+        for (const auto& source : sources) {
+            source->Start();
+        }
+
+        std::this_thread::sleep_for(std::chrono::microseconds(options_.warmup.us()));
+        for (const auto& sink : sinks) {
+            sink->Reset();
+        }
+        const VideoTotals before = Collect(*pair);
+        const double cpu_before = ProcessStats::CpuSeconds();
+        const auto window_start = std::chrono::steady_clock::now();
+        std::this_thread::sleep_for(std::chrono::microseconds(options_.duration.us()));
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - window_start).count();
+        const double cpu = ProcessStats::CpuSeconds() - cpu_before;
+        const VideoTotals after = Collect(*pair);
+
+        LatencyStats latency;
+        uint64_t rendered = 0;
+        for (const auto& sink : sinks) {
+            sink->AppendLatency(latency);
+            rendered += sink->frames();
+        }
+
+        // Stop the sources first so nothing is captured into a closing
+        // PeerConnection, then detach the sinks before they go away.
+        for (const auto& source : sources) {
+            source->Stop();
+        }
+        {
+            std::lock_guard<std::mutex> lock(tracks_mutex);
+            for (size_t i = 0; i < remote_tracks.size(); ++i) {
+                remote_tracks[i]->RemoveSink(sinks[i].get());
+            }
+            remote_tracks.clear();
+        }
+        pair->Close();
+
+        const uint64_t encoded = after.frames_encoded - before.frames_encoded;
+        const uint64_t decoded = after.frames_decoded - before.frames_decoded;
+        const double cpu_per_stream = 100.0 * cpu / seconds / options_.streams;
+        std::ostringstream resolution;
+        resolution << after.width << "x" << after.height;
+        std::cout << std::fixed << std::setw(6) << codec << std::setw(12) << resolution.str() << std::setprecision(1)
+                  << std::setw(10) << encoded / seconds / options_.streams << std::setprecision(2) << std::setw(10)
+                  << (encoded ? 1000.0 * (after.encode_seconds - before.encode_seconds) / encoded : 0)
+                  << std::setw(10) << (decoded ? 1000.0 * (after.decode_seconds - before.decode_seconds) / decoded : 0)
+                  << std::setw(10) << latency.Percentile(50) << std::setw(10) << latency.Percentile(99)
+                  << std::setprecision(1) << std::setw(11) << cpu_per_stream << "%" << std::setw(14)
+                  << (cpu_per_stream > 0 ? 100.0 / cpu_per_stream : 0) << "  " << after.encoder << std::defaultfloat
+                  << std::endl;
+        return encoded > 0 && rendered > 0;
+    }
+
+    // Encoder counters from the sender, decoder counters from the receiver.
+    static VideoTotals Collect(LoopbackPair& pair) {
+        VideoTotals totals;
+        if (webrtc::scoped_refptr<const webrtc::RTCStatsReport> report = GetStatsBlocking(pair.offerer().pc)) {
+            for (const auto* outbound : report->GetStatsOfType<webrtc::RTCOutboundRtpStreamStats>()) {
+                if (outbound->kind.value_or("") != "video") {
+                    continue;
+                }
+                totals.frames_encoded += outbound->frames_encoded.value_or(0);
+                totals.encode_seconds += outbound->total_encode_time.value_or(0);
+                totals.width = outbound->frame_width.value_or(totals.width);
+                totals.height = outbound->frame_height.value_or(totals.height);
+                totals.encoder = outbound->encoder_implementation.value_or(totals.encoder);
+            }
+        }
+        if (webrtc::scoped_refptr<const webrtc::RTCStatsReport> report = GetStatsBlocking(pair.answerer().pc)) {
+            for (const auto* inbound : report->GetStatsOfType<webrtc::RTCInboundRtpStreamStats>()) {
+                if (inbound->kind.value_or("") != "video") {
+                    continue;
+                }
+                totals.frames_decoded += inbound->frames_decoded.value_or(0);
+                totals.decode_seconds += inbound->total_decode_time.value_or(0);
+            }
+        }
+        return totals;
+    }
+
+    PeerConnectionFactoryPool* pool_;
+    webrtc::PeerConnectionInterface::RTCConfiguration config_;
+    VideoOptions options_;
+};
@@ -0,0 +1 @@
+#include "video_codec_config.h"
\ No newline at end of file
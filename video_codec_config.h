@@ -0,0 +1,128 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// The video codecs compiled into every PeerConnectionFactory, chosen at
+// configure time with -DWEBRTC_EXAMPLE_VIDEO_CODECS (see CMakeLists.txt).
+// Each WEBRTC_EXAMPLE_CODEC_<NAME> adds that codec's encoder and decoder
+// adapters to the factory templates; codecs left out are never
+// instantiated, so their libraries are not linked in.
+// WEBRTC_EXAMPLE_DATA_ONLY builds factories without any media engine.
+
+#if !defined(WEBRTC_EXAMPLE_DATA_ONLY)
+#include <api/video_codecs/video_decoder_factory_template.h>
+#include <api/video_codecs/video_encoder_factory_template.h>
+#endif
+#if defined(WEBRTC_EXAMPLE_CODEC_VP8)
+#include <api/video_codecs/video_decoder_factory_template_libvpx_vp8_adapter.h>
+#include <api/video_codecs/video_encoder_factory_template_libvpx_vp8_adapter.h>
+#endif
+#if defined(WEBRTC_EXAMPLE_CODEC_VP9)
+#include <api/video_codecs/video_decoder_factory_template_libvpx_vp9_adapter.h>
+#include <api/video_codecs/video_encoder_factory_template_libvpx_vp9_adapter.h>
+#endif
+#if defined(WEBRTC_EXAMPLE_CODEC_H264)
+#include <api/video_codecs/video_decoder_factory_template_open_h264_adapter.h>
+#include <api/video_codecs/video_encoder_factory_template_open_h264_adapter.h>
+#endif
+#if defined(WEBRTC_EXAMPLE_CODEC_AV1)
+#include <api/video_codecs/video_decoder_factory_template_dav1d_adapter.h>
+#include <api/video_codecs/video_encoder_factory_template_libaom_av1_adapter.h>
+#endif
+
+namespace video_codec_config {
+
+template <typename... Ts>
+struct TypeList {};
+
+template <typename... Lists>
+struct Concat;
+
+template <typename... Ts>
+struct Concat<TypeList<Ts...>> {
+    using type = TypeList<Ts...>;
+};
+
+template <typename... As, typename... Bs, typename... Rest>
+struct Concat<TypeList<As...>, TypeList<Bs...>, Rest...> {
+    using type = typename Concat<TypeList<As..., Bs...>, Rest...>::type;
+};
+
+// Instantiates |Template| with the types in |List|.
+template <template <typename...> class Template, typename List>
+struct Apply;
+
+template <template <typename...> class Template, typename... Ts>
+struct Apply<Template, TypeList<Ts...>> {
+    using type = Template<Ts...>;
+};
+
+#if defined(WEBRTC_EXAMPLE_CODEC_VP8)
+using Vp8Encoders = TypeList<webrtc::LibvpxVp8EncoderTemplateAdapter>;
+using Vp8Decoders = TypeList<webrtc::LibvpxVp8DecoderTemplateAdapter>;
+#else
+using Vp8Encoders = TypeList<>;
+using Vp8Decoders = TypeList<>;
+#endif
+#if defined(WEBRTC_EXAMPLE_CODEC_VP9)
+using Vp9Encoders = TypeList<webrtc::LibvpxVp9EncoderTemplateAdapter>;
+using Vp9Decoders = TypeList<webrtc::LibvpxVp9DecoderTemplateAdapter>;
+#else
+using Vp9Encoders = TypeList<>;
+using Vp9Decoders = TypeList<>;
+#endif
+#if defined(WEBRTC_EXAMPLE_CODEC_H264)
+using H264Encoders = TypeList<webrtc::OpenH264EncoderTemplateAdapter>;
+using H264Decoders = TypeList<webrtc::OpenH264DecoderTemplateAdapter>;
+#else
+using H264Encoders = TypeList<>;
+using H264Decoders = TypeList<>;
+#endif
+#if defined(WEBRTC_EXAMPLE_CODEC_AV1)
+using Av1Encoders = TypeList<webrtc::LibaomAv1EncoderTemplateAdapter>;
+using Av1Decoders = TypeList<webrtc::Dav1dDecoderTemplateAdapter>;
+#else
+using Av1Encoders = TypeList<>;
+using Av1Decoders = TypeList<>;
+#endif
+
+#if !defined(WEBRTC_EXAMPLE_DATA_ONLY)
+using EncoderFactory = Apply<webrtc::VideoEncoderFactoryTemplate,
+                             Concat<Vp8Encoders, Vp9Encoders, H264Encoders, Av1Encoders>::type>::type;
+using DecoderFactory = Apply<webrtc::VideoDecoderFactoryTemplate,
+                             Concat<Vp8Decoders, Vp9Decoders, H264Decoders, Av1Decoders>::type>::type;
+#endif
+
+// SDP names of the compiled-in codecs, in the order the factories prefer them.
+inline std::vector<std::string> Names() {
+    std::vector<std::string> names;
+#if defined(WEBRTC_EXAMPLE_CODEC_VP8)
+    names.push_back("VP8");
+#endif
+#if defined(WEBRTC_EXAMPLE_CODEC_VP9)
+    names.push_back("VP9");
+#endif
+#if defined(WEBRTC_EXAMPLE_CODEC_H264)
+    names.push_back("H264");
+#endif
+#if defined(WEBRTC_EXAMPLE_CODEC_AV1)
+    names.push_back("AV1");
+#endif
+    return names;
+}
+
+// "VP8,VP9,..." or "data-only", for reports.
+inline std::string Describe() {
+#if defined(WEBRTC_EXAMPLE_DATA_ONLY)
+    return "data-only";
+#else
+    std::string description;
+    for (const std::string& name : Names()) {
+        description += (description.empty() ? "" : ",") + name;
+    }
+    return description;
+#endif
+}
+
+}  // namespace video_codec_config
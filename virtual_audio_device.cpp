@@ -0,0 +1 @@
+#include "virtual_audio_device.h"
\ No newline at end of file
@@ -0,0 +1,309 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <api/audio/audio_device.h>
+#include <api/scoped_refptr.h>
+#include <api/units/time_delta.h>
+#include <common_audio/wav_file.h>
+#include <modules/audio_device/include/audio_device_default.h>
+#include <rtc_base/thread.h>
+#include <rtc_base/time_utils.h>
+
+// An AudioDeviceModule without audio hardware, for headless servers. A
+// high-precision timer on its own thread delivers one 10 ms capture frame
+// (a sine tone or a looped WAV file) and pulls one 10 ms playout frame
+// (discarded or written to a WAV file) per tick, like a sound card would.
+// The time spent inside the two AudioTransport callbacks is counted:
+// capture covers the audio processing module and the hand-off to every
+// send stream's encoder queue, playout covers decoding and the mixer.
+class VirtualAudioDevice : public webrtc::webrtc_impl::AudioDeviceModuleDefault<webrtc::AudioDeviceModule> {
+public:
+    struct Options {
+        int sample_rate = 48000;
+        // 1 or 2, for capture and playout.
+        int channels = 1;
+        int tone_hz = 440;
+        // 16-bit PCM WAV looped as capture instead of the tone; its own rate
+        // and channel count are used.
+        std::string capture_wav;
+        // Playout is written here; empty discards it.
+        std::string playout_wav;
+    };
+
+    struct Counters {
+        int64_t capture_frames = 0;
+        int64_t capture_ns = 0;
+        int64_t playout_frames = 0;
+        int64_t playout_ns = 0;
+        // Playout frames that were not silence.
+        int64_t audible_frames = 0;
+    };
+
+    // Returns null if |options.capture_wav| cannot be opened.
+    static webrtc::scoped_refptr<VirtualAudioDevice> Create(const Options& options) {
+        if (!options.capture_wav.empty()) {
+            // WavReader RTC_CHECKs that the file opens.
+            FILE* file = std::fopen(options.capture_wav.c_str(), "rb");
+            if (!file) {
+                return nullptr;
+            }
+            std::fclose(file);
+        }
+        return webrtc::make_ref_counted<VirtualAudioDevice>(options);
+    }
+
+    Counters counters() const {
+        Counters counters;
+        counters.capture_frames = capture_frames_.load(std::memory_order_relaxed);
+        counters.capture_ns = capture_ns_.load(std::memory_order_relaxed);
+        counters.playout_frames = playout_frames_.load(std::memory_order_relaxed);
+        counters.playout_ns = playout_ns_.load(std::memory_order_relaxed);
+        counters.audible_frames = audible_frames_.load(std::memory_order_relaxed);
+        return counters;
+    }
+
+    // AudioDeviceModule implementation. Called on the factory's worker thread.
+    int32_t RegisterAudioCallback(webrtc::AudioTransport* transport) override {
+        thread_->BlockingCall([this, transport] { transport_ = transport; });
+        return 0;
+    }
+
+    int32_t Init() override {
+        initialized_ = true;
+        return 0;
+    }
+    int32_t Terminate() override {
+        StopPlayout();
+        StopRecording();
+        initialized_ = false;
+        return 0;
+    }
+    bool Initialized() const override { return initialized_; }
+
+    int32_t PlayoutIsAvailable(bool* available) override {
+        *available = true;
+        return 0;
+    }
+    int32_t InitPlayout() override {
+        playout_initialized_ = true;
+        return 0;
+    }
+    bool PlayoutIsInitialized() const override { return playout_initialized_; }
+    int32_t StartPlayout() override {
+        if (!playout_initialized_) {
+            return -1;
+        }
+        Resume(playing_);
+        return 0;
+    }
+    int32_t StopPlayout() override {
+        Pause(playing_);
+        playout_initialized_ = false;
+        return 0;
+    }
+    bool Playing() const override { return playing_; }
+
+    int32_t RecordingIsAvailable(bool* available) override {
+        *available = true;
+        return 0;
+    }
+    int32_t InitRecording() override {
+        recording_initialized_ = true;
+        return 0;
+    }
+    bool RecordingIsInitialized() const override { return recording_initialized_; }
+    int32_t StartRecording() override {
+        if (!recording_initialized_) {
+            return -1;
+        }
+        Resume(recording_);
+        return 0;
+    }
+    int32_t StopRecording() override {
+        Pause(recording_);
+        recording_initialized_ = false;
+        return 0;
+    }
+    bool Recording() const override { return recording_; }
+
+    int32_t StereoPlayoutIsAvailable(bool* available) const override {
+        *available = playout_channels_ == 2;
+        return 0;
+    }
+    int32_t SetStereoPlayout(bool enable) override { return enable == (playout_channels_ == 2) ? 0 : -1; }
+    int32_t StereoPlayout(bool* enabled) const override {
+        *enabled = playout_channels_ == 2;
+        return 0;
+    }
+    int32_t StereoRecordingIsAvailable(bool* available) const override {
+        *available = capture_channels_ == 2;
+        return 0;
+    }
+    int32_t SetStereoRecording(bool enable) override { return enable == (capture_channels_ == 2) ? 0 : -1; }
+    int32_t StereoRecording(bool* enabled) const override {
+        *enabled = capture_channels_ == 2;
+        return 0;
+    }
+    int32_t PlayoutDelay(uint16_t* delay_ms) const override {
+        *delay_ms = 0;
+        return 0;
+    }
+
+protected:
+    explicit VirtualAudioDevice(const Options& options)
+        : options_(options), thread_(webrtc::Thread::Create()) {
+        if (!options_.capture_wav.empty()) {
+            reader_ = std::make_unique<webrtc::WavReader>(options_.capture_wav);
+            capture_rate_ = reader_->sample_rate();
+            capture_channels_ = static_cast<int>(reader_->num_channels());
+        } else {
+            capture_rate_ = options_.sample_rate;
+            capture_channels_ = std::clamp(options_.channels, 1, 2);
+        }
+        playout_rate_ = options_.sample_rate;
+        playout_channels_ = std::clamp(options_.channels, 1, 2);
+        if (!options_.playout_wav.empty()) {
+            writer_ = std::make_unique<webrtc::WavWriter>(options_.playout_wav, playout_rate_, playout_channels_);
+        }
+        capture_.resize(capture_rate_ / 100 * capture_channels_);
+        playout_.resize(playout_rate_ / 100 * playout_channels_);
+
+        thread_->SetName("audio-device", nullptr);
+        thread_->Start();
+    }
+
+    ~VirtualAudioDevice() override {
+        Terminate();
+        thread_->Stop();
+    }
+
+private:
+    static constexpr int64_t kFrameUs = 10000;
+
+    // Sets |flag| and starts the tick loop if it is not running.
+    void Resume(std::atomic<bool>& flag) {
+        flag = true;
+        thread_->PostTask([this] {
+            if (!ticking_) {
+                ticking_ = true;
+                start_us_ = webrtc::TimeMicros();
+                tick_index_ = 0;
+                Tick();
+            }
+        });
+    }
+
+    // Returns once no callback for |flag|'s direction is in flight.
+    void Pause(std::atomic<bool>& flag) {
+        thread_->BlockingCall([&flag] { flag = false; });
+    }
+
+    // Runs on |thread_|.
+    void Tick() {
+        if (!recording_ && !playing_) {
+            ticking_ = false;
+            return;
+        }
+        if (transport_ && recording_) {
+            Capture();
+        }
+        if (transport_ && playing_) {
+            Playout();
+        }
+        // Scheduled from the start time, so delivery jitter does not add up.
+        ++tick_index_;
+        const int64_t next_us = start_us_ + tick_index_ * kFrameUs;
+        thread_->PostDelayedHighPrecisionTask(
+            [this] { Tick(); },
+            webrtc::TimeDelta::Micros(std::max<int64_t>(0, next_us - webrtc::TimeMicros())));
+    }
+
+    void Capture() {
+        if (reader_) {
+            size_t read = reader_->ReadSamples(capture_.size(), capture_.data());
+            if (read < capture_.size()) {
+                reader_->Reset();
+                read += reader_->ReadSamples(capture_.size() - read, capture_.data() + read);
+                std::fill(capture_.begin() + read, capture_.end(), 0);
+            }
+        } else {
+            const double step = 2 * M_PI * options_.tone_hz / capture_rate_;
+            for (size_t i = 0; i < capture_.size(); i += capture_channels_) {
+                const int16_t sample = static_cast<int16_t>(8000 * std::sin(tone_phase_));
+                std::fill_n(capture_.begin() + i, capture_channels_, sample);
+                tone_phase_ = std::fmod(tone_phase_ + step, 2 * M_PI);
+            }
+        }
+
+        uint32_t new_mic_level = 0;
+        const int64_t start_ns = webrtc::TimeNanos();
+        transport_->RecordedDataIsAvailable(capture_.data(), capture_.size() / capture_channels_,
+                                            sizeof(int16_t) * capture_channels_, capture_channels_, capture_rate_,
+                                            0, 0, 0, false, new_mic_level);
+        capture_ns_.fetch_add(webrtc::TimeNanos() - start_ns, std::memory_order_relaxed);
+        capture_frames_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void Playout() {
+        size_t samples_out = 0;
+        int64_t elapsed_time_ms = -1;
+        int64_t ntp_time_ms = -1;
+        const int64_t start_ns = webrtc::TimeNanos();
+        transport_->NeedMorePlayData(playout_.size() / playout_channels_, sizeof(int16_t) * playout_channels_,
+                                     playout_channels_, playout_rate_, playout_.data(), samples_out,
+                                     &elapsed_time_ms, &ntp_time_ms);
+        playout_ns_.fetch_add(webrtc::TimeNanos() - start_ns, std::memory_order_relaxed);
+        playout_frames_.fetch_add(1, std::memory_order_relaxed);
+
+        const size_t samples = std::min(samples_out * playout_channels_, playout_.size());
+        if (std::any_of(playout_.begin(), playout_.begin() + samples,
+                        [](int16_t sample) { return std::abs(sample) > kSilence; })) {
+            audible_frames_.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (writer_) {
+            writer_->WriteSamples(playout_.data(), samples);
+        }
+    }
+
+    // Comfort noise and dither stay below this.
+    static constexpr int kSilence = 64;
+
+    const Options options_;
+    const std::unique_ptr<webrtc::Thread> thread_;
+    int capture_rate_ = 0;
+    int capture_channels_ = 0;
+    int playout_rate_ = 0;
+    int playout_channels_ = 0;
+
+    std::atomic<bool> initialized_{false};
+    std::atomic<bool> playout_initialized_{false};
+    std::atomic<bool> recording_initialized_{false};
+    std::atomic<bool> playing_{false};
+    std::atomic<bool> recording_{false};
+
+    // |thread_| only.
+    webrtc::AudioTransport* transport_ = nullptr;
+    std::unique_ptr<webrtc::WavReader> reader_;
+    std::unique_ptr<webrtc::WavWriter> writer_;
+    std::vector<int16_t> capture_;
+    std::vector<int16_t> playout_;
+    double tone_phase_ = 0;
+    bool ticking_ = false;
+    int64_t start_us_ = 0;
+    int64_t tick_index_ = 0;
+
+    std::atomic<int64_t> capture_frames_{0};
+    std::atomic<int64_t> capture_ns_{0};
+    std::atomic<int64_t> playout_frames_{0};
+    std::atomic<int64_t> playout_ns_{0};
+    std::atomic<int64_t> audible_frames_{0};
+};